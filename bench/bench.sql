@@ -0,0 +1,160 @@
+-- Objects of the gevel benchmark, see bench/run.sh and README.gevel.
+SET client_min_messages = warning;
+
+CREATE SCHEMA IF NOT EXISTS gevel_bench;
+
+--
+-- Synthetic data, deterministic for a given scale (number of rows):
+-- keys are spread by multiplicative hashing instead of random(), so every
+-- run builds the same indexes. Every access method gets a uniform index
+-- and a skewed or deep one.
+--
+CREATE OR REPLACE FUNCTION gevel_bench.setup(scale bigint)
+RETURNS void LANGUAGE plpgsql AS $f$
+DECLARE
+	s	text := scale::text;
+BEGIN
+	EXECUTE format($$
+		CREATE TABLE IF NOT EXISTS gevel_bench.btree_%s AS
+		SELECT i,
+			(i * 2654435761) %% 4294967296 AS k,
+			(1000 / (1 + i %% 1000))::int4 AS d,
+			repeat('x', 200) || lpad(((i * 2654435761) %% 4294967296)::text, 10, '0') AS w
+		FROM generate_series(1, %s::bigint) i$$, s, s);
+
+	EXECUTE format($$
+		CREATE TABLE IF NOT EXISTS gevel_bench.gist_%s AS
+		SELECT box(point(x, y), point(x + 0.01, y + 0.01)) AS b,
+			CASE WHEN i %% 10 = 0
+				THEN box(point(x, y), point(x + 0.01, y + 0.01))
+				ELSE box(point(x / 1000, y / 1000), point(x / 1000 + 0.0001, y / 1000 + 0.0001))
+			END AS c,
+			point(x, y) AS p,
+			'/' || (i %% 7) || '/' || (i %% 101) || '/' || i AS t
+		FROM (SELECT i,
+				((i * 2654435761) %% 1000003)::float8 / 1000 AS x,
+				((i * 40503) %% 999983)::float8 / 1000 AS y
+			FROM generate_series(1, %s::bigint) i) g$$, s, s);
+
+	EXECUTE format($$
+		CREATE TABLE IF NOT EXISTS gevel_bench.gin_%s AS
+		SELECT ARRAY[(i %% 1000)::int4, ((i * 31) %% 100003)::int4] AS a,
+			ARRAY[0, (i %% 10)::int4] AS s,
+			array_to_tsvector(ARRAY['a' || (i %% 1000), 'b' || (i %% 37)]) AS v
+		FROM generate_series(1, %s::bigint) i$$, s, s);
+
+	EXECUTE format('CREATE INDEX IF NOT EXISTS btree_uniform_%s ON gevel_bench.btree_%s USING btree (k)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS btree_skewed_%s ON gevel_bench.btree_%s USING btree (d)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS btree_deep_%s ON gevel_bench.btree_%s USING btree (w)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS hash_uniform_%s ON gevel_bench.btree_%s USING hash (k)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS brin_corr_%s ON gevel_bench.btree_%s USING brin (i)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS brin_rand_%s ON gevel_bench.btree_%s USING brin (k)', s, s);
+	IF current_setting('server_version_num')::int >= 140000 THEN
+		EXECUTE format('CREATE INDEX IF NOT EXISTS brin_bloom_%s ON gevel_bench.btree_%s USING brin (k int8_bloom_ops)', s, s);
+	END IF;
+
+	EXECUTE format('CREATE INDEX IF NOT EXISTS gist_uniform_%s ON gevel_bench.gist_%s USING gist (b)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS gist_skewed_%s ON gevel_bench.gist_%s USING gist (c)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS spgist_quad_%s ON gevel_bench.gist_%s USING spgist (p)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS spgist_kd_%s ON gevel_bench.gist_%s USING spgist (p kd_point_ops)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS spgist_text_%s ON gevel_bench.gist_%s USING spgist (t)', s, s);
+
+	EXECUTE format('CREATE INDEX IF NOT EXISTS gin_uniform_%s ON gevel_bench.gin_%s USING gin (a)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS gin_skewed_%s ON gevel_bench.gin_%s USING gin (s)', s, s);
+	EXECUTE format('CREATE INDEX IF NOT EXISTS gin_fts_%s ON gevel_bench.gin_%s USING gin (v)', s, s);
+END
+$f$;
+
+--
+-- The calls to time, @ stands for the scale. Set-returning functions are
+-- wrapped in count(*) and text results in length() so that the client
+-- does not pay for the output.
+--
+CREATE TABLE IF NOT EXISTS gevel_bench.cases (
+	name		text PRIMARY KEY,
+	min_version	int NOT NULL,
+	call		text NOT NULL
+);
+
+TRUNCATE gevel_bench.cases;
+INSERT INTO gevel_bench.cases VALUES
+	('gist_stat',				80200,	$$SELECT length(gist_stat('gevel_bench.gist_uniform_@'))$$),
+	('gist_stat_skewed',		80200,	$$SELECT length(gist_stat('gevel_bench.gist_skewed_@'))$$),
+	('gist_tree',				80200,	$$SELECT length(gist_tree('gevel_bench.gist_uniform_@'))$$),
+	('gist_print',				80200,	$$SELECT count(*) FROM gist_print('gevel_bench.gist_uniform_@') AS t(level int, valid bool, a box)$$),
+	('gist_print_skewed',		80200,	$$SELECT count(*) FROM gist_print('gevel_bench.gist_skewed_@') AS t(level int, valid bool, a box)$$),
+	('gin_stat',				80200,	$$SELECT count(*) FROM gin_stat('gevel_bench.gin_uniform_@') AS t(value int, nrow int)$$),
+	('gin_stat_skewed',			80200,	$$SELECT count(*) FROM gin_stat('gevel_bench.gin_skewed_@') AS t(value int, nrow int)$$),
+	('gin_statpage',			90400,	$$SELECT length(gin_statpage('gevel_bench.gin_uniform_@'))$$),
+	('gin_statpage_skewed',		90400,	$$SELECT length(gin_statpage('gevel_bench.gin_skewed_@'))$$),
+	('gin_count_estimate',		80300,	$$SELECT gin_count_estimate('gevel_bench.gin_fts_@', 'a1 & b1')$$),
+	('spgist_stat',				90200,	$$SELECT length(spgist_stat('gevel_bench.spgist_quad_@'))$$),
+	('spgist_stat_text',		90200,	$$SELECT length(spgist_stat('gevel_bench.spgist_text_@'))$$),
+	('spgist_print',			90200,	$$SELECT count(*) FROM spgist_print('gevel_bench.spgist_quad_@') AS t(tid tid, allthesame bool, node_n int, level int, tid_pointer tid, prefix point, node_label int, leaf_value point)$$),
+	('spgist_print_kd',			90200,	$$SELECT count(*) FROM spgist_print('gevel_bench.spgist_kd_@') AS t(tid tid, allthesame bool, node_n int, level int, tid_pointer tid, prefix float8, node_label int, leaf_value point)$$),
+	('spgist_level_stat',		90200,	$$SELECT length(spgist_level_stat('gevel_bench.spgist_quad_@'))$$),
+	('btree_stat',				120000,	$$SELECT length(btree_stat('gevel_bench.btree_uniform_@'))$$),
+	('btree_stat_skewed',		120000,	$$SELECT length(btree_stat('gevel_bench.btree_skewed_@'))$$),
+	('btree_stat_deep',			120000,	$$SELECT length(btree_stat('gevel_bench.btree_deep_@'))$$),
+	('btree_tree',				120000,	$$SELECT length(btree_tree('gevel_bench.btree_deep_@'))$$),
+	('btree_print',				120000,	$$SELECT count(*) FROM btree_print('gevel_bench.btree_uniform_@') AS t(level int, valid bool, a int8)$$),
+	('hash_stat',				120000,	$$SELECT length(hash_stat('gevel_bench.hash_uniform_@'))$$),
+	('hash_print',				120000,	$$SELECT count(*) FROM hash_print('gevel_bench.hash_uniform_@')$$),
+	('brin_stat',				120000,	$$SELECT length(brin_stat('gevel_bench.brin_corr_@'))$$),
+	('brin_print',				120000,	$$SELECT length(brin_print('gevel_bench.brin_corr_@'))$$),
+	('brin_overlap_stat',		120000,	$$SELECT length(brin_overlap_stat('gevel_bench.brin_rand_@'))$$),
+	('brin_query_estimate',		120000,	$$SELECT * FROM brin_query_estimate('gevel_bench.brin_rand_@', '=(int8,int8)', 12345::int8)$$),
+	('brin_ppr_advisor',		120000,	$$SELECT length(brin_ppr_advisor('gevel_bench.btree_@', 'i', '{16,128}'))$$),
+	('brin_summary_stat',		140000,	$$SELECT length(brin_summary_stat('gevel_bench.brin_bloom_@'))$$),
+	('brin_summary_print',		140000,	$$SELECT count(*) FROM brin_summary_print('gevel_bench.brin_bloom_@')$$),
+	('gist_stat_incremental',	120000,	$$SELECT length(gist_stat_incremental('gevel_bench.gist_uniform_@'))$$),
+	('btree_stat_incremental',	120000,	$$SELECT length(btree_stat_incremental('gevel_bench.btree_uniform_@'))$$),
+	('gevel_survey',			120000,	$$SELECT count(*) FROM gevel_survey('gevel_bench')$$);
+
+CREATE OR REPLACE FUNCTION gevel_bench.cases_for(scale bigint,
+	OUT name text, OUT call text)
+RETURNS SETOF record LANGUAGE sql AS $$
+	SELECT name, replace(call, '@', scale::text)
+	FROM gevel_bench.cases
+	WHERE min_version <= current_setting('server_version_num')::int
+	ORDER BY name
+$$;
+
+--
+-- Run one call under EXPLAIN ANALYZE and return its execution time and
+-- shared buffer accesses. peak_kb is the peak memory the gevel call
+-- allocated in its memory contexts, from the gevel.instrument report of
+-- the call (PostgreSQL 13 and later, NULL elsewhere or when the call
+-- made no report); for a case calling several walkers it is that of the
+-- last one.
+--
+CREATE OR REPLACE FUNCTION gevel_bench.measure(call text,
+	OUT ms float8, OUT shared_hit bigint, OUT shared_read bigint, OUT peak_kb bigint)
+LANGUAGE plpgsql AS $$
+DECLARE
+	plan	json;
+	before	text;
+	report	text;
+	memory	bool := current_setting('server_version_num')::int >= 130000;
+BEGIN
+	IF memory THEN
+		-- the report is raised as a NOTICE as well
+		PERFORM set_config('gevel.instrument', 'on', true);
+		PERFORM set_config('client_min_messages', 'warning', true);
+		before := gevel_instrument_last();
+	END IF;
+
+	EXECUTE 'EXPLAIN (ANALYZE, BUFFERS, TIMING OFF, FORMAT JSON) ' || call INTO plan;
+
+	ms := (plan->0->>'Execution Time')::float8;
+	shared_hit := (plan->0->'Plan'->>'Shared Hit Blocks')::bigint;
+	shared_read := (plan->0->'Plan'->>'Shared Read Blocks')::bigint;
+
+	IF memory THEN
+		report := gevel_instrument_last();
+		IF report IS DISTINCT FROM before THEN
+			peak_kb := substring(report FROM 'Peak Memory: (\d+) kB')::bigint;
+		END IF;
+	END IF;
+END
+$$;
@@ -0,0 +1,110 @@
+#!/bin/sh
+#
+# Scale benchmark of the gevel functions: "make bench" / "make bench-baseline".
+#
+# Builds the synthetic indexes of bench/bench.sql for every scale, times
+# every call once cold and once warm, and compares the results with the
+# stored baseline. Runs against the server psql connects to (PG* variables)
+# with gevel installed; building the 100M row indexes takes hours and tens
+# of gigabytes.
+#
+#   BENCH_SCALES     numbers of rows, "1000000" by default
+#   BENCH_BASELINE   baseline file, bench/baseline.csv by default
+#   BENCH_RECORD     1 to store the results as the new baseline
+#   BENCH_TOLERANCE  slowdown factor reported as a regression, 1.5
+#   BENCH_RESTART    command restarting the server (e.g. pg_ctl restart)
+#                    run before every cold call; without it the cold call
+#                    is only the first one of a new backend
+#   PSQL             psql binary, "psql" by default
+
+set -e
+
+dir=`dirname "$0"`
+top="$dir/.."
+psql="${PSQL:-psql} -X -q -v ON_ERROR_STOP=1"
+scales=${BENCH_SCALES:-1000000}
+baseline=${BENCH_BASELINE:-$dir/baseline.csv}
+tolerance=${BENCH_TOLERANCE:-1.5}
+results="$dir/results.csv"
+
+version=`$psql -At -c "SHOW server_version_num"`
+
+# gevel itself, with the functions of the optional scripts
+for f in gevel.sql gevel.btree.sql gevel.brin.sql gevel.hash.sql gevel.survey.sql \
+	gevel.incremental.sql gevel.resumable.sql gevel.progress.sql
+do
+	if [ "$f" = gevel.sql ] || [ "$version" -ge 120000 ]; then
+		PGOPTIONS="-c client_min_messages=warning" $psql -f "$top/$f" > /dev/null
+	fi
+done
+$psql -f "$dir/bench.sql"
+
+echo "scale,case,mode,ms,shared_hit,shared_read,peak_kb" > "$results"
+
+for scale in $scales
+do
+	echo "building indexes for $scale rows"
+	$psql -c "SELECT gevel_bench.setup($scale)" > /dev/null
+	$psql -c "VACUUM ANALYZE gevel_bench.btree_$scale, gevel_bench.gist_$scale, gevel_bench.gin_$scale" > /dev/null
+
+	$psql -At -F ' ' -c "SELECT name, call FROM gevel_bench.cases_for($scale)" > "$dir/cases.tmp"
+	while read -r name call
+	do
+		if [ -n "$BENCH_RESTART" ]; then
+			sh -c "$BENCH_RESTART" > /dev/null
+		fi
+		$psql -At -F , \
+			-c "SELECT $scale, '$name', 'cold', * FROM gevel_bench.measure(\$gevel\$$call\$gevel\$)" \
+			-c "SELECT $scale, '$name', 'warm', * FROM gevel_bench.measure(\$gevel\$$call\$gevel\$)" \
+			>> "$results"
+	done < "$dir/cases.tmp"
+	rm -f "$dir/cases.tmp"
+done
+
+if [ "$BENCH_RECORD" = 1 ]; then
+	cp "$results" "$baseline"
+	echo "baseline written to $baseline"
+	exit 0
+fi
+
+if [ ! -f "$baseline" ]; then
+	cat "$results"
+	echo "no baseline in $baseline, run make bench-baseline to store one"
+	exit 0
+fi
+
+# Time and memory are compared with the tolerance, buffer accesses (hit
+# plus read, which does not depend on the cache) must stay within 10%.
+awk -F, -v tol="$tolerance" '
+	NR == FNR { if (FNR > 1) base[$1 "," $2 "," $3] = $0; next }
+	FNR == 1 {
+		printf "%-10s %-24s %-4s %12s %12s %12s %12s %10s %10s\n",
+			"scale", "case", "mode", "ms", "base ms", "buffers", "base buf",
+			"peak kB", "base kB"
+		next
+	}
+	{
+		key = $1 "," $2 "," $3
+		if (!(key in base)) {
+			printf "%-10s %-24s %-4s %12.1f %12s\n", $1, $2, $3, $4, "-"
+			next
+		}
+		split(base[key], b, ",")
+		flag = ""
+		if ($4 > b[4] * tol && $4 - b[4] > 10)
+			flag = flag " TIME"
+		if ($5 + $6 > (b[5] + b[6]) * 1.1 + 10)
+			flag = flag " BUFFERS"
+		if ($7 != "" && b[7] != "" && $7 > b[7] * tol && $7 - b[7] > 1024)
+			flag = flag " MEMORY"
+		printf "%-10s %-24s %-4s %12.1f %12.1f %12d %12d %10s %10s%s\n",
+			$1, $2, $3, $4, b[4], $5 + $6, b[5] + b[6], $7, b[7], flag
+		if (flag != "")
+			regressions++
+	}
+	END {
+		if (regressions > 0) {
+			printf "%d regressions against the baseline\n", regressions
+			exit 1
+		}
+	}' "$baseline" "$results"
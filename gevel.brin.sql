@@ -13,4 +13,39 @@ create or replace function brin_print(text)
         language C
         strict;
 
+create or replace function brin_overlap_stat(text)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function brin_query_estimate(text, regoperator, anyelement,
+        column_name text default null,
+        out ranges bigint, out pages bigint)
+        returns record
+        as '$libdir/gevel'
+        language C;
+
+create or replace function brin_summary_stat(text)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function brin_summary_print(text,
+        out blkno bigint, out attnum int, out opclass text,
+        out nhashes int, out nbits bigint, out nbits_set bigint,
+        out false_positive_rate float8, out ndistinct float8,
+        out nranges int, out nvalues int, out maxvalues int)
+        returns setof record
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function brin_ppr_advisor(text, text, int[])
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
 END;
@@ -7,6 +7,12 @@ create or replace function btree_stat(text)
         language C
         strict;
 
+create or replace function btree_stat(text, sequential bool)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
 create or replace function btree_print(text)
         returns setof record
         as '$libdir/gevel'
@@ -25,4 +31,38 @@ create or replace function btree_tree(text, int)
         language C
         strict;
 
+create or replace function btree_dedup_stat(text,
+        out level int, out pages bigint, out tuples bigint,
+        out posting_tuples bigint, out plain_tuples bigint, out heap_tids bigint,
+        out avg_posting_length float8, out tuple_bytes bigint, out bytes_saved bigint)
+        returns setof record
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function btree_pivot_stat(text,
+        out level int, out pages bigint, out downlinks bigint,
+        out avg_fanout float8, out max_fanout float8,
+        out min_size int, out median_size int, out p90_size int, out max_size int,
+        out truncated_pivots bigint, out avg_key_atts float8, out heap_tid_pivots bigint,
+        out growth_to_next_level float8)
+        returns setof record
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function btree_prefix_stat(text,
+        out prefix int, out columns text, out entries bigint, out distinct_values bigint,
+        out max_run bigint, out avg_run float8, out skew float8)
+        returns setof record
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function btree_bloat_stat(text)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
 END;
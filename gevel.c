@@ -1,5 +1,8 @@
 #include "postgres.h"
 
+#include <math.h>
+#include <unistd.h>
+
 #include "access/genam.h"
 #include "access/gin.h"
 #if PG_VERSION_NUM >= 90400
@@ -31,6 +34,7 @@
 #include <utils/regproc.h>
 #include <utils/varlena.h>
 #endif
+#include "lib/stringinfo.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/datum.h"
@@ -40,20 +44,43 @@
 #include <access/heapam.h>
 #include <catalog/pg_type.h>
 #include <access/relscan.h>
+#include <utils/tuplestore.h>
 #if PG_VERSION_NUM >= 120000
+#include <access/htup_details.h>
 #include <access/nbtree.h>
+#include <access/hash.h>
 #include <access/brin.h>
 #include <access/brin_revmap.h>
 #include <access/brin_page.h>
 #include <access/brin_tuple.h>
+#include <parser/parse_coerce.h>
+#include <utils/array.h>
+#include <utils/float.h>
+#include <utils/typcache.h>
+#include <storage/bufmgr.h>
+#include <access/table.h>
+#include <access/tableam.h>
+#include <access/xact.h>
+#include <catalog/pg_collation.h>
+#include <commands/defrem.h>
+#include <commands/progress.h>
+#include <executor/instrument.h>
+#include <pgstat.h>
+#include <storage/fd.h>
+#include <storage/freespace.h>
+#include <utils/timestamp.h>
+#include <utils/guc.h>
+#include <utils/memutils.h>
+#include <utils/spccache.h>
+#include <portability/instr_time.h>
 #endif
 
+#include "gevel_page.h"
+
 /* Get downlink block number */
 #define BTreeInnerTupleGetDownLink(itup) \
 	ItemPointerGetBlockNumberNoCheck(&((itup)->t_tid))
 
-#define PAGESIZE	(BLCKSZ - MAXALIGN(sizeof(PageHeaderData) + sizeof(ItemIdData)))
-
 #ifndef PG_NARGS
 #define PG_NARGS() (fcinfo->nargs)
 #endif
@@ -85,11 +112,45 @@ typedef struct {
 
 static Relation checkOpenedRelation(Relation r, Oid PgAmOid);
 
+#if PG_VERSION_NUM >= 120000
+/* time spent opening (and so locking) the index, for gevel.instrument */
+static double	gevelLockWait = 0;
+
+#define GEVEL_TIMED_OPEN(rel, expr) \
+	do { \
+		instr_time	openStart, \
+					openTime; \
+		INSTR_TIME_SET_CURRENT(openStart); \
+		(rel) = (expr); \
+		INSTR_TIME_SET_CURRENT(openTime); \
+		INSTR_TIME_SUBTRACT(openTime, openStart); \
+		gevelLockWait += INSTR_TIME_GET_MILLISEC(openTime); \
+	} while (0)
+#else
+#define GEVEL_TIMED_OPEN(rel, expr)	((rel) = (expr))
+#endif
+
 #ifdef PG_MODULE_MAGIC
 /* >= 8.2 */
 
 PG_MODULE_MAGIC;
 
+static Relation
+gevel_index_open(Oid relOid, LOCKMODE lockmode) {
+	Relation	rel;
+
+	GEVEL_TIMED_OPEN(rel, index_open(relOid, lockmode));
+	return rel;
+}
+
+static Relation
+gevel_relation_openrv(RangeVar *relvar, LOCKMODE lockmode) {
+	Relation	rel;
+
+	GEVEL_TIMED_OPEN(rel, relation_openrv(relvar, lockmode));
+	return rel;
+}
+
 static Relation
 gist_index_open(RangeVar *relvar) {
 #if PG_VERSION_NUM < 90200
@@ -98,11 +159,28 @@ gist_index_open(RangeVar *relvar) {
 	Oid relOid = RangeVarGetRelid(relvar, NoLock, false);
 #endif
 	return checkOpenedRelation(
-				index_open(relOid, AccessExclusiveLock), GIST_AM_OID);
+				gevel_index_open(relOid, AccessExclusiveLock), GIST_AM_OID);
 }
 
 #define	gist_index_close(r)	index_close((r), AccessExclusiveLock)
 
+/*
+ * gist_print copies every page under a short buffer lock, so it needs no
+ * more than AccessShareLock and inserts and scans go on while it prints.
+ */
+static Relation
+gist_print_open(RangeVar *relvar) {
+#if PG_VERSION_NUM < 90200
+	Oid relOid = RangeVarGetRelid(relvar, false);
+#else
+	Oid relOid = RangeVarGetRelid(relvar, NoLock, false);
+#endif
+	return checkOpenedRelation(
+				gevel_index_open(relOid, AccessShareLock), GIST_AM_OID);
+}
+
+#define	gist_print_close(r)	index_close((r), AccessShareLock)
+
 static Relation
 gin_index_open(RangeVar *relvar) {
 #if PG_VERSION_NUM < 90200
@@ -111,7 +189,7 @@ gin_index_open(RangeVar *relvar) {
 	Oid relOid = RangeVarGetRelid(relvar, NoLock, false);
 #endif
 	return checkOpenedRelation(
-				index_open(relOid, AccessShareLock), GIN_AM_OID);
+				gevel_index_open(relOid, AccessShareLock), GIN_AM_OID);
 }
 
 #define gin_index_close(r) index_close((r), AccessShareLock)
@@ -121,20 +199,56 @@ static Relation
 btree_index_open(RangeVar *relvar) {
 	Oid relOid = RangeVarGetRelid(relvar, NoLock, false);
 	return checkOpenedRelation(
-				index_open(relOid, AccessExclusiveLock), BTREE_AM_OID);
+				gevel_index_open(relOid, AccessExclusiveLock), BTREE_AM_OID);
 }
 
 #define	btree_index_close(r)	index_close((r), AccessExclusiveLock)
 
+/*
+ * btree_print and btree_print_range copy pages like gist_print,
+ * btree_stat(.., true) and btree_prefix_stat follow the sibling links,
+ * which copes with concurrent splits, and btree_bloat_stat reads every
+ * page on its own
+ */
+static Relation
+btree_share_open(RangeVar *relvar) {
+	Oid relOid = RangeVarGetRelid(relvar, NoLock, false);
+	return checkOpenedRelation(
+				gevel_index_open(relOid, AccessShareLock), BTREE_AM_OID);
+}
+
+#define	btree_share_close(r)	index_close((r), AccessShareLock)
+
 static Relation
 brin_index_open(RangeVar *relvar)
 {
 	Oid relOid = RangeVarGetRelid(relvar, NoLock, false);
 	return checkOpenedRelation(
-				index_open(relOid, AccessExclusiveLock), BRIN_AM_OID);
+				gevel_index_open(relOid, AccessExclusiveLock), BRIN_AM_OID);
 }
 
 #define	brin_index_close(r)	index_close((r), AccessExclusiveLock)
+
+/* brin_query_estimate reads the summaries like a bitmap scan */
+static Relation
+brin_scan_open(RangeVar *relvar)
+{
+	Oid relOid = RangeVarGetRelid(relvar, NoLock, false);
+	return checkOpenedRelation(
+				gevel_index_open(relOid, AccessShareLock), BRIN_AM_OID);
+}
+
+#define	brin_scan_close(r)	index_close((r), AccessShareLock)
+
+static Relation
+hash_index_open(RangeVar *relvar)
+{
+	Oid relOid = RangeVarGetRelid(relvar, NoLock, false);
+	return checkOpenedRelation(
+				gevel_index_open(relOid, AccessExclusiveLock), HASH_AM_OID);
+}
+
+#define	hash_index_close(r)	index_close((r), AccessExclusiveLock)
 #endif
 
 #else /* <8.2 */
@@ -153,6 +267,20 @@ gist_index_close(Relation rel) {
 	index_close(rel);
 }
 
+static Relation
+gist_print_open(RangeVar *relvar) {
+	Relation rel = index_openrv(relvar);
+
+	LockRelation(rel, AccessShareLock);
+	return checkOpenedRelation(rel, GIST_AM_OID);
+}
+
+static void
+gist_print_close(Relation rel) {
+	UnlockRelation(rel, AccessShareLock);
+	index_close(rel);
+}
+
 static Relation
 gin_index_open(RangeVar *relvar) {
 	Relation rel = index_openrv(relvar);
@@ -208,6 +336,468 @@ checkOpenedRelation(Relation r, Oid PgAmOid) {
 	return r;
 }
 
+/*
+ * Switch a set-returning function to materialize mode: rows are written
+ * with tuplestore_putvalues() into the returned tuplestore, which spills
+ * to disk beyond work_mem.
+ */
+static Tuplestorestate *
+materializeSetup(FunctionCallInfo fcinfo, TupleDesc tupdesc) {
+	ReturnSetInfo	*rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	MemoryContext	oldcontext;
+	Tuplestorestate	*tupstore;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+			(rsinfo->allowedModes & SFRM_Materialize) == 0)
+		elog(ERROR, "materialize mode required, but it is not allowed in this context");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupstore = tuplestore_begin_heap(
+					(rsinfo->allowedModes & SFRM_Materialize_Random) != 0,
+					false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	/* a RECORD result in the target list needs a registered row type */
+	rsinfo->setDesc = CreateTupleDescCopy(BlessTupleDesc(tupdesc));
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+/*
+ * Progress reporting. The backend progress API only knows the built-in
+ * commands, so gevel reports as CREATE INDEX and tags its rows with
+ * GEVEL_PROGRESS_MAGIC in the last parameter; the pg_stat_progress_gevel
+ * view (gevel.progress.sql) selects those rows and names the columns.
+ * Values that CREATE INDEX also has use its slots, so the rows read
+ * sensibly in pg_stat_progress_create_index too.
+ * Tree walkers see only reachable pages, so for them blocks_total is an
+ * upper bound of blocks_done.
+ */
+typedef enum GevelProgressFunction
+{
+	GEVEL_PROGRESS_GIST_TREE = 1,
+	GEVEL_PROGRESS_GIST_STAT,
+	GEVEL_PROGRESS_GIST_PRINT,
+	GEVEL_PROGRESS_GIN_STAT,
+	GEVEL_PROGRESS_GIN_STATPAGE,
+	GEVEL_PROGRESS_SPGIST_STAT,
+	GEVEL_PROGRESS_SPGIST_PRINT,
+	GEVEL_PROGRESS_SPGIST_LEVEL_STAT,
+	GEVEL_PROGRESS_BTREE_STAT,
+	GEVEL_PROGRESS_BTREE_TREE,
+	GEVEL_PROGRESS_BTREE_PRINT,
+	GEVEL_PROGRESS_BRIN_STAT,
+	GEVEL_PROGRESS_BRIN_PRINT,
+	GEVEL_PROGRESS_BRIN_OVERLAP_STAT,
+	GEVEL_PROGRESS_BRIN_QUERY_ESTIMATE,
+	GEVEL_PROGRESS_BRIN_SUMMARY_STAT,
+	GEVEL_PROGRESS_BRIN_SUMMARY_PRINT,
+	GEVEL_PROGRESS_BRIN_PPR_ADVISOR,
+	GEVEL_PROGRESS_HASH_STAT,
+	GEVEL_PROGRESS_HASH_PRINT,
+	GEVEL_PROGRESS_SURVEY,
+	GEVEL_PROGRESS_BTREE_DEDUP_STAT,
+	GEVEL_PROGRESS_BTREE_PIVOT_STAT,
+	GEVEL_PROGRESS_BTREE_PREFIX_STAT,
+	GEVEL_PROGRESS_BTREE_BLOAT_STAT,
+	GEVEL_PROGRESS_LEAF_CHAIN_STAT,
+	GEVEL_PROGRESS_INDEX_HEAP_CORRELATION
+} GevelProgressFunction;
+
+#define GEVEL_PROGRESS_PHASE_INDEX	1
+#define GEVEL_PROGRESS_PHASE_HEAP	2
+
+/* st_progress_param slots, gevel's own ones are not read by CREATE INDEX */
+#define GEVEL_PROGRESS_FUNCTION		1
+#define GEVEL_PROGRESS_PHASE		2
+#define GEVEL_PROGRESS_INDEX		PROGRESS_CREATEIDX_INDEX_OID
+#define GEVEL_PROGRESS_TUPLES_DONE	PROGRESS_CREATEIDX_TUPLES_DONE
+#define GEVEL_PROGRESS_BLOCKS_TOTAL	PROGRESS_SCAN_BLOCKS_TOTAL
+#define GEVEL_PROGRESS_BLOCKS_DONE	PROGRESS_SCAN_BLOCKS_DONE
+#define GEVEL_PROGRESS_LEVEL		17
+#define GEVEL_PROGRESS_TAG			19
+#define GEVEL_PROGRESS_MAGIC		INT64CONST(0x6765766C)	/* "gevl" */
+
+static int64	progressBlocks = 0;
+static int64	progressTuples = 0;
+
+#if PG_VERSION_NUM >= 120000
+/*
+ * gevel.instrument: the progress calls are made at every page a walker
+ * reads, right after ReadBuffer, so they also collect what the call
+ * costs: buffers, I/O time, pages and time per tree level, the time
+ * spent opening the index (mostly its lock) and peak memory. The report
+ * is a NOTICE raised when the walker ends.
+ */
+#define GEVEL_INSTR_LEVELS	32		/* deeper levels are added to the last */
+#define GEVEL_INSTR_MEM_EVERY	64		/* pages between two memory samples */
+
+static const char *const gevelFunctionNames[] = {
+	"",
+	"gist_tree", "gist_stat", "gist_print",
+	"gin_stat", "gin_statpage",
+	"spgist_stat", "spgist_print", "spgist_level_stat",
+	"btree_stat", "btree_tree", "btree_print",
+	"brin_stat", "brin_print", "brin_overlap_stat", "brin_query_estimate",
+	"brin_summary_stat", "brin_summary_print", "brin_ppr_advisor",
+	"hash_stat", "hash_print",
+	"gevel_survey",
+	"btree_dedup_stat", "btree_pivot_stat", "btree_prefix_stat",
+	"btree_bloat_stat", "leaf_chain_stat", "index_heap_correlation"
+};
+
+typedef struct GevelInstrument
+{
+	bool		active;
+	GevelProgressFunction func;
+	char		relname[NAMEDATALEN];
+	instr_time	start;
+	instr_time	last;			/* previous page */
+	bool		started;		/* a page has been read */
+	double		startup;		/* ms before the first page */
+	double		lockwait;		/* ms in index open before the start */
+	int			level;			/* level of the previous page, -1 none */
+	int64		levelPages[GEVEL_INSTR_LEVELS];
+	double		levelTime[GEVEL_INSTR_LEVELS];
+	int64		otherPages;		/* pages without a level */
+	double		otherTime;
+	int64		pages;			/* all pages, for memory sampling */
+	BufferUsage	bufStart;
+#if PG_VERSION_NUM >= 130000
+	Size		memStart;
+	Size		memPeak;
+#endif
+} GevelInstrument;
+
+static bool				gevelInstrumentOn = false;
+static GevelInstrument	gevelInstr;
+static char			   *gevelInstrLast = NULL;	/* last report, in TopMemoryContext */
+
+/*
+ * Walking the whole memory context tree is not cheap, so the peak is
+ * taken from a sample at the start, every GEVEL_INSTR_MEM_EVERY pages
+ * and at the end.
+ */
+static void
+gevel_instrument_memory(void) {
+#if PG_VERSION_NUM >= 130000
+	Size		mem = MemoryContextMemAllocated(TopMemoryContext, true);
+
+	if (mem > gevelInstr.memPeak)
+		gevelInstr.memPeak = mem;
+#endif
+}
+
+static void
+gevel_instrument_start(GevelProgressFunction func, Relation rel) {
+	double		lockwait = gevelLockWait;
+
+	/* whatever was left by a call that did not reach here is dropped */
+	gevelLockWait = 0;
+	memset(&gevelInstr, 0, sizeof(gevelInstr));
+
+	if (!gevelInstrumentOn)
+		return;
+
+	gevelInstr.active = true;
+	gevelInstr.func = func;
+	if (rel)
+		strlcpy(gevelInstr.relname, RelationGetRelationName(rel), NAMEDATALEN);
+	gevelInstr.level = -1;
+	gevelInstr.lockwait = lockwait;
+	gevelInstr.bufStart = pgBufferUsage;
+	INSTR_TIME_SET_CURRENT(gevelInstr.start);
+	gevelInstr.last = gevelInstr.start;
+#if PG_VERSION_NUM >= 130000
+	gevelInstr.memStart = gevelInstr.memPeak =
+		MemoryContextMemAllocated(TopMemoryContext, true);
+#endif
+}
+
+/* a call that errors out leaves its counters behind */
+static void
+gevel_instrument_reset(void) {
+	gevelInstr.active = false;
+	gevelLockWait = 0;
+}
+
+static void
+gevel_instrument_xact(XactEvent event, void *arg) {
+	if (event == XACT_EVENT_ABORT || event == XACT_EVENT_PARALLEL_ABORT)
+		gevel_instrument_reset();
+}
+
+static void
+gevel_instrument_subxact(SubXactEvent event, SubTransactionId mySubid,
+						 SubTransactionId parentSubid, void *arg) {
+	if (event == SUBXACT_EVENT_ABORT_SUB)
+		gevel_instrument_reset();
+}
+
+/* charge the time since the previous page to that page's level */
+static void
+gevel_instrument_tick(void) {
+	instr_time	now,
+				elapsed;
+	double		ms;
+
+	INSTR_TIME_SET_CURRENT(now);
+	elapsed = now;
+	INSTR_TIME_SUBTRACT(elapsed, gevelInstr.last);
+	gevelInstr.last = now;
+	ms = INSTR_TIME_GET_MILLISEC(elapsed);
+
+	if (!gevelInstr.started)
+		gevelInstr.startup += ms;
+	else if (gevelInstr.level < 0)
+		gevelInstr.otherTime += ms;
+	else
+		gevelInstr.levelTime[Min(gevelInstr.level, GEVEL_INSTR_LEVELS - 1)] += ms;
+}
+
+static void
+gevel_instrument_page(int64 nblocks, int level) {
+	if (!gevelInstr.active)
+		return;
+
+	gevel_instrument_tick();
+	gevelInstr.started = true;
+
+	gevelInstr.pages++;
+	if (gevelInstr.pages % GEVEL_INSTR_MEM_EVERY == 0)
+		gevel_instrument_memory();
+
+	/* physical scans keep no level, tree walkers report every page */
+	if (level >= 0)
+		gevelInstr.level = level;
+
+	if (gevelInstr.level < 0)
+		gevelInstr.otherPages += nblocks;
+	else
+		gevelInstr.levelPages[Min(gevelInstr.level, GEVEL_INSTR_LEVELS - 1)] += nblocks;
+}
+
+static void
+gevel_instrument_report(void) {
+	StringInfoData	buf;
+	BufferUsage		usage;
+	instr_time		total;
+	int				i;
+
+	if (!gevelInstr.active)
+		return;
+	gevelInstr.active = false;
+
+	gevel_instrument_tick();
+	gevel_instrument_memory();
+	total = gevelInstr.last;
+	INSTR_TIME_SUBTRACT(total, gevelInstr.start);
+
+	usage.shared_blks_hit = pgBufferUsage.shared_blks_hit - gevelInstr.bufStart.shared_blks_hit;
+	usage.shared_blks_read = pgBufferUsage.shared_blks_read - gevelInstr.bufStart.shared_blks_read;
+	usage.shared_blks_dirtied = pgBufferUsage.shared_blks_dirtied - gevelInstr.bufStart.shared_blks_dirtied;
+	usage.blk_read_time = pgBufferUsage.blk_read_time;
+	INSTR_TIME_SUBTRACT(usage.blk_read_time, gevelInstr.bufStart.blk_read_time);
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "Buffers: shared hit=" INT64_FORMAT " read=" INT64_FORMAT
+					 " dirtied=" INT64_FORMAT,
+					 (int64) usage.shared_blks_hit, (int64) usage.shared_blks_read,
+					 (int64) usage.shared_blks_dirtied);
+	if (track_io_timing)
+		appendStringInfo(&buf, "\nI/O Timings: read=%.3f ms",
+						 INSTR_TIME_GET_MILLISEC(usage.blk_read_time));
+	appendStringInfo(&buf, "\nLock Wait: %.3f ms",
+					 gevelInstr.lockwait + gevelLockWait);
+	gevelLockWait = 0;
+#if PG_VERSION_NUM >= 130000
+	appendStringInfo(&buf, "\nPeak Memory: %zu kB",
+					 (gevelInstr.memPeak - gevelInstr.memStart + 1023) / 1024);
+#endif
+	appendStringInfo(&buf, "\nStartup: %.3f ms", gevelInstr.startup);
+	for (i = 0; i < GEVEL_INSTR_LEVELS; i++)
+		if (gevelInstr.levelPages[i] > 0)
+			appendStringInfo(&buf, "\nLevel %d%s: pages=" INT64_FORMAT " time=%.3f ms",
+							 i, (i == GEVEL_INSTR_LEVELS - 1) ? "+" : "",
+							 gevelInstr.levelPages[i], gevelInstr.levelTime[i]);
+	if (gevelInstr.otherPages > 0)
+		appendStringInfo(&buf, "\nBlocks: " INT64_FORMAT " time=%.3f ms",
+						 gevelInstr.otherPages, gevelInstr.otherTime);
+
+	if (gevelInstrLast)
+		pfree(gevelInstrLast);
+	gevelInstrLast = MemoryContextStrdup(TopMemoryContext,
+						psprintf("%s(%s): %.3f ms\n%s",
+								 gevelFunctionNames[gevelInstr.func], gevelInstr.relname,
+								 INSTR_TIME_GET_MILLISEC(total), buf.data));
+
+	ereport(NOTICE,
+			(errmsg("%s(%s): %.3f ms",
+					gevelFunctionNames[gevelInstr.func], gevelInstr.relname,
+					INSTR_TIME_GET_MILLISEC(total)),
+			 errdetail_internal("%s", buf.data)));
+
+	pfree(buf.data);
+}
+
+/*
+ * The last gevel.instrument report of this backend, message and detail
+ * lines, or NULL.
+ *
+ * SELECT gevel_instrument_last();
+ */
+PG_FUNCTION_INFO_V1(gevel_instrument_last);
+Datum gevel_instrument_last(PG_FUNCTION_ARGS);
+Datum
+gevel_instrument_last(PG_FUNCTION_ARGS)
+{
+	if (gevelInstrLast == NULL)
+		PG_RETURN_NULL();
+
+	PG_RETURN_TEXT_P(cstring_to_text(gevelInstrLast));
+}
+
+void		_PG_init(void);
+
+void
+_PG_init(void)
+{
+	DefineCustomBoolVariable("gevel.instrument",
+							 "Reports buffers, timing and memory of every gevel call.",
+							 "The report is raised as a NOTICE when the call ends.",
+							 &gevelInstrumentOn,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL, NULL, NULL);
+#if PG_VERSION_NUM >= 150000
+	MarkGUCPrefixReserved("gevel");
+#endif
+	RegisterXactCallback(gevel_instrument_xact, NULL);
+	RegisterSubXactCallback(gevel_instrument_subxact, NULL);
+}
+#endif
+
+static void
+gevel_progress_start(GevelProgressFunction func, Relation rel) {
+#if PG_VERSION_NUM >= 120000
+	const int	params[] = {
+		GEVEL_PROGRESS_TAG,
+		GEVEL_PROGRESS_FUNCTION,
+		GEVEL_PROGRESS_PHASE,
+		GEVEL_PROGRESS_BLOCKS_TOTAL,
+		GEVEL_PROGRESS_INDEX
+	};
+	int64		values[5];
+
+	progressBlocks = progressTuples = 0;
+
+	pgstat_progress_start_command(PROGRESS_COMMAND_CREATE_INDEX,
+								  rel ? RelationGetRelid(rel) : InvalidOid);
+
+	values[0] = GEVEL_PROGRESS_MAGIC;
+	values[1] = func;
+	values[2] = GEVEL_PROGRESS_PHASE_INDEX;
+	values[3] = rel ? RelationGetNumberOfBlocks(rel) : 0;
+	values[4] = (rel && rel->rd_rel->relkind == RELKIND_INDEX) ?
+		RelationGetRelid(rel) : InvalidOid;
+	pgstat_progress_update_multi_param(5, params, values);
+
+	gevel_instrument_start(func, rel);
+#endif
+}
+
+/* switch to another phase scanning nblocks blocks */
+static void
+gevel_progress_phase(int phase, BlockNumber nblocks) {
+#if PG_VERSION_NUM >= 120000
+	const int	params[] = {
+		GEVEL_PROGRESS_PHASE,
+		GEVEL_PROGRESS_BLOCKS_TOTAL,
+		GEVEL_PROGRESS_BLOCKS_DONE
+	};
+	int64		values[3];
+
+	progressBlocks = 0;
+
+	values[0] = phase;
+	values[1] = nblocks;
+	values[2] = 0;
+	pgstat_progress_update_multi_param(3, params, values);
+#endif
+}
+
+/* nblocks more blocks done at the given level (unchanged if < 0) */
+static void
+gevel_progress_update(int64 nblocks, int level, int64 ntuples) {
+#if PG_VERSION_NUM >= 120000
+	const int	params[] = {
+		GEVEL_PROGRESS_BLOCKS_DONE,
+		GEVEL_PROGRESS_TUPLES_DONE,
+		GEVEL_PROGRESS_LEVEL
+	};
+	int64		values[3];
+
+	progressBlocks += nblocks;
+	progressTuples += ntuples;
+
+	values[0] = progressBlocks;
+	values[1] = progressTuples;
+	values[2] = level;
+	pgstat_progress_update_multi_param((level < 0) ? 2 : 3, params, values);
+
+	gevel_instrument_page(nblocks, level);
+#endif
+}
+
+static void
+gevel_progress_end(void) {
+#if PG_VERSION_NUM >= 120000
+	gevel_instrument_report();
+	pgstat_progress_end_command();
+#endif
+}
+
+#if PG_VERSION_NUM >= 120000
+static void
+gevel_progress_shutdown(Datum arg) {
+	gevel_instrument_report();
+	pgstat_progress_end_command();
+}
+#endif
+
+/*
+ * Value-per-call functions may be stopped before they return the last
+ * row (LIMIT, cursors), so they end the reporting when the executor shuts
+ * the function down as well. When they return the last row they end it
+ * themselves and unregister the callback, which would otherwise end the
+ * reporting of another walker started since in the same query.
+ */
+static void
+gevel_progress_register(FunctionCallInfo fcinfo) {
+#if PG_VERSION_NUM >= 120000
+	ReturnSetInfo	*rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	if (rsinfo && IsA(rsinfo, ReturnSetInfo))
+		RegisterExprContextCallback(rsinfo->econtext,
+									gevel_progress_shutdown, (Datum) 0);
+#endif
+}
+
+static void
+gevel_progress_unregister(FunctionCallInfo fcinfo) {
+#if PG_VERSION_NUM >= 120000
+	ReturnSetInfo	*rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	if (rsinfo && IsA(rsinfo, ReturnSetInfo))
+		UnregisterExprContextCallback(rsinfo->econtext,
+									  gevel_progress_shutdown, (Datum) 0);
+#endif
+}
+
 static void
 gist_dumptree(Relation r, int level, BlockNumber blk, OffsetNumber coff, IdxInfo *info) {
 	Buffer		buffer;
@@ -227,7 +817,7 @@ gist_dumptree(Relation r, int level, BlockNumber blk, OffsetNumber coff, IdxInfo
 	page = (Page) BufferGetPage(buffer);
 
 	maxoff = PageGetMaxOffsetNumber(page);
-
+	gevel_progress_update(1, level, maxoff);
 
 	while ( (info->ptr-((char*)info->txt)) + level*4 + 128 >= info->len ) {
 		int dist=info->ptr-((char*)info->txt);
@@ -236,7 +826,7 @@ gist_dumptree(Relation r, int level, BlockNumber blk, OffsetNumber coff, IdxInfo
 		info->ptr = ((char*)info->txt)+dist;
 	}
 
-	sprintf(info->ptr, "%s%d(l:%d) blk: %u numTuple: %d free: %db(%.2f%%) rightlink:%u (%s)\n",
+	sprintf(info->ptr, GIST_TREE_LINE,
 		pred,
 		coff,
 		level,
@@ -280,7 +870,9 @@ gist_tree(PG_FUNCTION_ARGS) {
 	info.txt=(text*)palloc( info.len );
 	info.ptr=((char*)info.txt)+VARHDRSZ;
 
+	gevel_progress_start(GEVEL_PROGRESS_GIST_TREE, index);
 	gist_dumptree(index, 0, GIST_ROOT_BLKNO, 0, &info);
+	gevel_progress_end();
 
 	gist_index_close(index);
 	pfree(relname);
@@ -289,17 +881,20 @@ gist_tree(PG_FUNCTION_ARGS) {
 	PG_RETURN_POINTER(info.txt);
 }
 
-typedef struct {
-	int		level;
-	int		numpages;
-	int		numleafpages;
-	int		numtuple;
-	int		numinvalidtuple;
-	int		numleaftuple;
-	uint64	tuplesize;
-	uint64	leaftuplesize;
-	uint64	totalsize;
-} IdxStat;
+static text *
+formatIdxStat(IdxStat *info) {
+	char buf[1024];
+	int len;
+	text *out;
+
+	idxstat_format(info, buf, sizeof(buf));
+	len = strlen(buf);
+
+	out=(text*)palloc(len + VARHDRSZ);
+	memcpy(VARDATA(out), buf, len);
+	SET_VARSIZE(out, len + VARHDRSZ);
+	return out;
+}
 
 static void
 gist_stattree(Relation r, int level, BlockNumber blk, OffsetNumber coff, IdxStat *info) {
@@ -320,6 +915,7 @@ gist_stattree(Relation r, int level, BlockNumber blk, OffsetNumber coff, IdxStat
 	page = (Page) BufferGetPage(buffer);
 
 	maxoff = PageGetMaxOffsetNumber(page);
+	gevel_progress_update(1, level, maxoff);
 
 	info->numpages++;
 	info->tuplesize+=PAGESIZE-PageGetFreeSpace(page);
@@ -357,9 +953,6 @@ gist_stat(PG_FUNCTION_ARGS) {
 	Relation		index;
 	List	   *relname_list;
 	IdxStat	info;
-	text *out=(text*)palloc(1024);
-	char *ptr=((char*)out)+VARHDRSZ;
-
 
 	relname_list = stringToQualifiedNameList(relname, "gist_tree");
 	relvar = makeRangeVarFromNameList(relname_list);
@@ -368,88 +961,28 @@ gist_stat(PG_FUNCTION_ARGS) {
 
 	memset(&info, 0, sizeof(IdxStat));
 
+	gevel_progress_start(GEVEL_PROGRESS_GIST_STAT, index);
 	gist_stattree(index, 0, GIST_ROOT_BLKNO, 0, &info);
+	gevel_progress_end();
 
 	gist_index_close(index);
 	pfree(relname);
 
-	sprintf(ptr,
-		"Number of levels:          %d\n"
-		"Number of pages:           %d\n"
-		"Number of leaf pages:      %d\n"
-		"Number of tuples:          %d\n"
-		"Number of invalid tuples:  %d\n"
-		"Number of leaf tuples:     %d\n"
-		"Total size of tuples:      "INT64_FORMAT" bytes\n"
-		"Total size of leaf tuples: "INT64_FORMAT" bytes\n"
-		"Total size of index:       "INT64_FORMAT" bytes\n",
-		info.level+1,
-		info.numpages,
-		info.numleafpages,
-		info.numtuple,
-		info.numinvalidtuple,
-		info.numleaftuple,
-		info.tuplesize,
-		info.leaftuplesize,
-		info.totalsize);
-
-	ptr=strchr(ptr,'\0');
-
-	SET_VARSIZE(out, ptr-((char*)out));
-	PG_RETURN_POINTER(out);
-}
-
-typedef struct GPItem {
-	Buffer	buffer;
-	Page	page;
-	OffsetNumber	offset;
-	int	level;
-	struct GPItem *next;
-} GPItem;
-
-typedef struct {
-	List	*relname_list;
-	RangeVar   *relvar;
-	Relation		index;
-	Datum	*dvalues;
-#if PG_VERSION_NUM >= 90600
-	bool	*nulls;
-#else
-	char	*nulls;
-#endif
-	GPItem	*item;
-} TypeStorage;
-
-static GPItem*
-openGPPage( FuncCallContext *funcctx, BlockNumber blk ) {
-	GPItem	*nitem;
-	MemoryContext	 oldcontext;
-	Relation index = ( (TypeStorage*)(funcctx->user_fctx) )->index;
-
-	oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
-	nitem = (GPItem*)palloc( sizeof(GPItem) );
-	memset(nitem,0,sizeof(GPItem));
-
-	nitem->buffer = ReadBuffer(index, blk);
-	nitem->page = (Page) BufferGetPage(nitem->buffer);
-	nitem->offset=FirstOffsetNumber;
-	nitem->next = ( (TypeStorage*)(funcctx->user_fctx) )->item;
-	nitem->level = ( nitem->next ) ? nitem->next->level+1 : 1;
-	( (TypeStorage*)(funcctx->user_fctx) )->item = nitem;
-
-	MemoryContextSwitchTo(oldcontext);
-	return nitem;
+	PG_RETURN_POINTER(formatIdxStat(&info));
 }
 
-static GPItem*
-closeGPPage( FuncCallContext *funcctx ) {
-	GPItem  *oitem = ( (TypeStorage*)(funcctx->user_fctx) )->item;
-
-	( (TypeStorage*)(funcctx->user_fctx) )->item = oitem->next;
+/*
+ * The print functions read every page from a private copy taken under a
+ * short share lock, the buffer is released before the rows of the page
+ * are stored and no lock is held while the tree is walked.
+ */
+static Page
+gevel_copy_page(MemoryContext mcxt, Buffer buffer)
+{
+	Page	page = (Page) MemoryContextAlloc(mcxt, BLCKSZ);
 
-	ReleaseBuffer(oitem->buffer);
-	pfree( oitem );
-	return ( (TypeStorage*)(funcctx->user_fctx) )->item;
+	memcpy(page, BufferGetPage(buffer), BLCKSZ);
+	return page;
 }
 
 #if PG_VERSION_NUM >= 110000
@@ -458,135 +991,205 @@ closeGPPage( FuncCallContext *funcctx ) {
 #define TS_GET_TYPEVAL(s, i, v)	(s)->index->rd_att->attrs[(i)]->v
 #endif
 
-static void
-setup_firstcall(FuncCallContext  *funcctx, text *name) {
-	MemoryContext	 oldcontext;
-	TypeStorage	 *st;
-	char *relname=t2c(name);
-	TupleDesc			tupdesc;
-	char			attname[NAMEDATALEN];
-	int i;
-
-	oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
-
-	st=(TypeStorage*)palloc( sizeof(TypeStorage) );
-	memset(st,0,sizeof(TypeStorage));
-	st->relname_list = stringToQualifiedNameList(relname, "gist_tree");
-	st->relvar = makeRangeVarFromNameList(st->relname_list);
-	st->index = gist_index_open(st->relvar);
-	funcctx->user_fctx = (void*)st;
+/*
+ * Row type of gist_print: level, valid and one column per index attribute
+ */
+static TupleDesc
+gist_print_tupdesc(Relation index) {
+	TupleDesc	tupdesc;
+	char		attname[NAMEDATALEN];
+	int			i;
 
 #if PG_VERSION_NUM >= 120000
-	tupdesc = CreateTemplateTupleDesc(st->index->rd_att->natts+2);
+	tupdesc = CreateTemplateTupleDesc(index->rd_att->natts+2);
 #else
 	tupdesc = CreateTemplateTupleDesc(3 /* types */ + 1 /* level */ + 1 /* nlabel */ +  2 /* tids */ + 1, false);
 #endif
 	TupleDescInitEntry(tupdesc, 1, "level", INT4OID, -1, 0);
 	TupleDescInitEntry(tupdesc, 2, "valid", BOOLOID, -1, 0);
-	for (i = 0; i < st->index->rd_att->natts; i++) {
+	for (i = 0; i < index->rd_att->natts; i++) {
 		sprintf(attname, "z%d", i+2);
 		TupleDescInitEntry(
 			tupdesc,
 			i+3,
 			attname,
-			TS_GET_TYPEVAL(st, i, atttypid),
-			TS_GET_TYPEVAL(st, i, atttypmod),
-			TS_GET_TYPEVAL(st, i, attndims)
+#if PG_VERSION_NUM >= 110000
+			index->rd_att->attrs[i].atttypid,
+			index->rd_att->attrs[i].atttypmod,
+			index->rd_att->attrs[i].attndims
+#else
+			index->rd_att->attrs[i]->atttypid,
+			index->rd_att->attrs[i]->atttypmod,
+			index->rd_att->attrs[i]->attndims
+#endif
 		);
 	}
 
-	st->dvalues = (Datum *) palloc((tupdesc->natts+2) * sizeof(Datum));
-	st->nulls = palloc((tupdesc->natts+2) * sizeof(*st->nulls));
-
-#if PG_VERSION_NUM >= 120000
-	funcctx->attinmeta = TupleDescGetAttInMetadata(tupdesc);
-#else
-	funcctx->slot = TupleDescGetSlot(tupdesc);
-#endif
+	return tupdesc;
+}
 
-	MemoryContextSwitchTo(oldcontext);
-	pfree(relname);
+/* number of levels below blkno, following the leftmost downlinks */
+static int
+gist_tree_depth(Relation index, BlockNumber blkno)
+{
+	int			depth = 0;
 
-	st->item=openGPPage(funcctx, GIST_ROOT_BLKNO);
-}
+	for (;;)
+	{
+		Buffer		buf;
+		Page		page;
+		IndexTuple	itup;
 
-static void
-close_call( FuncCallContext  *funcctx ) {
-	TypeStorage *st = (TypeStorage*)(funcctx->user_fctx);
+		buf = ReadBuffer(index, blkno);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
 
-	while(st->item && closeGPPage(funcctx));
+		if (GistPageIsLeaf(page) || PageGetMaxOffsetNumber(page) < FirstOffsetNumber)
+		{
+			UnlockReleaseBuffer(buf);
+			break;
+		}
 
-	pfree(st->dvalues);
-	pfree(st->nulls);
+		itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, FirstOffsetNumber));
+		blkno = ItemPointerGetBlockNumber(&itup->t_tid);
+		UnlockReleaseBuffer(buf);
+		depth++;
+	}
 
-	gist_index_close(st->index);
+	return depth;
 }
 
-PG_FUNCTION_INFO_V1(gist_print);
-Datum	gist_print(PG_FUNCTION_ARGS);
-Datum
-gist_print(PG_FUNCTION_ARGS) {
-	FuncCallContext  *funcctx;
-	TypeStorage	 *st;
-	Datum result=(Datum)0;
-	ItemId		  iid;
-	IndexTuple	  ituple;
-	HeapTuple	   htuple;
-	int i;
-	bool isnull;
+/*
+ * gist_print walks the tree depth-first one page at a time: the page is
+ * copied, released, and all of its rows are put into the tuplestore in
+ * one loop, so a full dump pays neither the per-row SRF protocol nor a
+ * heap_formtuple per row, and spills to disk beyond work_mem. The
+ * executor takes a materialized result in FROM and in the target list.
+ */
+typedef struct GistPrint {
+	Relation		index;
+	int				minlevel;	/* rows above it are not returned */
+	int				maxlevel;	/* pages below it are not read */
+	TupleDesc		tupdesc;
+	Tuplestorestate	*tupstore;
+	Datum			*dvalues;
+	bool			*nulls;
+} GistPrint;
 
-	if (SRF_IS_FIRSTCALL()) {
-		text	*name=PG_GETARG_TEXT_P(0);
-		funcctx = SRF_FIRSTCALL_INIT();
-		setup_firstcall(funcctx, name);
-		PG_FREE_IF_COPY(name,0);
-	}
+static void
+gist_print_page(GistPrint *prst, BlockNumber blk, int level) {
+	Buffer			buffer;
+	Page			page;
+	OffsetNumber	i,
+					maxoff;
 
-	funcctx = SRF_PERCALL_SETUP();
-	st = (TypeStorage*)(funcctx->user_fctx);
+	CHECK_FOR_INTERRUPTS();
 
-	if ( !st->item ) {
-		close_call(funcctx);
-		SRF_RETURN_DONE(funcctx);
-	}
+	buffer = ReadBuffer(prst->index, blk);
+	LockBuffer(buffer, BUFFER_LOCK_SHARE);
+	page = gevel_copy_page(CurrentMemoryContext, buffer);
+	UnlockReleaseBuffer(buffer);
 
-	while( st->item->offset > PageGetMaxOffsetNumber( st->item->page ) ) {
-		if ( ! closeGPPage(funcctx) ) {
-			close_call(funcctx);
-			SRF_RETURN_DONE(funcctx);
+	maxoff = PageGetMaxOffsetNumber(page);
+	gevel_progress_update(1, level, maxoff);
+
+	for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i)) {
+		IndexTuple	ituple = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+		bool		invalid = !GistPageIsLeaf(page) && GistTupleIsInvalid(ituple);
+		int			j;
+
+		prst->dvalues[0] = Int32GetDatum(level);
+		prst->nulls[0] = false;
+		prst->dvalues[1] = BoolGetDatum(!invalid);
+		prst->nulls[1] = false;
+		for (j = 2; j < prst->tupdesc->natts; j++) {
+			if (invalid) {
+				prst->dvalues[j] = (Datum) 0;
+				prst->nulls[j] = true;
+			} else
+				prst->dvalues[j] = index_getattr(ituple, j-1, prst->index->rd_att, &prst->nulls[j]);
 		}
+
+		if (level >= prst->minlevel)
+			tuplestore_putvalues(prst->tupstore, prst->tupdesc, prst->dvalues, prst->nulls);
+
+		if (!GistPageIsLeaf(page) && level < prst->maxlevel)
+			gist_print_page(prst, ItemPointerGetBlockNumber(&(ituple->t_tid)), level+1);
 	}
 
-	iid = PageGetItemId( st->item->page, st->item->offset );
-	ituple = (IndexTuple) PageGetItem(st->item->page, iid);
+	pfree(page);
+}
 
-	st->dvalues[0] = Int32GetDatum( st->item->level );
-	st->nulls[0] = ISNOTNULL;
-	st->dvalues[1] = BoolGetDatum( (!GistPageIsLeaf(st->item->page) && GistTupleIsInvalid(ituple)) ? false : true );
-	st->nulls[1] = ISNOTNULL;
-	for(i=2; i<funcctx->attinmeta->tupdesc->natts; i++)
-	{
-		if ( !GistPageIsLeaf(st->item->page) && GistTupleIsInvalid(ituple) )
-		{
-			st->dvalues[i] = (Datum)0;
-			st->nulls[i] = ISNULL;
-		} else {
-			st->dvalues[i] = index_getattr(ituple, i-1, st->index->rd_att, &isnull);
-			st->nulls[i] = ( isnull ) ? ISNULL : ISNOTNULL;
+PG_FUNCTION_INFO_V1(gist_print);
+Datum	gist_print(PG_FUNCTION_ARGS);
+Datum
+gist_print(PG_FUNCTION_ARGS) {
+	text		*name=PG_GETARG_TEXT_P(0);
+	char		*relname=t2c(name);
+	GistPrint	prst;
+	BlockNumber	blkno = GIST_ROOT_BLKNO;
+	int			level = 1;
+
+	prst.index = gist_print_open(makeRangeVarFromNameList(
+								stringToQualifiedNameList(relname, "gist_tree")));
+	prst.minlevel = 1;
+	prst.maxlevel = INT_MAX;
+
+	/*
+	 * gist_print(name, min_level, max_level [, blkno]): the walk starts at
+	 * blkno and does not read below max_level. Levels stay numbered from
+	 * the root, GiST being balanced the level of blkno is known from the
+	 * heights of the tree and of its subtree.
+	 */
+	if (PG_NARGS() > 1) {
+		prst.minlevel = PG_GETARG_INT32(1);
+		prst.maxlevel = PG_GETARG_INT32(2);
+
+		if (PG_NARGS() > 3) {
+			int32	arg = PG_GETARG_INT32(3);
+			Buffer	buffer;
+			bool	deleted;
+
+			if (arg < 0 || arg >= RelationGetNumberOfBlocks(prst.index))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("block number %d is out of range for index \"%s\"",
+								arg, RelationGetRelationName(prst.index))));
+			blkno = (BlockNumber) arg;
+
+			buffer = ReadBuffer(prst.index, blkno);
+			LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			deleted = PageIsNew(BufferGetPage(buffer)) ||
+				GistPageIsDeleted(BufferGetPage(buffer));
+			UnlockReleaseBuffer(buffer);
+			if (deleted)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("block %u of index \"%s\" is not in the tree",
+								blkno, RelationGetRelationName(prst.index))));
+
+			level += gist_tree_depth(prst.index, GIST_ROOT_BLKNO) -
+				gist_tree_depth(prst.index, blkno);
 		}
 	}
 
-	htuple = heap_formtuple(funcctx->attinmeta->tupdesc, st->dvalues, st->nulls);
-#if PG_VERSION_NUM >= 120000
-	result = HeapTupleGetDatum(htuple);
-#else
-	result = TupleGetDatum(funcctx->slot, htuple);
-#endif
-	st->item->offset = OffsetNumberNext(st->item->offset);
-	if ( !GistPageIsLeaf(st->item->page) )
-		openGPPage(funcctx, ItemPointerGetBlockNumber(&(ituple->t_tid)) );
+	prst.tupdesc = gist_print_tupdesc(prst.index);
+	prst.tupstore = materializeSetup(fcinfo, prst.tupdesc);
+	prst.dvalues = (Datum *) palloc(prst.tupdesc->natts * sizeof(Datum));
+	prst.nulls = (bool *) palloc(prst.tupdesc->natts * sizeof(bool));
 
-	SRF_RETURN_NEXT(funcctx, result);
+	gevel_progress_start(GEVEL_PROGRESS_GIST_PRINT, prst.index);
+	if (level <= prst.maxlevel)
+		gist_print_page(&prst, blkno, level);
+	gevel_progress_end();
+
+	pfree(prst.dvalues);
+	pfree(prst.nulls);
+	gist_print_close(prst.index);
+	pfree(relname);
+	PG_FREE_IF_COPY(name,0);
+
+	return (Datum) 0;
 }
 
 typedef struct GinStatState {
@@ -626,6 +1229,7 @@ moveRightIfItNeeded( GinStatState *st )
 		st->buffer = ReleaseAndReadBuffer(st->buffer, st->index, blkno);
 		LockBuffer(st->buffer, GIN_SHARE);
 		st->offset = FirstOffsetNumber;
+		gevel_progress_update(1, -1, 0);
 	}
 
 	return true;
@@ -723,6 +1327,7 @@ gin_setup_firstcall(FuncCallContext  *funcctx, text *name, int attnum) {
 	memset(st,0,sizeof(GinStatState));
 	st->index = gin_index_open(
 		 makeRangeVarFromNameList(stringToQualifiedNameList(relname, "gin_stat")));
+	gevel_progress_start(GEVEL_PROGRESS_GIN_STAT, st->index);
 	initGinState( &st->ginstate, st->index );
 
 #if PG_VERSION_NUM >= 80400
@@ -867,6 +1472,7 @@ gin_stat(PG_FUNCTION_ARGS) {
 	if (SRF_IS_FIRSTCALL()) {
 		text	*name=PG_GETARG_TEXT_P(0);
 		funcctx = SRF_FIRSTCALL_INIT();
+		gevel_progress_register(fcinfo);
 		gin_setup_firstcall(funcctx, name, (PG_NARGS()==2) ? PG_GETARG_INT32(1) : 0 );
 		PG_FREE_IF_COPY(name,0);
 	}
@@ -876,6 +1482,8 @@ gin_stat(PG_FUNCTION_ARGS) {
 
 	if ( refindPosition(st) == false ) {
 		UnlockReleaseBuffer( st->buffer );
+		gevel_progress_unregister(fcinfo);
+		gevel_progress_end();
 		gin_index_close(st->index);
 
 		SRF_RETURN_DONE(funcctx);
@@ -886,6 +1494,8 @@ gin_stat(PG_FUNCTION_ARGS) {
 
 		if (moveRightIfItNeeded(st)==false) {
 			UnlockReleaseBuffer( st->buffer );
+			gevel_progress_unregister(fcinfo);
+			gevel_progress_end();
 			gin_index_close(st->index);
 
 			SRF_RETURN_DONE(funcctx);
@@ -901,6 +1511,7 @@ gin_stat(PG_FUNCTION_ARGS) {
 	}
 
 	processTuple( funcctx,  st, ituple );
+	gevel_progress_update(0, -1, 1);
 
 	htuple = heap_formtuple(funcctx->attinmeta->tupdesc, st->dvalues, st->nulls);
 #if PG_VERSION_NUM >= 120000
@@ -990,6 +1601,38 @@ gin_count_estimate(PG_FUNCTION_ARGS) {
 }
 #endif
 
+#if PG_VERSION_NUM >= 90200
+
+#define IS_INDEX(r) ((r)->rd_rel->relkind == RELKIND_INDEX)
+#define IS_SPGIST(r) ((r)->rd_rel->relam == SPGIST_AM_OID)
+
+static Relation
+spgist_stat_open(text *name)
+{
+	RangeVar   *relvar;
+	Relation	index;
+
+	relvar = makeRangeVarFromNameList(textToQualifiedNameList(name));
+	index = gevel_relation_openrv(relvar, AccessExclusiveLock);
+
+	if (!IS_INDEX(index) || !IS_SPGIST(index))
+		elog(ERROR, "relation \"%s\" is not an SPGiST index",
+			 RelationGetRelationName(index));
+
+	return index;
+}
+
+static text *
+spgist_stat_text(SpgistStat *st)
+{
+	char		res[1024];
+
+	spgist_stat_format(st, res, sizeof(res));
+
+	return cstring_to_text(res);
+}
+#endif
+
 PG_FUNCTION_INFO_V1(spgist_stat);
 Datum spgist_stat(PG_FUNCTION_ARGS);
 Datum
@@ -1001,137 +1644,34 @@ spgist_stat(PG_FUNCTION_ARGS)
 	PG_RETURN_TEXT_P(CStringGetTextDatum("???"));
 #else
 	text	   *name = PG_GETARG_TEXT_P(0);
-	RangeVar   *relvar;
 	Relation	index;
-	BlockNumber blkno;
-	BlockNumber totalPages = 0,
-				innerPages = 0,
-				leafPages = 0,
-				emptyPages = 0,
-				deletedPages = 0;
-	double	  usedSpace = 0.0,
-			  usedLeafSpace = 0.0,
-			  usedInnerSpace = 0.0;
-	char		res[1024];
-	int		 bufferSize = -1;
-	int64	   innerTuples = 0,
-				leafTuples = 0,
-				nAllTheSame = 0,
-				nLeafPlaceholder = 0,
-				nInnerPlaceholder = 0,
-				nLeafRedirect = 0,
-				nInnerRedirect = 0;
-
-#define IS_INDEX(r) ((r)->rd_rel->relkind == RELKIND_INDEX)
-#define IS_SPGIST(r) ((r)->rd_rel->relam == SPGIST_AM_OID)
+	BlockNumber blkno,
+				nblocks;
+	SpgistStat	st;
 
-	relvar = makeRangeVarFromNameList(textToQualifiedNameList(name));
-	index = relation_openrv(relvar, AccessExclusiveLock);
-
-	if (!IS_INDEX(index) || !IS_SPGIST(index))
-		elog(ERROR, "relation \"%s\" is not an SPGiST index",
-			 RelationGetRelationName(index));
+	index = spgist_stat_open(name);
+	spgist_stat_init(&st);
 
-	totalPages = RelationGetNumberOfBlocks(index);
+	nblocks = RelationGetNumberOfBlocks(index);
+	gevel_progress_start(GEVEL_PROGRESS_SPGIST_STAT, index);
 
-	for (blkno = SPGIST_ROOT_BLKNO; blkno < totalPages; blkno++)
+	/* the metapage is not counted */
+	for (blkno = SPGIST_ROOT_BLKNO; blkno < nblocks; blkno++)
 	{
 		Buffer	  buffer;
-		Page		page;
-		int		 pageFree;
 
 		buffer = ReadBuffer(index, blkno);
 		LockBuffer(buffer, BUFFER_LOCK_SHARE);
 
-		page = BufferGetPage(buffer);
-
-		if (PageIsNew(page) || SpGistPageIsDeleted(page))
-		{
-			deletedPages++;
-			UnlockReleaseBuffer(buffer);
-			continue;
-		}
-
-		if (SpGistPageIsLeaf(page))
-		{
-			leafPages++;
-			leafTuples += PageGetMaxOffsetNumber(page);
-			nLeafPlaceholder += SpGistPageGetOpaque(page)->nPlaceholder;
-			nLeafRedirect += SpGistPageGetOpaque(page)->nRedirection;
-		}
-		else
-		{
-			int	 i,
-					max;
-
-			innerPages++;
-			max = PageGetMaxOffsetNumber(page);
-			innerTuples += max;
-			nInnerPlaceholder += SpGistPageGetOpaque(page)->nPlaceholder;
-			nInnerRedirect += SpGistPageGetOpaque(page)->nRedirection;
-			for (i = FirstOffsetNumber; i <= max; i++)
-			{
-				SpGistInnerTuple it;
-
-				it = (SpGistInnerTuple) PageGetItem(page,
-													PageGetItemId(page, i));
-				if (it->allTheSame)
-					nAllTheSame++;
-			}
-		}
-
-		if (bufferSize < 0)
-			bufferSize = BufferGetPageSize(buffer)
-				- MAXALIGN(sizeof(SpGistPageOpaqueData))
-				- SizeOfPageHeaderData;
-
-		pageFree = PageGetExactFreeSpace(page);
-
-		usedSpace += bufferSize - pageFree;
-		if (SpGistPageIsLeaf(page))
-			usedLeafSpace += bufferSize - pageFree;
-		else
-			usedInnerSpace += bufferSize - pageFree;
-
-		if (pageFree == bufferSize)
-			emptyPages++;
+		gevel_progress_update(1, -1, spgist_stat_page(&st, BufferGetPage(buffer)));
 
 		UnlockReleaseBuffer(buffer);
 	}
 
+	gevel_progress_end();
 	index_close(index, AccessExclusiveLock);
 
-	totalPages--;			   /* discount metapage */
-
-	snprintf(res, sizeof(res),
-			 "totalPages:        %u\n"
-			 "deletedPages:      %u\n"
-			 "innerPages:        %u\n"
-			 "leafPages:         %u\n"
-			 "emptyPages:        %u\n"
-			 "usedSpace:         %.2f kbytes\n"
-			 "usedInnerSpace:    %.2f kbytes\n"
-			 "usedLeafSpace:     %.2f kbytes\n"
-			 "freeSpace:         %.2f kbytes\n"
-			 "fillRatio:         %.2f%%\n"
-			 "leafTuples:        " INT64_FORMAT "\n"
-			 "innerTuples:       " INT64_FORMAT "\n"
-			 "innerAllTheSame:   " INT64_FORMAT "\n"
-			 "leafPlaceholders:  " INT64_FORMAT "\n"
-			 "innerPlaceholders: " INT64_FORMAT "\n"
-			 "leafRedirects:     " INT64_FORMAT "\n"
-			 "innerRedirects:    " INT64_FORMAT,
-			 totalPages, deletedPages, innerPages, leafPages, emptyPages,
-			 usedSpace / 1024.0,
-			 usedInnerSpace / 1024.0,
-			 usedLeafSpace / 1024.0,
-			 (((double) bufferSize) * ((double) totalPages) - usedSpace) / 1024,
-			 100.0 * (usedSpace / (((double) bufferSize) * ((double) totalPages))),
-			 leafTuples, innerTuples, nAllTheSame,
-			 nLeafPlaceholder, nInnerPlaceholder,
-			 nLeafRedirect, nInnerRedirect);
-
-	PG_RETURN_TEXT_P(CStringGetTextDatum(res));
+	PG_RETURN_TEXT_P(spgist_stat_text(&st));
 #endif
 }
 
@@ -1139,41 +1679,147 @@ spgist_stat(PG_FUNCTION_ARGS)
 
 typedef struct SPGistPrintStackElem {
 	ItemPointerData		iptr;
-	int16				nlabel;
 	int					level;
 } SPGistPrintStackElem;
 
+/*
+ * DFS stack of spgist_print. It is a plain growing array: push and pop
+ * are O(1) and never allocate per element.
+ */
 typedef struct SPGistPrint {
-	SpGistState	state;
-	Relation	index;
-	Datum		dvalues[8 /* see CreateTemplateTupleDesc call */];
-#if PG_VERSION_NUM >= 110000
+	SpGistState		state;
+	Relation		index;
+	TupleDesc		tupdesc;
+	Tuplestorestate	*tupstore;
+	MemoryContext	pagecxt;	/* copy of the current page */
+	Datum			dvalues[8 /* see CreateTemplateTupleDesc call */];
 	bool			nulls[8];
-#else
-	char			nulls[8];
-#endif
-	List		*stack;
+	SPGistPrintStackElem	*stack;
+	int				nstack;
+	int				maxstack;
+	int64			nrows;		/* rows not yet reported as progress */
 } SPGistPrint;
 
 static void
-pushSPGistPrint(FuncCallContext *funcctx, SPGistPrint *prst, ItemPointer ip, int level) {
-	MemoryContext	oldcontext;
-	SPGistPrintStackElem	*e;
-
-	oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+pushSPGistPrint(SPGistPrint *prst, ItemPointer ip, int level) {
+	if (prst->nstack >= prst->maxstack) {
+		prst->maxstack *= 2;
+		prst->stack = repalloc(prst->stack,
+							   sizeof(SPGistPrintStackElem) * prst->maxstack);
+	}
 
-	e = palloc(sizeof(*e));
-	e->iptr = *ip;
-	e->nlabel = 0;
-	e->level = level;
-	prst->stack = lcons(e, prst->stack);
+	prst->stack[prst->nstack].iptr = *ip;
+	prst->stack[prst->nstack].level = level;
+	prst->nstack++;
+}
 
-	MemoryContextSwitchTo(oldcontext);
+static void
+putSPGistPrint(SPGistPrint *prst) {
+	tuplestore_putvalues(prst->tupstore, prst->tupdesc, prst->dvalues, prst->nulls);
+	prst->nrows++;
 }
 
+/*
+ * Walk the tree depth-first and put a row for every live leaf tuple and
+ * for every downlink of a live inner tuple. Rows are emitted in the same
+ * order as the former per-call implementation: all downlinks of an inner
+ * tuple first, then its subtrees starting from the last one.
+ *
+ * Like gist_print, every block is copied under a short share lock and
+ * the rows are stored from the copy, which is kept while consecutive
+ * stack entries point to the same block. No buffer is locked while the
+ * tuplestore may spill to disk.
+ */
 static void
-close_spgist_print(SPGistPrint *prst) {
-	index_close(prst->index, AccessExclusiveLock);
+spgist_print_tree(SPGistPrint *prst) {
+	Buffer			buffer;
+	BlockNumber		blkno = InvalidBlockNumber;
+	Page			page = NULL;
+
+	while (prst->nstack > 0) {
+		SPGistPrintStackElem	s;
+		SpGistDeadTuple			dtuple;
+		ItemPointerData			tid;
+
+		CHECK_FOR_INTERRUPTS();
+
+		s = prst->stack[--prst->nstack];
+
+		if (!ItemPointerIsValid(&s.iptr))
+			continue;
+
+		if (ItemPointerGetBlockNumber(&s.iptr) != blkno) {
+			blkno = ItemPointerGetBlockNumber(&s.iptr);
+			buffer = ReadBuffer(prst->index, blkno);
+			LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			MemoryContextReset(prst->pagecxt);
+			page = gevel_copy_page(prst->pagecxt, buffer);
+			UnlockReleaseBuffer(buffer);
+			gevel_progress_update(1, s.level, prst->nrows);
+			prst->nrows = 0;
+		}
+
+		if (ItemPointerGetOffsetNumber(&s.iptr) > PageGetMaxOffsetNumber(page))
+			continue;
+
+		dtuple = (SpGistDeadTuple)PageGetItem(page, PageGetItemId(page, ItemPointerGetOffsetNumber(&s.iptr)));
+
+		if (dtuple->tupstate != SPGIST_LIVE)
+			continue;
+
+		tid = s.iptr;
+		prst->dvalues[0] = PointerGetDatum(&tid);
+		prst->nulls[0] = false;
+		prst->dvalues[3] = Int32GetDatum(s.level);
+		prst->nulls[3] = false;
+		/* tid_pointer has never been filled in, keep the output unchanged */
+		prst->nulls[4] = true;
+
+		if (SpGistPageIsLeaf(page)) {
+			SpGistLeafTuple	leafTuple = (SpGistLeafTuple)dtuple;
+
+			prst->nulls[1] = true;
+			prst->nulls[2] = true;
+			prst->nulls[5] = true;
+			prst->nulls[6] = true;
+			prst->dvalues[7] = SGLTDATUM(leafTuple, &prst->state);
+			prst->nulls[7] = false;
+
+			putSPGistPrint(prst);
+		} else {
+			SpGistInnerTuple	innerTuple = (SpGistInnerTuple)dtuple;
+			int					i;
+			int					nlabel = 0;
+			SpGistNodeTuple		node;
+
+			prst->dvalues[1] = BoolGetDatum(innerTuple->allTheSame);
+			prst->nulls[1] = false;
+			if (innerTuple->prefixSize > 0) {
+				prst->dvalues[5] = SGITDATUM(innerTuple, &prst->state);
+				prst->nulls[5] = false;
+			} else
+				prst->nulls[5] = true;
+			prst->nulls[7] = true;
+
+			SGITITERATE(innerTuple, i, node) {
+				if (!ItemPointerIsValid(&node->t_tid))
+					continue;
+
+				prst->dvalues[2] = Int32GetDatum(nlabel);
+				prst->nulls[2] = false;
+				if (!IndexTupleHasNulls(node)) {
+					prst->dvalues[6] = SGNTDATUM(node, &prst->state);
+					prst->nulls[6] = false;
+				} else
+					prst->nulls[6] = true;
+
+				putSPGistPrint(prst);
+
+				pushSPGistPrint(prst, &node->t_tid, s.level + 1);
+				nlabel = i + 1;
+			}
+		}
+	}
 }
 #endif
 
@@ -1187,403 +1833,627 @@ spgist_print(PG_FUNCTION_ARGS)
 
 	PG_RETURN_TEXT_P(CStringGetTextDatum("???"));
 #else
-	FuncCallContext			*funcctx;
-	SPGistPrint				*prst;
-	SPGistPrintStackElem	*s;
-	HeapTuple				htuple;
-	Datum					result;
-	MemoryContext			oldcontext;
+	text			*name=PG_GETARG_TEXT_P(0);
+	RangeVar		*relvar;
+	Relation		index;
+	ItemPointerData	ipd;
+	TupleDesc		tupdesc;
+	SPGistPrint		prst;
 
-	if (SRF_IS_FIRSTCALL()) {
-		text			*name=PG_GETARG_TEXT_P(0);
-		RangeVar		*relvar;
-		Relation		index;
-		ItemPointerData	ipd;
-		TupleDesc		tupdesc;
+	relvar = makeRangeVarFromNameList(textToQualifiedNameList(name));
+	index = gevel_relation_openrv(relvar, AccessExclusiveLock);
 
-		funcctx = SRF_FIRSTCALL_INIT();
-		relvar = makeRangeVarFromNameList(textToQualifiedNameList(name));
-		index = relation_openrv(relvar, AccessExclusiveLock);
+	if (!IS_INDEX(index) || !IS_SPGIST(index))
+		elog(ERROR, "relation \"%s\" is not an SPGiST index",
+			 RelationGetRelationName(index));
 
-		if (!IS_INDEX(index) || !IS_SPGIST(index))
-			elog(ERROR, "relation \"%s\" is not an SPGiST index",
-				 RelationGetRelationName(index));
+	prst.index = index;
+	initSpGistState(&prst.state, index);
 
-		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+#if PG_VERSION_NUM >= 120000
+	tupdesc = CreateTemplateTupleDesc(3 /* types */ + 1 /* level */ + 1 /* nlabel */ +  2 /* tids */ + 1);
+#else
+	tupdesc = CreateTemplateTupleDesc(3 /* types */ + 1 /* level */ + 1 /* nlabel */ +  2 /* tids */ + 1, false);
+#endif
+	TupleDescInitEntry(tupdesc, 1, "tid", TIDOID, -1, 0);
+	TupleDescInitEntry(tupdesc, 2, "allthesame", BOOLOID, -1, 0);
+	TupleDescInitEntry(tupdesc, 3, "node", INT4OID, -1, 0);
+	TupleDescInitEntry(tupdesc, 4, "level", INT4OID, -1, 0);
+	TupleDescInitEntry(tupdesc, 5, "tid_pointer", TIDOID, -1, 0);
+	TupleDescInitEntry(tupdesc, 6, "prefix",
+			(prst.state.attPrefixType.type == VOIDOID) ? INT4OID : prst.state.attPrefixType.type, -1, 0);
+	TupleDescInitEntry(tupdesc, 7, "label",
+			(prst.state.attLabelType.type == VOIDOID) ? INT4OID : prst.state.attLabelType.type, -1, 0);
+	TupleDescInitEntry(tupdesc, 8, "leaf",
+			(prst.state.attType.type == VOIDOID) ? INT4OID : prst.state.attType.type, -1, 0);
+
+	prst.tupdesc = tupdesc;
+	prst.tupstore = materializeSetup(fcinfo, tupdesc);
+#if PG_VERSION_NUM >= 90600
+	prst.pagecxt = AllocSetContextCreate(CurrentMemoryContext,
+										 "spgist_print page",
+										 ALLOCSET_DEFAULT_SIZES);
+#else
+	prst.pagecxt = AllocSetContextCreate(CurrentMemoryContext,
+										 "spgist_print page",
+										 ALLOCSET_DEFAULT_MINSIZE,
+										 ALLOCSET_DEFAULT_INITSIZE,
+										 ALLOCSET_DEFAULT_MAXSIZE);
+#endif
 
-		prst = palloc(sizeof(*prst));
+	prst.maxstack = 64;
+	prst.nstack = 0;
+	prst.nrows = 0;
+	prst.stack = palloc(sizeof(SPGistPrintStackElem) * prst.maxstack);
 
-		prst->index = index;
-		initSpGistState(&prst->state, index);
+	ItemPointerSet(&ipd, SPGIST_ROOT_BLKNO, FirstOffsetNumber);
+	pushSPGistPrint(&prst, &ipd, 1);
 
-#if PG_VERSION_NUM >= 120000
-		tupdesc = CreateTemplateTupleDesc(3 /* types */ + 1 /* level */ + 1 /* nlabel */ +  2 /* tids */ + 1);
-#else
-		tupdesc = CreateTemplateTupleDesc(3 /* types */ + 1 /* level */ + 1 /* nlabel */ +  2 /* tids */ + 1, false);
-#endif
-		TupleDescInitEntry(tupdesc, 1, "tid", TIDOID, -1, 0);
-		TupleDescInitEntry(tupdesc, 2, "allthesame", BOOLOID, -1, 0);
-		TupleDescInitEntry(tupdesc, 3, "node", INT4OID, -1, 0);
-		TupleDescInitEntry(tupdesc, 4, "level", INT4OID, -1, 0);
-		TupleDescInitEntry(tupdesc, 5, "tid_pointer", TIDOID, -1, 0);
-		TupleDescInitEntry(tupdesc, 6, "prefix",
-				(prst->state.attPrefixType.type == VOIDOID) ? INT4OID : prst->state.attPrefixType.type, -1, 0);
-		TupleDescInitEntry(tupdesc, 7, "label",
-				(prst->state.attLabelType.type == VOIDOID) ? INT4OID : prst->state.attLabelType.type, -1, 0);
-		TupleDescInitEntry(tupdesc, 8, "leaf",
-				(prst->state.attType.type == VOIDOID) ? INT4OID : prst->state.attType.type, -1, 0);
+	gevel_progress_start(GEVEL_PROGRESS_SPGIST_PRINT, index);
+	spgist_print_tree(&prst);
+	gevel_progress_end();
 
-#if PG_VERSION_NUM >= 120000
-		funcctx->attinmeta = TupleDescGetAttInMetadata(tupdesc);
-#else
-		funcctx->slot = TupleDescGetSlot(tupdesc);
+	pfree(prst.stack);
+	MemoryContextDelete(prst.pagecxt);
+	index_close(index, AccessExclusiveLock);
+
+	PG_FREE_IF_COPY(name,0);
+
+	return (Datum) 0;
 #endif
+}
 
-		funcctx->user_fctx = (void*)prst;
+#if PG_VERSION_NUM >= 140000
+#define SpGistLeafNextOffset(lt)	SGLT_GET_NEXTOFFSET(lt)
+#elif PG_VERSION_NUM >= 90200
+#define SpGistLeafNextOffset(lt)	((lt)->nextOffset)
+#endif
 
-		MemoryContextSwitchTo(oldcontext);
+#define SPG_FANOUT_BUCKETS	9
+#define SPG_DEEPEST			5
+
+typedef struct SPGistLevelStat {
+	int64		nInner;
+	int64		nNodes;
+	int64		nEmptyNodes;
+	int64		nAllTheSame;
+	int64		nPrefix;
+	int64		prefixSize;
+	int64		fanout[SPG_FANOUT_BUCKETS];
+	int			minFanout;
+	int			maxFanout;
+	int64		nLeaf;
+	int64		nLeafChains;
+} SPGistLevelStat;
+
+typedef struct SPGistLevelElem {
+	ItemPointerData		iptr;
+	int					level;
+} SPGistLevelElem;
+
+typedef struct SPGistLevelState {
+	SPGistLevelStat		*levels;
+	int					nlevels;
+	SPGistLevelElem		*stack;
+	int					nstack;
+	int					maxstack;
+	ItemPointerData		*path;
+	int					maxdepth;
+	char				*deepest[SPG_DEEPEST];
+	int					ndeepest;
+} SPGistLevelState;
+
+static SPGistLevelStat *
+spgLevel(SPGistLevelState *st, int level) {
+	if (level > st->nlevels) {
+		int		n = Max(level, 2 * st->nlevels);
+
+		st->levels = repalloc(st->levels, sizeof(SPGistLevelStat) * n);
+		st->path = repalloc(st->path, sizeof(ItemPointerData) * n);
+		memset(st->levels + st->nlevels, 0, sizeof(SPGistLevelStat) * (n - st->nlevels));
+		st->nlevels = n;
+	}
 
-		ItemPointerSet(&ipd, SPGIST_ROOT_BLKNO, FirstOffsetNumber);
-		prst->stack = NIL;
-		pushSPGistPrint(funcctx, prst, &ipd, 1);
+	return &st->levels[level - 1];
+}
 
-		PG_FREE_IF_COPY(name,0);
+static void
+spgLevelPush(SPGistLevelState *st, ItemPointer iptr, int level) {
+	if (st->nstack >= st->maxstack) {
+		st->maxstack *= 2;
+		st->stack = repalloc(st->stack, sizeof(SPGistLevelElem) * st->maxstack);
 	}
+	st->stack[st->nstack].iptr = *iptr;
+	st->stack[st->nstack].level = level;
+	st->nstack++;
+}
 
-	funcctx = SRF_PERCALL_SETUP();
-	prst = (SPGistPrint*)(funcctx->user_fctx);
+static void
+spgLevelLeafChain(SPGistLevelState *st, ItemPointer head, int level, int64 nleaf) {
+	SPGistLevelStat	*ls = spgLevel(st, level);
+	StringInfoData	buf;
+	int				i;
 
-next:
-	for(;;) {
-		if ( prst->stack == NIL ) {
-			close_spgist_print(prst);
-			SRF_RETURN_DONE(funcctx);
-		}
+	ls->nLeaf += nleaf;
+	ls->nLeafChains++;
 
-		CHECK_FOR_INTERRUPTS();
+	if (level < st->maxdepth || (level == st->maxdepth && st->ndeepest >= SPG_DEEPEST))
+		return;
 
-		s = (SPGistPrintStackElem*)linitial(prst->stack);
-		prst->stack = list_delete_first(prst->stack);
+	if (level > st->maxdepth) {
+		for (i = 0; i < st->ndeepest; i++)
+			pfree(st->deepest[i]);
+		st->ndeepest = 0;
+		st->maxdepth = level;
+	}
 
-		if (ItemPointerIsValid(&s->iptr))
-			break;
-		free(s);
+	initStringInfo(&buf);
+	for (i = 0; i < level - 1; i++)
+		appendStringInfo(&buf, "(%u,%u) -> ",
+						 ItemPointerGetBlockNumber(&st->path[i]),
+						 ItemPointerGetOffsetNumber(&st->path[i]));
+	appendStringInfo(&buf, "(%u,%u)",
+					 ItemPointerGetBlockNumber(head),
+					 ItemPointerGetOffsetNumber(head));
+	st->deepest[st->ndeepest++] = buf.data;
+}
+
+static int
+spgFanoutBucket(int n) {
+	int		bucket = 0;
+
+	n--;
+	while (n > 0 && bucket < SPG_FANOUT_BUCKETS - 1) {
+		bucket++;
+		n >>= 1;
 	}
+	return bucket;
+}
 
-	do {
-		Buffer				buffer;
-		Page				page;
-		SpGistDeadTuple		dtuple;
-		ItemPointer			tid;
+#if PG_VERSION_NUM >= 90200
+/*
+ * Depth-first walk of the tree hanging from rootBlk with an explicit
+ * stack; one buffer is locked at a time.
+ */
+static void
+spgLevelWalk(Relation index, SPGistLevelState *st, BlockNumber rootBlk) {
+	Buffer			buffer = InvalidBuffer;
+	ItemPointerData	root;
+	int				i;
 
-		buffer = ReadBuffer(prst->index, ItemPointerGetBlockNumber(&s->iptr));
-		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+	memset(st, 0, sizeof(*st));
+	st->nlevels = 16;
+	st->levels = palloc0(sizeof(SPGistLevelStat) * st->nlevels);
+	st->path = palloc(sizeof(ItemPointerData) * st->nlevels);
+	st->maxstack = 1024;
+	st->stack = palloc(sizeof(SPGistLevelElem) * st->maxstack);
 
-		page = BufferGetPage(buffer);
-		if (ItemPointerGetOffsetNumber(&s->iptr) > PageGetMaxOffsetNumber(page)) {
-			UnlockReleaseBuffer(buffer);
-			pfree(s);
-			goto next;
-		}
+	ItemPointerSet(&root, rootBlk, FirstOffsetNumber);
+	spgLevelPush(st, &root, 1);
 
-		dtuple = (SpGistDeadTuple)PageGetItem(page, PageGetItemId(page, ItemPointerGetOffsetNumber(&s->iptr)));
+	while (st->nstack > 0)
+	{
+		SPGistLevelElem	e = st->stack[--st->nstack];
+		BlockNumber		blkno = ItemPointerGetBlockNumber(&e.iptr);
+		OffsetNumber	offset = ItemPointerGetOffsetNumber(&e.iptr);
+		Page			page;
+		SpGistDeadTuple	dt;
 
-		if (dtuple->tupstate != SPGIST_LIVE)  {
-			UnlockReleaseBuffer(buffer);
-			pfree(s);
-			goto next;
+		CHECK_FOR_INTERRUPTS();
+
+		if (!BufferIsValid(buffer) || BufferGetBlockNumber(buffer) != blkno)
+		{
+			if (BufferIsValid(buffer))
+				UnlockReleaseBuffer(buffer);
+			buffer = ReadBuffer(index, blkno);
+			LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			gevel_progress_update(1, e.level, 0);
 		}
 
-		if (SpGistPageIsLeaf(page)) {
-				SpGistLeafTuple	leafTuple = (SpGistLeafTuple)dtuple;
-
-				tid = palloc(sizeof(ItemPointerData));
-				*tid = s->iptr;
-				prst->dvalues[0] = PointerGetDatum(tid);
-				prst->nulls[0] = ISNOTNULL;
-				prst->nulls[1] = ISNULL;
-				prst->nulls[2] = ISNULL;
-				prst->dvalues[3]  = s->level;
-				prst->nulls[3] = ISNOTNULL;
-				prst->nulls[4] = ISNULL;
-				prst->nulls[5] = ISNULL;
-				prst->nulls[6] = ISNULL;
-				prst->dvalues[7]  = datumCopy(SGLTDATUM(leafTuple, &prst->state),
-											prst->state.attType.attbyval, prst->state.attType.attlen);
-				prst->nulls[7] = ISNOTNULL;
-		} else {
-			SpGistInnerTuple	innerTuple = (SpGistInnerTuple)dtuple;
-			int					i;
-			SpGistNodeTuple		node;
+		page = BufferGetPage(buffer);
 
-			SGITITERATE(innerTuple, i, node) {
-				if (ItemPointerIsValid(&node->t_tid)) {
-					if (i >= s->nlabel)
-						break;
-				}
-			}
+		if (SpGistPageIsLeaf(page) && blkno == rootBlk)
+		{
+			/* the whole tree is a single leaf page, its tuples are not chained */
+			OffsetNumber	max = PageGetMaxOffsetNumber(page);
+			int64			n = 0;
 
-			if (i >= innerTuple->nNodes) {
-				UnlockReleaseBuffer(buffer);
-				pfree(s);
-				goto next;
+			for (offset = FirstOffsetNumber; offset <= max; offset++)
+			{
+				dt = (SpGistDeadTuple) PageGetItem(page, PageGetItemId(page, offset));
+				if (dt->tupstate == SPGIST_LIVE)
+					n++;
 			}
+			if (n > 0)
+				spgLevelLeafChain(st, &e.iptr, 1, n);
+			continue;
+		}
 
-			tid = palloc(sizeof(ItemPointerData));
-			*tid = s->iptr;
-			prst->dvalues[0] = PointerGetDatum(tid);
-			prst->nulls[0] = ISNOTNULL;
-			prst->dvalues[1] = innerTuple->allTheSame;
-			prst->nulls[1] = ISNOTNULL;
-			prst->dvalues[2] = Int32GetDatum(s->nlabel);
-			prst->nulls[2] = ISNOTNULL;
-			prst->dvalues[3]  = s->level;
-			prst->nulls[3] = ISNOTNULL;
-			tid = palloc(sizeof(ItemPointerData));
-			*tid = node->t_tid;
-			prst->dvalues[4] = PointerGetDatum(tid);
-			prst->nulls[5] = ISNOTNULL;
-			if (innerTuple->prefixSize > 0) {
-				prst->dvalues[5]  = datumCopy(SGITDATUM(innerTuple, &prst->state),
-											prst->state.attPrefixType.attbyval, prst->state.attPrefixType.attlen);
-				prst->nulls[5] = ISNOTNULL;
-			} else
-				prst->nulls[5] = ISNULL;
-			if (!IndexTupleHasNulls(node)) {
-				prst->dvalues[6]  = datumCopy(SGNTDATUM(node, &prst->state),
-											prst->state.attLabelType.attbyval, prst->state.attLabelType.attlen);
-				prst->nulls[6] = ISNOTNULL;
-			} else
-				prst->nulls[6] = ISNULL;
-			prst->nulls[7] = ISNULL;
+		if (offset > PageGetMaxOffsetNumber(page))
+			continue;
+
+		spgLevel(st, e.level);
+		st->path[e.level - 1] = e.iptr;
+
+		dt = (SpGistDeadTuple) PageGetItem(page, PageGetItemId(page, offset));
 
-			pushSPGistPrint(funcctx, prst, &node->t_tid, s->level + 1);
-			s->nlabel = i + 1;
-			oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
-			prst->stack = lcons(s, prst->stack);
-			MemoryContextSwitchTo(oldcontext);
-			s = NULL;
+		if (dt->tupstate == SPGIST_REDIRECT)
+		{
+			spgLevelPush(st, &dt->pointer, e.level);
+			continue;
 		}
 
-		UnlockReleaseBuffer(buffer);
-		if (s) pfree(s);
-	} while(0);
+		if (dt->tupstate != SPGIST_LIVE)
+			continue;
 
-	htuple = heap_formtuple(funcctx->attinmeta->tupdesc, prst->dvalues, prst->nulls);
-#if PG_VERSION_NUM >= 120000
-	result = HeapTupleGetDatum(htuple);
-#else
-	result = TupleGetDatum(funcctx->slot, htuple);
-#endif
+		if (SpGistPageIsLeaf(page))
+		{
+			int64		n = 0;
 
-	SRF_RETURN_NEXT(funcctx, result);
-#endif
-}
+			while (offset != InvalidOffsetNumber && offset <= PageGetMaxOffsetNumber(page))
+			{
+				SpGistLeafTuple	lt;
+
+				lt = (SpGistLeafTuple) PageGetItem(page, PageGetItemId(page, offset));
+				if (lt->tupstate == SPGIST_LIVE)
+					n++;
+				else if (lt->tupstate != SPGIST_DEAD)
+					break;
+				offset = SpGistLeafNextOffset(lt);
+			}
 
-PG_FUNCTION_INFO_V1(gin_statpage);
-Datum gin_statpage(PG_FUNCTION_ARGS);
+			spgLevelLeafChain(st, &e.iptr, e.level, n);
+		}
+		else
+		{
+			SpGistInnerTuple	it = (SpGistInnerTuple) dt;
+			SPGistLevelStat		*ls = spgLevel(st, e.level);
+			SpGistNodeTuple		node;
+			ItemPointerData		*children;
+			int					nchildren = 0;
+
+			ls->nInner++;
+			ls->nNodes += it->nNodes;
+			if (it->allTheSame)
+				ls->nAllTheSame++;
+			if (it->prefixSize > 0)
+			{
+				ls->nPrefix++;
+				ls->prefixSize += it->prefixSize;
+			}
+			ls->fanout[spgFanoutBucket(it->nNodes)]++;
+			if (ls->nInner == 1 || it->nNodes < ls->minFanout)
+				ls->minFanout = it->nNodes;
+			if (it->nNodes > ls->maxFanout)
+				ls->maxFanout = it->nNodes;
+
+			children = palloc(sizeof(ItemPointerData) * it->nNodes);
+			SGITITERATE(it, i, node)
+			{
+				if (ItemPointerIsValid(&node->t_tid))
+					children[nchildren++] = node->t_tid;
+				else
+					ls->nEmptyNodes++;
+			}
+
+			/* push in reverse order to visit the first node first */
+			while (nchildren > 0)
+				spgLevelPush(st, &children[--nchildren], e.level + 1);
+			pfree(children);
+		}
+	}
+
+	if (BufferIsValid(buffer))
+		UnlockReleaseBuffer(buffer);
+}
+
+/* number of non-empty levels, leaf tuples and the sum of their depths */
+static int
+spgLevelTotals(SPGistLevelState *st, int64 *nLeaf, int64 *sumDepth) {
+	int		nlevels = 0;
+	int		i;
+
+	*nLeaf = *sumDepth = 0;
+	for (i = 0; i < st->nlevels; i++)
+	{
+		if (st->levels[i].nInner > 0 || st->levels[i].nLeaf > 0)
+			nlevels = i + 1;
+		*nLeaf += st->levels[i].nLeaf;
+		*sumDepth += st->levels[i].nLeaf * (i + 1);
+	}
+
+	return nlevels;
+}
+#endif
+
+PG_FUNCTION_INFO_V1(spgist_level_stat);
+Datum spgist_level_stat(PG_FUNCTION_ARGS);
 Datum
-gin_statpage(PG_FUNCTION_ARGS)
+spgist_level_stat(PG_FUNCTION_ARGS)
 {
-#if PG_VERSION_NUM < 90400
-	elog(NOTICE, "Function is not working under PgSQL < 9.4");
+#if PG_VERSION_NUM < 90200
+	elog(NOTICE, "Function is not working under PgSQL < 9.2");
 
 	PG_RETURN_TEXT_P(CStringGetTextDatum("???"));
 #else
-	text	   *name = PG_GETARG_TEXT_P(0);
-	RangeVar   *relvar;
-	Relation	index;
-	BlockNumber blkno;
-	char		res[1024];
-	uint32		totalPages,
-#if PG_VERSION_NUM >= 100000
-				deletedPages = 0,
-				emptyDataPages = 0,
-#endif
-				entryPages = 0,
-				dataPages = 0,
-				dataInnerPages = 0,
-				dataLeafPages = 0,
-				entryInnerPages = 0,
-				entryLeafPages = 0
-				;
-	uint64		dataInnerFreeSpace = 0,
-				dataLeafFreeSpace = 0,
-				dataInnerTuplesCount = 0,
-				dataLeafIptrsCount = 0,
-				entryInnerFreeSpace = 0,
-				entryLeafFreeSpace = 0,
-				entryInnerTuplesCount = 0,
-				entryLeafTuplesCount = 0,
-				entryPostingSize = 0,
-				entryPostingCount = 0,
-				entryAttrSize = 0
-				;
+	text			*name = PG_GETARG_TEXT_P(0);
+	RangeVar		*relvar;
+	Relation		index;
+	SPGistLevelState st;
+#if PG_VERSION_NUM >= 90300
+	SPGistLevelState nullst;
+#endif
+	StringInfoData	out;
+	int64			nLeaf,
+					sumDepth,
+					acc;
+	int				nlevels;
+	int				i,
+					j;
+	static const double	percentiles[] = {0.5, 0.9, 0.99};
 
 	relvar = makeRangeVarFromNameList(textToQualifiedNameList(name));
-	index = relation_openrv(relvar, AccessExclusiveLock);
+	index = gevel_relation_openrv(relvar, AccessExclusiveLock);
 
-	if (index->rd_rel->relkind != RELKIND_INDEX ||
-			index->rd_rel->relam != GIN_AM_OID)
+	if (!IS_INDEX(index) || !IS_SPGIST(index))
 		elog(ERROR, "relation \"%s\" is not an SPGiST index",
 			 RelationGetRelationName(index));
 
-	totalPages = RelationGetNumberOfBlocks(index);
+	gevel_progress_start(GEVEL_PROGRESS_SPGIST_LEVEL_STAT, index);
+	spgLevelWalk(index, &st, SPGIST_ROOT_BLKNO);
+#if PG_VERSION_NUM >= 90300
+	/* NULL keys live in a tree of their own */
+	spgLevelWalk(index, &nullst, SPGIST_NULL_BLKNO);
+#endif
+	gevel_progress_end();
+	index_close(index, AccessExclusiveLock);
 
-	for (blkno = GIN_ROOT_BLKNO; blkno < totalPages; blkno++)
-	{
-		Buffer		buffer;
-		Page		page;
-		PageHeader	header;
+	nlevels = spgLevelTotals(&st, &nLeaf, &sumDepth);
 
-		buffer = ReadBuffer(index, blkno);
-		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+	initStringInfo(&out);
+	appendStringInfo(&out, "levels:            %d\n", nlevels);
+	appendStringInfo(&out, "leafTuples:        " INT64_FORMAT "\n", nLeaf);
+	appendStringInfo(&out, "avgLeafDepth:      %.2f\n",
+					 (nLeaf > 0) ? ((double) sumDepth) / nLeaf : 0.0);
 
-		page = BufferGetPage(buffer);
-		header = (PageHeader)page;
+	for (j = 0; j < lengthof(percentiles); j++)
+	{
+		int64	target = (int64) ceil(percentiles[j] * nLeaf);
 
-#if PG_VERSION_NUM >= 100000
-		if (GinPageIsDeleted(page))
+		acc = 0;
+		for (i = 0; i < nlevels; i++)
 		{
-			deletedPages++;
+			acc += st.levels[i].nLeaf;
+			if (acc >= target)
+				break;
 		}
-		else
+		appendStringInfo(&out, "p%-2d leafDepth:     %d\n",
+						 (int) (percentiles[j] * 100), (nLeaf > 0) ? i + 1 : 0);
+	}
+	appendStringInfo(&out, "maxLeafDepth:      %d\n", st.maxdepth);
+#if PG_VERSION_NUM >= 90300
+	{
+		int		nullLevels = spgLevelTotals(&nullst, &nLeaf, &sumDepth);
+
+		appendStringInfo(&out, "nullLeafTuples:    " INT64_FORMAT ", levels %d, maxLeafDepth %d\n",
+						 nLeaf, nullLevels, nullst.maxdepth);
+	}
 #endif
-		if (GinPageIsData(page))
+
+	for (i = 0; i < nlevels; i++)
+	{
+		SPGistLevelStat	*ls = &st.levels[i];
+
+		appendStringInfo(&out, "level %d:\n", i + 1);
+		appendStringInfo(&out, "    innerTuples:     " INT64_FORMAT "\n", ls->nInner);
+		if (ls->nInner > 0)
 		{
-			dataPages++;
-			if (GinPageIsLeaf(page))
+			appendStringInfo(&out, "    fanout:          min %d avg %.2f max %d\n",
+							 ls->minFanout, ((double) ls->nNodes) / ls->nInner,
+							 ls->maxFanout);
+			appendStringInfoString(&out, "    fanoutHistogram:");
+			for (j = 0; j < SPG_FANOUT_BUCKETS; j++)
 			{
-				ItemPointerData minItem, *ptr;
-				int nlist;
+				if (ls->fanout[j] == 0)
+					continue;
+				if (j == 0)
+					appendStringInfoString(&out, " 1:");
+				else if (j == SPG_FANOUT_BUCKETS - 1)
+					appendStringInfo(&out, " %d+:", (1 << (j - 1)) + 1);
+				else if (j == 1)
+					appendStringInfoString(&out, " 2:");
+				else
+					appendStringInfo(&out, " %d-%d:", (1 << (j - 1)) + 1, 1 << j);
+				appendStringInfo(&out, INT64_FORMAT, ls->fanout[j]);
+			}
+			appendStringInfoChar(&out, '\n');
+			appendStringInfo(&out, "    emptyNodes:      " INT64_FORMAT "\n", ls->nEmptyNodes);
+			appendStringInfo(&out, "    allTheSame:      " INT64_FORMAT " (%.2f%%)\n",
+							 ls->nAllTheSame, 100.0 * ls->nAllTheSame / ls->nInner);
+			appendStringInfo(&out, "    withPrefix:      " INT64_FORMAT " (%.2f%%), avg %.1f bytes\n",
+							 ls->nPrefix, 100.0 * ls->nPrefix / ls->nInner,
+							 (ls->nPrefix > 0) ? ((double) ls->prefixSize) / ls->nPrefix : 0.0);
+		}
+		appendStringInfo(&out, "    leafTuples:      " INT64_FORMAT " in " INT64_FORMAT " chains\n",
+						 ls->nLeaf, ls->nLeafChains);
+	}
 
+	appendStringInfoString(&out, "deepest paths:");
+	for (i = 0; i < st.ndeepest; i++)
+		appendStringInfo(&out, "\n    %s", st.deepest[i]);
 
-				dataLeafPages++;
-				dataLeafFreeSpace += header->pd_upper - header->pd_lower;
-				ItemPointerSetMin(&minItem);
+	PG_RETURN_TEXT_P(cstring_to_text(out.data));
+#endif
+}
 
-				ptr = GinDataLeafPageGetItems(page, &nlist, minItem);
+#if PG_VERSION_NUM >= 90400
+static Relation
+gin_statpage_open(text *name)
+{
+	RangeVar   *relvar;
+	Relation	index;
 
-				if (ptr)
-				{
-					pfree(ptr);
-					dataLeafIptrsCount += nlist;
-				}
-				else
-					emptyDataPages++;
-			}
-			else
-			{
-				dataInnerPages++;
-				dataInnerFreeSpace += header->pd_upper - header->pd_lower;
-				dataInnerTuplesCount += GinPageGetOpaque(page)->maxoff;
-			}
-		}
-		else
-		{
-			IndexTuple itup;
-			OffsetNumber i, maxoff;
+	relvar = makeRangeVarFromNameList(textToQualifiedNameList(name));
+	index = gevel_relation_openrv(relvar, AccessExclusiveLock);
 
-			maxoff = PageGetMaxOffsetNumber(page);
+	if (index->rd_rel->relkind != RELKIND_INDEX ||
+			index->rd_rel->relam != GIN_AM_OID)
+		elog(ERROR, "relation \"%s\" is not an SPGiST index",
+			 RelationGetRelationName(index));
 
-			entryPages++;
-			if (GinPageIsLeaf(page))
-			{
-				entryLeafPages++;
-				entryLeafFreeSpace += header->pd_upper - header->pd_lower;
-				entryLeafTuplesCount += maxoff;
-			}
-			else
-			{
-				entryInnerPages++;
-				entryInnerFreeSpace += header->pd_upper - header->pd_lower;
-				entryInnerTuplesCount += maxoff;
-			}
+	return index;
+}
 
-			for (i = 1; i <= maxoff; i++)
-			{
-				itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+static text *
+gin_statpage_text(GinStatPage *gs)
+{
+	char		res[1024];
 
-				if (GinPageIsLeaf(page))
-				{
-					GinPostingList *list = (GinPostingList *)GinGetPosting(itup);
-					entryPostingCount += GinGetNPosting(itup);
-					entryPostingSize += SizeOfGinPostingList(list);
-					entryAttrSize += GinGetPostingOffset(itup) - IndexInfoFindDataOffset((itup)->t_info);
-				}
-				else
-				{
-					entryAttrSize += IndexTupleSize(itup) - IndexInfoFindDataOffset((itup)->t_info);
-				}
-			}
-		}
+	gin_statpage_format(gs, res, sizeof(res));
+
+	return cstring_to_text(res);
+}
+#endif
+
+PG_FUNCTION_INFO_V1(gin_statpage);
+Datum gin_statpage(PG_FUNCTION_ARGS);
+Datum
+gin_statpage(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM < 90400
+	elog(NOTICE, "Function is not working under PgSQL < 9.4");
+
+	PG_RETURN_TEXT_P(CStringGetTextDatum("???"));
+#else
+	text	   *name = PG_GETARG_TEXT_P(0);
+	Relation	index;
+	BlockNumber blkno,
+				nblocks;
+	GinStatPage	gs;
+
+	index = gin_statpage_open(name);
+	memset(&gs, 0, sizeof(GinStatPage));
+
+	nblocks = RelationGetNumberOfBlocks(index);
+	gevel_progress_start(GEVEL_PROGRESS_GIN_STATPAGE, index);
+
+	/* the metapage is not counted */
+	for (blkno = GIN_ROOT_BLKNO; blkno < nblocks; blkno++)
+	{
+		Buffer		buffer;
+
+		buffer = ReadBuffer(index, blkno);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+
+		gevel_progress_update(1, -1, gin_statpage_page(&gs, BufferGetPage(buffer)));
 
 		UnlockReleaseBuffer(buffer);
 	}
 
+	gevel_progress_end();
 	index_close(index, AccessExclusiveLock);
-	totalPages--;
 
-	snprintf(res, sizeof(res),
-			 "totalPages:			%u\n"
-#if PG_VERSION_NUM >= 100000
-			 "deletedPages:		  %u\n"
-			 "emptyDataPages:		%u\n"
-#endif
-			 "dataPages:			 %u\n"
-			 "dataInnerPages:		%u\n"
-			 "dataLeafPages:		 %u\n"
-			 "dataInnerFreeSpace:	" INT64_FORMAT "\n"
-			 "dataLeafFreeSpace:	 " INT64_FORMAT "\n"
-			 "dataInnerTuplesCount:  " INT64_FORMAT "\n"
-			 "dataLeafIptrsCount:	" INT64_FORMAT "\n"
-			 "entryPages:			%u\n"
-			 "entryInnerPages:	   %u\n"
-			 "entryLeafPages:		%u\n"
-			 "entryInnerFreeSpace:   " INT64_FORMAT "\n"
-			 "entryLeafFreeSpace:	" INT64_FORMAT "\n"
-			 "entryInnerTuplesCount: " INT64_FORMAT "\n"
-			 "entryLeafTuplesCount:  " INT64_FORMAT "\n"
-			 "entryPostingSize:	  " INT64_FORMAT "\n"
-			 "entryPostingCount:	 " INT64_FORMAT "\n"
-			 "entryAttrSize:		 " INT64_FORMAT "\n"
-			 ,
-			 totalPages,
-#if PG_VERSION_NUM >= 100000
-			 deletedPages,
-			 emptyDataPages,
-#endif
-			 dataPages,
-			 dataInnerPages,
-			 dataLeafPages,
-			 dataInnerFreeSpace,
-			 dataLeafFreeSpace,
-			 dataInnerTuplesCount,
-			 dataLeafIptrsCount,
-			 entryPages,
-			 entryInnerPages,
-			 entryLeafPages,
-			 entryInnerFreeSpace,
-			 entryLeafFreeSpace,
-			 entryInnerTuplesCount,
-			 entryLeafTuplesCount,
-			 entryPostingSize,
-			 entryPostingCount,
-			 entryAttrSize
-			 );
-
-	PG_RETURN_TEXT_P(CStringGetTextDatum(res));
+	PG_RETURN_TEXT_P(gin_statpage_text(&gs));
 #endif
 }
 
 #if PG_VERSION_NUM >= 120000
-typedef enum {stat, print} TreeCond;
+#if PG_VERSION_NUM >= 140000
+#define BtPageGetLevel(opaque)	((opaque)->btpo_level)
+#else
+#define BtPageGetLevel(opaque)	((opaque)->btpo.level)
+#endif
+
+typedef enum {stat, print, pivot} TreeCond;
+
+/* pivot tuples of one internal level, see btree_pivot_stat() */
+typedef struct BtreePivotLevel
+{
+	int64		pages;
+	int64		downlinks;
+	int64		truncated;		/* pivots with key attributes truncated */
+	int64		keyatts;		/* key attributes kept, summed */
+	int64		heaptid;		/* pivots keeping the heap TID tiebreaker */
+	int			*sizes;			/* pivot sizes, minus infinity excluded */
+	int			nsizes;
+	int			maxsizes;
+} BtreePivotLevel;
+
 typedef struct
 {
 	IdxInfo idxInfo;
 	IdxStat idxStat;
+	BtreePivotLevel *pivots;	/* indexed by page level, pivot only */
+	int			npivotlevels;
 }BtreeIdxInfo;
 
+/* account a btree page found at level to btree_stat */
+static void
+btree_stat_add(IdxStat *info, Page page, int level)
+{
+	BTPageOpaque	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	OffsetNumber	maxoff = PageGetMaxOffsetNumber(page);
+
+	info->numpages++;
+	info->tuplesize+=BTMaxItemSize(page)-PageGetFreeSpace(page);
+	info->totalsize+=BLCKSZ;
+	info->numtuple+=maxoff;
+
+	if (level > info->level)
+		info->level = level;
+
+	if (P_ISLEAF(opaque))
+	{
+		info->numleafpages++;
+		info->leaftuplesize+=BTMaxItemSize(page)-PageGetFreeSpace(page);
+		info->numleaftuple+=maxoff;
+	}
+}
+
+/* account the pivot tuples of an internal btree page */
+static void
+btree_pivot_add(Relation rel, Page page, BtreeIdxInfo *btreeIdxInfo)
+{
+	BTPageOpaque	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	OffsetNumber	i,
+					maxoff = PageGetMaxOffsetNumber(page);
+	BtreePivotLevel *pl;
+
+	if (P_ISLEAF(opaque) || BtPageGetLevel(opaque) >= btreeIdxInfo->npivotlevels)
+		return;
+
+	pl = &btreeIdxInfo->pivots[BtPageGetLevel(opaque)];
+	pl->pages++;
+
+	for (i = P_FIRSTDATAKEY(opaque); i <= maxoff; i = OffsetNumberNext(i))
+	{
+		IndexTuple	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+		int			natts;
+
+		pl->downlinks++;
+
+		/* the first downlink of a page is minus infinity, it has no key */
+		if (i == P_FIRSTDATAKEY(opaque))
+			continue;
+
+		natts = BTreeTupleGetNAtts(itup, rel);
+		pl->keyatts += natts;
+		if (natts < IndexRelationGetNumberOfKeyAttributes(rel))
+			pl->truncated++;
+		if (BTreeTupleGetHeapTID(itup) != NULL)
+			pl->heaptid++;
+
+		if (pl->nsizes >= pl->maxsizes)
+		{
+			pl->maxsizes = Max(pl->maxsizes * 2, 256);
+			pl->sizes = pl->sizes ?
+				repalloc(pl->sizes, sizeof(int) * pl->maxsizes) :
+				palloc(sizeof(int) * pl->maxsizes);
+		}
+		pl->sizes[pl->nsizes++] = IndexTupleSize(itup);
+	}
+}
+
 /*
  * Depth-first search for btree
  * using for statistic data collection
@@ -1605,26 +2475,18 @@ btree_deep_search(Relation rel, int level,
 	page = (Page) BufferGetPage(buffer);
 	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
 	maxoff = PageGetMaxOffsetNumber(page);
+	gevel_progress_update(1, level, maxoff);
 
 	switch (cond)
 	{
 		case stat:
 		{
-			btreeIdxInfo->idxStat.numpages++;
-			btreeIdxInfo->idxStat.tuplesize+=BTMaxItemSize(page)-PageGetFreeSpace(page);
-			btreeIdxInfo->idxStat.totalsize+=BLCKSZ;
-			btreeIdxInfo->idxStat.numtuple+=maxoff;
-
-			if (level > btreeIdxInfo->idxStat.level)
-				btreeIdxInfo->idxStat.level = level;
-
-			if (P_ISLEAF(opaque))
-			{
-				btreeIdxInfo->idxStat.numleafpages++;
-				btreeIdxInfo->idxStat.leaftuplesize+=BTMaxItemSize(page)-
-						PageGetFreeSpace(page);
-				btreeIdxInfo->idxStat.numleaftuple+=maxoff;
-			}
+			btree_stat_add(&btreeIdxInfo->idxStat, page, level);
+			break;
+		}
+		case pivot:
+		{
+			btree_pivot_add(rel, page, btreeIdxInfo);
 			break;
 		}
 		case print:
@@ -1639,7 +2501,7 @@ btree_deep_search(Relation rel, int level,
 					btreeIdxInfo->idxInfo.ptr = ((char*)btreeIdxInfo->idxInfo.txt)+dist;
 			}
 
-			sprintf(btreeIdxInfo->idxInfo.ptr, "lvl: %d, blk: %d, numTuples: %d\n",
+			sprintf(btreeIdxInfo->idxInfo.ptr, BTREE_TREE_LINE,
 							level,
 							blk,
 							(int)maxoff);
@@ -1672,12 +2534,78 @@ btree_deep_search(Relation rel, int level,
 	UnlockReleaseBuffer(buffer);
 }
 
+/*
+ * Level by level alternative of btree_deep_search for statistics. Every
+ * level is read once from its leftmost page along the right-links, so
+ * only one page is locked at a time and each level, the leaves included,
+ * is read in key order. The leftmost page of the next level is the first
+ * downlink of the leftmost page of this one. Half-dead and deleted pages
+ * are still on the chain and are skipped, as the descent never finds them.
+ */
+static void
+btree_level_scan(Relation rel, BlockNumber blk, IdxStat *info)
+{
+	int			level = 0;
+
+	while (blk != P_NONE)
+	{
+		BlockNumber	leftmost = P_NONE;
+
+		while (blk != P_NONE)
+		{
+			Buffer			buffer;
+			Page			page;
+			BTPageOpaque	opaque;
+			OffsetNumber	i,
+							maxoff;
+
+			CHECK_FOR_INTERRUPTS();
+
+			buffer = _bt_getbuf(rel, blk, BT_READ);
+			page = BufferGetPage(buffer);
+			opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+			maxoff = PageGetMaxOffsetNumber(page);
+			gevel_progress_update(1, level, maxoff);
+
+			if (!P_IGNORE(opaque))
+			{
+				btree_stat_add(info, page, level);
+
+				if (!P_ISLEAF(opaque))
+				{
+					for (i = P_FIRSTDATAKEY(opaque); i <= maxoff; i = OffsetNumberNext(i))
+						if (!ItemIdIsValid(PageGetItemId(page, i)))
+							info->numinvalidtuple++;
+
+					if (leftmost == P_NONE && P_FIRSTDATAKEY(opaque) <= maxoff)
+					{
+						IndexTuple	itup = (IndexTuple) PageGetItem(page,
+										PageGetItemId(page, P_FIRSTDATAKEY(opaque)));
+#if PG_VERSION_NUM >= 140000
+						leftmost = BTreeTupleGetDownLink(itup);
+#else
+						leftmost = BTreeInnerTupleGetDownLink(itup);
+#endif
+					}
+				}
+			}
+
+			blk = opaque->btpo_next;
+			UnlockReleaseBuffer(buffer);
+		}
+
+		blk = leftmost;
+		level++;
+	}
+}
+
 /*
  * Print some statistic about btree index
  * This function shows information for live pages only
  * and do not shows information about deleting pages
  *
  * SELECT btree_stat(INDEXNAME);
+ * SELECT btree_stat(INDEXNAME, true); reads the index level by level
  */
 PG_FUNCTION_INFO_V1(btree_stat);
 Datum btree_stat(PG_FUNCTION_ARGS);
@@ -1694,14 +2622,17 @@ btree_stat(PG_FUNCTION_ARGS)
 	Page		metapg;
 	BTMetaPageData *metad;
 	BlockNumber rootBlk;
+	bool		sequential = (PG_NARGS() > 1 && PG_GETARG_BOOL(1));
 
-	text *out=(text*)palloc(1024);
-	char *ptr=((char*)out)+VARHDRSZ;
 	relname_list = textToQualifiedNameList(name);
 	relvar = makeRangeVarFromNameList(relname_list);
-	index = btree_index_open(relvar);
+	if (sequential)
+		index = btree_share_open(relvar);
+	else
+		index = btree_index_open(relvar);
 
 	memset(&btreeIdxInfo.idxStat, 0, sizeof(IdxStat));
+	btreeIdxInfo.idxInfo.maxlevel = -1;
 
 	/* Start dts from root */
 	metabuf = _bt_getbuf(index, BTREE_METAPAGE, BT_READ);
@@ -1710,219 +2641,148 @@ btree_stat(PG_FUNCTION_ARGS)
 	rootBlk = metad->btm_root;
 	UnlockReleaseBuffer(metabuf);
 
-	btree_deep_search(index, 0, rootBlk, &btreeIdxInfo,stat);
-
-	btree_index_close(index);
-
-	sprintf(ptr,
-		"Number of levels:          %d\n"
-		"Number of pages:           %d\n"
-		"Number of leaf pages:      %d\n"
-		"Number of tuples:          %d\n"
-		"Number of invalid tuples:  %d\n"
-		"Number of leaf tuples:     %d\n"
-		"Total size of tuples:      "INT64_FORMAT" bytes\n"
-		"Total size of leaf tuples: "INT64_FORMAT" bytes\n"
-		"Total size of index:       "INT64_FORMAT" bytes\n",
-		btreeIdxInfo.idxStat.level+1,
-		btreeIdxInfo.idxStat.numpages,
-		btreeIdxInfo.idxStat.numleafpages,
-		btreeIdxInfo.idxStat.numtuple,
-		btreeIdxInfo.idxStat.numinvalidtuple,
-		btreeIdxInfo.idxStat.numleaftuple,
-		btreeIdxInfo.idxStat.tuplesize,
-		btreeIdxInfo.idxStat.leaftuplesize,
-		btreeIdxInfo.idxStat.totalsize);
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_STAT, index);
+	if (sequential)
+		btree_level_scan(index, rootBlk, &btreeIdxInfo.idxStat);
+	else
+		btree_deep_search(index, 0, rootBlk, &btreeIdxInfo,stat);
+	gevel_progress_end();
 
-	ptr=strchr(ptr,'\0');
+	if (sequential)
+		btree_share_close(index);
+	else
+		btree_index_close(index);
 
-	SET_VARSIZE(out, ptr-((char*)out));
-	PG_RETURN_POINTER(out);
+	PG_RETURN_POINTER(formatIdxStat(&btreeIdxInfo.idxStat));
 }
 
-typedef struct BtPItem
-{
-	Buffer		   buffer;
-	Page		   page;
-	OffsetNumber   offset;
-	int			   level;
-	struct BtPItem *next;
-} BtPItem;
-
-typedef struct
-{
-	List	 *relname_list;
-	RangeVar *relvar;
-	Relation index;
-	Datum	 *dvalues;
-	bool	 *nulls;
-	BtPItem	 *item;
-} BtTypeStorage;
-
 /*
- * Open page in btree
- * Returns nitem as a pointer to stack for btree levels stored.
- * We process tuples from buffer in the top of nitem.
- * After the complete processing of a top buffer
- * we return to buffer on one level upper and go to next btree leaf.
+ * Show index elements for btree from root to MAXLEVEL
+ * SELECT btree_tree(INDEXNAME[, MAXLEVEL]);
  */
-static BtPItem*
-openBtPPage( FuncCallContext *funcctx, BlockNumber blk )
+PG_FUNCTION_INFO_V1(btree_tree);
+Datum btree_tree(PG_FUNCTION_ARGS);
+Datum
+btree_tree(PG_FUNCTION_ARGS)
 {
-	BtPItem		  *nitem;
-	MemoryContext oldcontext;
-
-	Relation index = ( (BtTypeStorage*)(funcctx->user_fctx) )->index;
-	BTPageOpaque opaque;
-	oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
-	nitem = (BtPItem*)palloc( sizeof(BtPItem) );
-	memset(nitem,0,sizeof(BtPItem));
-
-	nitem->buffer = _bt_getbuf(index, blk, BT_READ);
-	Assert(BufferIsValid(nitem->buffer));
-	nitem->page = (Page) BufferGetPage(nitem->buffer);
-	opaque = (BTPageOpaque)PageGetSpecialPointer(nitem->page);
-	nitem->offset=P_FIRSTDATAKEY(opaque);
-	nitem->next = ( (BtTypeStorage*)(funcctx->user_fctx) )->item;
-	nitem->level = ( nitem->next ) ? nitem->next->level+1 : 1;
-	( (BtTypeStorage*)(funcctx->user_fctx) )->item = nitem;
-
-	MemoryContextSwitchTo(oldcontext);
-
-	return nitem;
-}
+	text			*name=PG_GETARG_TEXT_PP(0);
+	RangeVar		*relvar;
+	Relation		index;
+	List			*relname_list;
+	BtreeIdxInfo btreeIdxInfo;
+	Buffer			metabuf;
+	Page			metapg;
+	BTMetaPageData  *metad;
+	BlockNumber		rootBlk;
 
-static BtPItem*
-closeBtPPage( FuncCallContext *funcctx )
-{
-	BtPItem  *oitem = ( (BtTypeStorage*)(funcctx->user_fctx) )->item;
+	/*
+	 *  If we use MAXLEVEL is not used in SELECT btree_tree(INDEXNAME),
+	 *  info.maxlevel set to -1
+	 *  If MAXLEVEL is used in btree_tree call, set info.maxlevel = MAXLEVEL
+	 */
+	btreeIdxInfo.idxInfo.maxlevel = ( PG_NARGS() > 1 ) ? PG_GETARG_INT32(1) : -1;
+	btreeIdxInfo.idxInfo.len=1024;
+	btreeIdxInfo.idxInfo.txt=(text*)palloc( btreeIdxInfo.idxInfo.len );
+	btreeIdxInfo.idxInfo.ptr=((char*)btreeIdxInfo.idxInfo.txt)+VARHDRSZ;
 
-	( (BtTypeStorage*)(funcctx->user_fctx) )->item = oitem->next;
+	relname_list = textToQualifiedNameList(name);
+	relvar = makeRangeVarFromNameList(relname_list);
+	index = btree_index_open(relvar);
 
-	UnlockReleaseBuffer(oitem->buffer);
-	pfree( oitem );
-	return ( (BtTypeStorage*)(funcctx->user_fctx) )->item;
-}
+	/* Start dts from root block */
+	metabuf = _bt_getbuf(index, BTREE_METAPAGE, BT_READ);
+	metapg = BufferGetPage(metabuf);
+	metad = BTPageGetMeta(metapg);
+	rootBlk = metad->btm_root;
+	UnlockReleaseBuffer(metabuf);
 
-static void
-btree_close_call( FuncCallContext  *funcctx )
-{
-	BtTypeStorage *st = (BtTypeStorage*)(funcctx->user_fctx);
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_TREE, index);
+	btree_deep_search(index, 0, rootBlk, &btreeIdxInfo, print);
+	gevel_progress_end();
 
-	while(st->item && closeBtPPage(funcctx));
+	btree_index_close(index);
 
-	pfree(st->dvalues);
-	pfree(st->nulls);
+	btreeIdxInfo.idxInfo.ptr=strchr(btreeIdxInfo.idxInfo.ptr,'\0');
 
-	btree_index_close(st->index);
+	SET_VARSIZE(btreeIdxInfo.idxInfo.txt,
+			btreeIdxInfo.idxInfo.ptr-((char*)btreeIdxInfo.idxInfo.txt));
+	PG_RETURN_POINTER(btreeIdxInfo.idxInfo.txt);
 }
 
 /*
- * Settings for first call of btree_print
- * Sets the current memory context
+ * btree_print works like gist_print: every page is copied under BT_READ,
+ * released, and all its rows are stored at once.
  */
-static void
-btree_setup_firstcall(FuncCallContext  *funcctx, text *name)
+typedef struct BtreePrint
 {
-	MemoryContext oldcontext;
-	BtTypeStorage *st;
-	TupleDesc	 tupdesc;
-	char		  attname[NAMEDATALEN];
-	int			  i;
-	BlockNumber   blk;
-	Buffer		  buffer;
-
-	oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
-
-	st=(BtTypeStorage*)palloc( sizeof(BtTypeStorage) );
-	memset(st,0,sizeof(BtTypeStorage));
-	st->relname_list = textToQualifiedNameList(name);
-	st->relvar = makeRangeVarFromNameList(st->relname_list);
-	st->index = btree_index_open(st->relvar);
-	st->item = NULL;
-	funcctx->user_fctx = (void*)st;
+	Relation		index;
+	TupleDesc		tupdesc;
+	Tuplestorestate	*tupstore;
+	Datum			*dvalues;
+	bool			*nulls;
+} BtreePrint;
 
-	tupdesc = CreateTemplateTupleDesc(st->index->rd_att->natts+2);
-	TupleDescInitEntry(tupdesc, 1, "level", INT4OID, -1, 0);
-	TupleDescInitEntry(tupdesc, 2, "valid", BOOLOID, -1, 0);
-	for (i = 0; i < st->index->rd_att->natts; i++)
+/* put the btree_print row of ituple, found on a page with opaque */
+static void
+btree_print_row(BtreePrint *prst, BTPageOpaque opaque, IndexTuple ituple, int level)
+{
+	bool		validtid = ItemPointerIsValid(&(ituple->t_tid));
+	int			j;
+
+	prst->dvalues[0] = Int32GetDatum(level);
+	prst->nulls[0] = false;
+	prst->dvalues[1] = BoolGetDatum(!(P_ISLEAF(opaque) && !validtid));
+	prst->nulls[1] = false;
+	for (j = 2; j < prst->tupdesc->natts; j++)
 	{
-		sprintf(attname, "z%d", i+2);
-		TupleDescInitEntry(
-			tupdesc,
-			i+3,
-			attname,
-			TS_GET_TYPEVAL(st, i, atttypid),
-			TS_GET_TYPEVAL(st, i, atttypmod),
-			TS_GET_TYPEVAL(st, i, attndims) );
-		BlessTupleDesc(tupdesc);
+		if (!P_ISLEAF(opaque) && !validtid)
+		{
+			prst->dvalues[j] = (Datum) 0;
+			prst->nulls[j] = true;
+		}
+		else
+			prst->dvalues[j] = index_getattr(ituple, j-1, prst->index->rd_att, &prst->nulls[j]);
 	}
-	BlessTupleDesc(tupdesc);
-
-
-	st->dvalues = (Datum *) palloc((tupdesc->natts+2) * sizeof(Datum));
-	st->nulls = palloc((tupdesc->natts+2) * sizeof(*st->nulls));
-
-	funcctx->attinmeta = TupleDescGetAttInMetadata(tupdesc);
-
-	buffer = _bt_gettrueroot(st->index);
-	blk = BufferGetBlockNumber(buffer);
-	UnlockReleaseBuffer(buffer);
-
-	MemoryContextSwitchTo(oldcontext);
 
-	st->item=openBtPPage(funcctx, blk);
+	tuplestore_putvalues(prst->tupstore, prst->tupdesc, prst->dvalues, prst->nulls);
 }
 
-/*
- * Show index elements for btree from root to MAXLEVEL
- * SELECT btree_tree(INDEXNAME[, MAXLEVEL]);
- */
-PG_FUNCTION_INFO_V1(btree_tree);
-Datum btree_tree(PG_FUNCTION_ARGS);
-Datum
-btree_tree(PG_FUNCTION_ARGS)
+static void
+btree_print_page(BtreePrint *prst, BlockNumber blk, int level)
 {
-	text			*name=PG_GETARG_TEXT_PP(0);
-	RangeVar		*relvar;
-	Relation		index;
-	List			*relname_list;
-	BtreeIdxInfo btreeIdxInfo;
-	Buffer			metabuf;
-	Page			metapg;
-	BTMetaPageData  *metad;
-	BlockNumber		rootBlk;
+	Buffer			buffer;
+	Page			page;
+	BTPageOpaque	opaque;
+	OffsetNumber	i,
+					maxoff;
 
-	/*
-	 *  If we use MAXLEVEL is not used in SELECT btree_tree(INDEXNAME),
-	 *  info.maxlevel set to -1
-	 *  If MAXLEVEL is used in btree_tree call, set info.maxlevel = MAXLEVEL
-	 */
-	btreeIdxInfo.idxInfo.maxlevel = ( PG_NARGS() > 1 ) ? PG_GETARG_INT32(1) : -1;
-	btreeIdxInfo.idxInfo.len=1024;
-	btreeIdxInfo.idxInfo.txt=(text*)palloc( btreeIdxInfo.idxInfo.len );
-	btreeIdxInfo.idxInfo.ptr=((char*)btreeIdxInfo.idxInfo.txt)+VARHDRSZ;
+	CHECK_FOR_INTERRUPTS();
 
-	relname_list = textToQualifiedNameList(name);
-	relvar = makeRangeVarFromNameList(relname_list);
-	index = btree_index_open(relvar);
+	buffer = _bt_getbuf(prst->index, blk, BT_READ);
+	page = gevel_copy_page(CurrentMemoryContext, buffer);
+	UnlockReleaseBuffer(buffer);
 
-	/* Start dts from root block */
-	metabuf = _bt_getbuf(index, BTREE_METAPAGE, BT_READ);
-	metapg = BufferGetPage(metabuf);
-	metad = BTPageGetMeta(metapg);
-	rootBlk = metad->btm_root;
-	UnlockReleaseBuffer(metabuf);
+	opaque = (BTPageOpaque)PageGetSpecialPointer(page);
+	maxoff = PageGetMaxOffsetNumber(page);
+	gevel_progress_update(1, level, maxoff);
 
-	btree_deep_search(index, 0, rootBlk, &btreeIdxInfo, print);
+	for (i = P_FIRSTDATAKEY(opaque); i <= maxoff; i = OffsetNumberNext(i))
+	{
+		IndexTuple	ituple = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
 
-	btree_index_close(index);
+		btree_print_row(prst, opaque, ituple, level);
 
-	btreeIdxInfo.idxInfo.ptr=strchr(btreeIdxInfo.idxInfo.ptr,'\0');
+		if (!P_ISLEAF(opaque))
+		{
+#if PG_VERSION_NUM >= 140000
+			btree_print_page(prst, BTreeTupleGetDownLink(ituple), level+1);
+#else
+			btree_print_page(prst, BTreeInnerTupleGetDownLink(ituple), level+1);
+#endif
+		}
+	}
 
-	SET_VARSIZE(btreeIdxInfo.idxInfo.txt,
-			btreeIdxInfo.idxInfo.ptr-((char*)btreeIdxInfo.idxInfo.txt));
-	PG_RETURN_POINTER(btreeIdxInfo.idxInfo.txt);
+	pfree(page);
 }
 
 /*
@@ -1936,276 +2796,4653 @@ Datum btree_print(PG_FUNCTION_ARGS);
 Datum
 btree_print(PG_FUNCTION_ARGS)
 {
-	FuncCallContext *funcctx;
-	BtTypeStorage   *st;
-	ItemId		  iid;
-	IndexTuple	  ituple;
-	HeapTuple	   htuple;
-	int				i;
-	bool			isnull;
-	BTPageOpaque opaque;
-	Datum result=(Datum)0;
-
-	if (SRF_IS_FIRSTCALL())
+	text		*name=PG_GETARG_TEXT_PP(0);
+	BtreePrint	prst;
+	Buffer		buffer;
+	BlockNumber	rootBlk;
+
+	prst.index = btree_share_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+	prst.tupdesc = btree_print_tupdesc(prst.index);
+	prst.tupstore = materializeSetup(fcinfo, prst.tupdesc);
+	prst.dvalues = (Datum *) palloc(prst.tupdesc->natts * sizeof(Datum));
+	prst.nulls = (bool *) palloc(prst.tupdesc->natts * sizeof(bool));
+
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_PRINT, prst.index);
+	/* an empty index has no root yet */
+	buffer = _bt_gettrueroot(prst.index);
+	if (BufferIsValid(buffer))
 	{
-		text	*name=PG_GETARG_TEXT_PP(0);
-		funcctx = SRF_FIRSTCALL_INIT();
-		btree_setup_firstcall(funcctx, name);
-		PG_FREE_IF_COPY(name,0);
+		rootBlk = BufferGetBlockNumber(buffer);
+		UnlockReleaseBuffer(buffer);
+		btree_print_page(&prst, rootBlk, 1);
 	}
+	gevel_progress_end();
 
-	funcctx = SRF_PERCALL_SETUP();
-	st = (BtTypeStorage*)(funcctx->user_fctx);
+	pfree(prst.dvalues);
+	pfree(prst.nulls);
+	btree_share_close(prst.index);
+	PG_FREE_IF_COPY(name,0);
 
-	/*
-	 * Looking through the stack of btree pages.
-	 * If the item == NULL, then the search is over.
-	 * For each btree page we look through all the tuples.
-	 * If the offset is larger than the btree page size, the search is over.
-	 */
+	return (Datum) 0;
+}
 
-	if ( !st->item )
-	{
-		btree_close_call(funcctx);
-		SRF_RETURN_DONE(funcctx);
-	}
+/*
+ * Key range of btree_print_range on the first index column. The ORDER
+ * proc compares an index key with a bound of the bounds' type, a NULL
+ * bound leaves that side open.
+ */
+typedef struct BtreeRange
+{
+	FmgrInfo	cmp;
+	Oid			collation;
+	bool		desc;
+	bool		nullsFirst;
+	bool		hasLower;
+	bool		hasUpper;
+	Datum		lower;
+	Datum		upper;
+} BtreeRange;
+
+/* -1, 0 or 1 if key is before, in or after the range in index order */
+static int
+btree_range_position(BtreeRange *range, Datum key)
+{
+	if (range->hasLower &&
+		DatumGetInt32(FunctionCall2Coll(&range->cmp, range->collation,
+										key, range->lower)) < 0)
+		return range->desc ? 1 : -1;
+	if (range->hasUpper &&
+		DatumGetInt32(FunctionCall2Coll(&range->cmp, range->collation,
+										key, range->upper)) > 0)
+		return range->desc ? -1 : 1;
+	return 0;
+}
+
+/* put the pivot tuple at offset of page blk */
+static void
+btree_print_pivot(BtreePrint *prst, BlockNumber blk, OffsetNumber offset, uint32 rootlevel)
+{
+	Buffer			buffer;
+	Page			page;
+	BTPageOpaque	opaque;
+
+	buffer = _bt_getbuf(prst->index, blk, BT_READ);
+	page = gevel_copy_page(CurrentMemoryContext, buffer);
+	UnlockReleaseBuffer(buffer);
 
-	/* View all tuples on the page */
-	while( st->item->offset > PageGetMaxOffsetNumber( st->item->page ) )
+	opaque = (BTPageOpaque)PageGetSpecialPointer(page);
+	gevel_progress_update(1, rootlevel - BtPageGetLevel(opaque) + 1,
+						  PageGetMaxOffsetNumber(page));
+
+	if (offset <= PageGetMaxOffsetNumber(page))
+		btree_print_row(prst, opaque,
+						(IndexTuple) PageGetItem(page, PageGetItemId(page, offset)),
+						rootlevel - BtPageGetLevel(opaque) + 1);
+	pfree(page);
+}
+
+/*
+ * Descend with the regular btree search to the leaf where bound belongs
+ * and return it read-locked. The search stack holds the downlink followed
+ * on every level below the fast root, those are the pivots of the path.
+ * The pivots are read with the leaf unlocked, as no parent may be locked
+ * while a child is; a split of the leaf meanwhile only moves keys to the
+ * right, where btree_range_leaves follows them.
+ */
+static Buffer
+btree_range_search(BtreePrint *prst, BtreeRange *range, Datum bound,
+				   Oid boundtype, Oid procOid, bool pivots, uint32 rootlevel)
+{
+	BTScanInsert	key;
+	BTStack			stack,
+					s;
+	BTStack		   *path;
+	int				npath = 0;
+	Buffer			buffer;
+
+	key = (BTScanInsert) palloc0(sizeof(BTScanInsertData));
+#if PG_VERSION_NUM >= 130000
+	_bt_metaversion(prst->index, &key->heapkeyspace, &key->allequalimage);
+#else
+	key->heapkeyspace = _bt_heapkeyspace(prst->index);
+#endif
+	key->nextkey = false;
+	key->scantid = NULL;
+	key->keysz = 1;
+	ScanKeyEntryInitialize(&key->scankeys[0],
+						   prst->index->rd_indoption[0] << SK_BT_INDOPTION_SHIFT,
+						   1, InvalidStrategy, boundtype, range->collation,
+						   procOid, bound);
+
+	stack = _bt_search(prst->index, key, &buffer, BT_READ, NULL);
+
+	if (pivots && stack)
 	{
-		if ( ! closeBtPPage(funcctx) ) {
-			btree_close_call(funcctx);
-			SRF_RETURN_DONE(funcctx);
-		}
+		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+
+		for (s = stack; s; s = s->bts_parent)
+			npath++;
+		path = (BTStack *) palloc(sizeof(BTStack) * (npath + 1));
+		npath = 0;
+		for (s = stack; s; s = s->bts_parent)
+			path[npath++] = s;
+		/* root first, as btree_print does */
+		while (npath-- > 0)
+			btree_print_pivot(prst, path[npath]->bts_blkno,
+							  path[npath]->bts_offset, rootlevel);
+		pfree(path);
+
+		LockBuffer(buffer, BT_READ);
 	}
 
-	iid = PageGetItemId( st->item->page, st->item->offset );
-	ituple = (IndexTuple) PageGetItem(st->item->page, iid);
+	_bt_freestack(stack);
+	pfree(key);
+
+	return buffer;
+}
+
+/* the leftmost descent from the fast root, for a range open at its start */
+static Buffer
+btree_range_leftmost(BtreePrint *prst, BlockNumber fastroot, bool pivots, uint32 rootlevel)
+{
+	BlockNumber	blk = fastroot;
 
-	st->dvalues[0] = Int32GetDatum( st->item->level );
-	st->nulls[0] = ISNOTNULL;
-	opaque = (BTPageOpaque)PageGetSpecialPointer(st->item->page);
-	st->dvalues[1] = BoolGetDatum(P_ISLEAF(opaque) && !ItemPointerIsValid(&(ituple->t_tid)) ? false : true);
-	st->nulls[1] = ISNOTNULL;
-	for(i=2; i<funcctx->attinmeta->tupdesc->natts; i++)
+	while (pivots)
 	{
-		if (!P_ISLEAF(opaque) && !ItemPointerIsValid(&(ituple->t_tid)))
-		{
-			st->dvalues[i] = (Datum)0;
-			st->nulls[i] = ISNULL;
-		}
-		else
+		Buffer			buffer;
+		Page			page;
+		BTPageOpaque	opaque;
+		IndexTuple		ituple;
+
+		buffer = _bt_getbuf(prst->index, blk, BT_READ);
+		page = gevel_copy_page(CurrentMemoryContext, buffer);
+		UnlockReleaseBuffer(buffer);
+
+		opaque = (BTPageOpaque)PageGetSpecialPointer(page);
+		if (P_ISLEAF(opaque) || P_FIRSTDATAKEY(opaque) > PageGetMaxOffsetNumber(page))
 		{
-			st->dvalues[i] = index_getattr(ituple, i-1, st->index->rd_att, &isnull);
-			st->nulls[i] = ( isnull ) ? ISNULL : ISNOTNULL;
+			pfree(page);
+			break;
 		}
-	}
-
-	htuple = heap_formtuple(funcctx->attinmeta->tupdesc, st->dvalues, st->nulls);
-	result = TupleGetDatum(funcctx->slot, htuple);
-	result = HeapTupleGetDatum(htuple);
-	st->item->offset = OffsetNumberNext(st->item->offset);
 
-	if (!P_ISLEAF(opaque))
-	{
+		ituple = (IndexTuple) PageGetItem(page, PageGetItemId(page, P_FIRSTDATAKEY(opaque)));
+		gevel_progress_update(1, rootlevel - BtPageGetLevel(opaque) + 1,
+							  PageGetMaxOffsetNumber(page));
+		btree_print_row(prst, opaque, ituple, rootlevel - BtPageGetLevel(opaque) + 1);
 #if PG_VERSION_NUM >= 140000
-		BlockNumber blk = BTreeTupleGetDownLink(ituple);
+		blk = BTreeTupleGetDownLink(ituple);
 #else
-		BlockNumber blk = BTreeInnerTupleGetDownLink(ituple);
+		blk = BTreeInnerTupleGetDownLink(ituple);
 #endif
-		openBtPPage(funcctx, blk );
+		pfree(page);
 	}
 
-	SRF_RETURN_NEXT(funcctx, result);
+	return _bt_get_endpoint(prst->index, 0, false, NULL);
 }
 
 /*
- * Print some statistic about brin index
- * SELECT brin_stat(INDEXNAME);
+ * Follow the leaf chain to the right from the read-locked buffer and put
+ * the leaf tuples in range. NULL keys are never in a range: they are
+ * skipped at the start of a NULLS FIRST column and end the scan of a
+ * NULLS LAST one, as nothing but NULLs follows the first of them.
  */
-PG_FUNCTION_INFO_V1(brin_stat);
-Datum brin_stat(PG_FUNCTION_ARGS);
-Datum
-brin_stat(PG_FUNCTION_ARGS)
+static void
+btree_range_leaves(BtreePrint *prst, BtreeRange *range, Buffer buffer, int level)
 {
-	text		*name=PG_GETARG_TEXT_PP(0);
-	RangeVar	*relvar;
-	Relation	index;
-	List		*relname_list;
-
-	BlockNumber startBlk;
-	BlockNumber heapNumBlocks;
-	BlockNumber pagesPerRange;
-	BrinRevmap *revmap;
-	Relation heapRel;
+	bool		done = false;
 
-	Buffer buf;
+	while (!done)
+	{
+		Page			page;
+		BTPageOpaque	opaque;
+		OffsetNumber	i,
+						maxoff;
 
-	uint32 numRevmapPages=0;
-	uint32 numTuples = 0;
-	uint32 numEmptyPages = 0;
-	uint32 numRegularPages = 0;
-	uint64 freeSpace = 0;
-	uint64 usedSpace = 0;
+		CHECK_FOR_INTERRUPTS();
 
-	text *out=(text*)palloc(1024);
-	char *ptr=((char*)out)+VARHDRSZ;
+		page = gevel_copy_page(CurrentMemoryContext, buffer);
+		UnlockReleaseBuffer(buffer);
 
-	relname_list = textToQualifiedNameList(name);
-	relvar = makeRangeVarFromNameList(relname_list);
-	index = brin_index_open(relvar);
+		opaque = (BTPageOpaque)PageGetSpecialPointer(page);
+		maxoff = PageGetMaxOffsetNumber(page);
+		gevel_progress_update(1, level, maxoff);
 
-	revmap = brinRevmapInitialize(index, &pagesPerRange, NULL);
-	heapRel = table_open(IndexGetRelation(RelationGetRelid(index), false),
-								 AccessShareLock);
-	/* Determine range of pages to process */
-	heapNumBlocks = RelationGetNumberOfBlocks(heapRel); // total pages
+		if (!P_IGNORE(opaque))
+		{
+			for (i = P_FIRSTDATAKEY(opaque); i <= maxoff && !done; i = OffsetNumberNext(i))
+			{
+				IndexTuple	ituple = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+				Datum		key;
+				bool		isnull;
+				int			pos;
 
-	table_close(heapRel, AccessShareLock);
+				key = index_getattr(ituple, 1, prst->index->rd_att, &isnull);
+				if (isnull)
+				{
+					if (!range->nullsFirst)
+						done = true;
+					continue;
+				}
 
-	/* The index is up to date, no update required */
-	startBlk = 0;
+				pos = btree_range_position(range, key);
+				if (pos > 0)
+					done = true;
+				else if (pos == 0)
+					btree_print_row(prst, opaque, ituple, level);
+			}
+		}
 
-	buf = InvalidBuffer;
-	/* Scan the revmap */
-	for (; startBlk < heapNumBlocks; startBlk += pagesPerRange)
-	{
-		BrinTuple  *tup;
-		OffsetNumber off;
-		Page	page;
+		if (P_RIGHTMOST(opaque))
+			done = true;
+		else if (!done)
+			buffer = _bt_getbuf(prst->index, opaque->btpo_next, BT_READ);
 
-		numRevmapPages++;
-		/* Get on-disk tuple */
-		tup = brinGetTupleForHeapBlock(revmap, startBlk, &buf, &off, NULL,
-				   BUFFER_LOCK_SHARE, NULL);
+		pfree(page);
+	}
+}
 
-		if (tup)
-		{
-			BrinDesc* bdesc;
+/*
+ * Print the leaf tuples of a btree whose first column is in [lower, upper]
+ * select * from btree_print_range(INDEXNAME, LOWER, UPPER [, PIVOTS])
+ *		as t(level int, valid bool, a int);
+ * The scan starts with a btree search for the first bound in index order
+ * and stops at the first key past the other one, so its cost depends on
+ * the range and not on the index size. With PIVOTS the downlinks followed
+ * by the search come first.
+ */
+PG_FUNCTION_INFO_V1(btree_print_range);
+Datum btree_print_range(PG_FUNCTION_ARGS);
+Datum
+btree_print_range(PG_FUNCTION_ARGS)
+{
+	BtreePrint		prst;
+	BtreeRange		range;
+	bool			pivots = !PG_ARGISNULL(3) && PG_GETARG_BOOL(3);
+	Oid				boundtype = get_fn_expr_argtype(fcinfo->flinfo, 1);
+	Oid				procOid;
+	Buffer			metabuf;
+	BTMetaPageData *metad;
+	BlockNumber		fastroot;
+	uint32			rootlevel;
+
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("index name must not be null")));
+
+	prst.index = btree_share_open(makeRangeVarFromNameList(
+								  textToQualifiedNameList(PG_GETARG_TEXT_PP(0))));
+
+	procOid = get_opfamily_proc(prst.index->rd_opfamily[0],
+								prst.index->rd_opcintype[0],
+								boundtype, BTORDER_PROC);
+	if (!OidIsValid(procOid))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("bounds of type %s cannot be compared with the first column of index \"%s\"",
+						format_type_be(boundtype),
+						RelationGetRelationName(prst.index))));
+
+	fmgr_info(procOid, &range.cmp);
+	range.collation = prst.index->rd_indcollation[0];
+	range.desc = (prst.index->rd_indoption[0] & INDOPTION_DESC) != 0;
+	range.nullsFirst = (prst.index->rd_indoption[0] & INDOPTION_NULLS_FIRST) != 0;
+	range.hasLower = !PG_ARGISNULL(1);
+	range.lower = range.hasLower ? PG_GETARG_DATUM(1) : (Datum) 0;
+	range.hasUpper = !PG_ARGISNULL(2);
+	range.upper = range.hasUpper ? PG_GETARG_DATUM(2) : (Datum) 0;
+
+	prst.tupdesc = btree_print_tupdesc(prst.index);
+	prst.tupstore = materializeSetup(fcinfo, prst.tupdesc);
+	prst.dvalues = (Datum *) palloc(prst.tupdesc->natts * sizeof(Datum));
+	prst.nulls = (bool *) palloc(prst.tupdesc->natts * sizeof(bool));
+
+	metabuf = _bt_getbuf(prst.index, BTREE_METAPAGE, BT_READ);
+	metad = BTPageGetMeta(BufferGetPage(metabuf));
+	fastroot = metad->btm_fastroot;
+	rootlevel = metad->btm_level;
+	UnlockReleaseBuffer(metabuf);
 
-			numTuples++;
-			page = BufferGetPage(buf);
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_PRINT, prst.index);
+	if (fastroot != P_NONE)
+	{
+		Buffer		buffer;
 
-			if (BRIN_IS_REGULAR_PAGE(page))
-				numRegularPages++;
-			freeSpace += PageGetFreeSpace(page);
-			bdesc = brin_build_desc(index);
-			usedSpace += MAXALIGN(sizeof(BrinMemTuple) +
-					sizeof(BrinValues) * bdesc->bd_tupdesc->natts);
-		}
+		/* index order starts at the upper bound of a DESC column */
+		if (range.desc ? range.hasUpper : range.hasLower)
+			buffer = btree_range_search(&prst, &range,
+										range.desc ? range.upper : range.lower,
+										boundtype, procOid, pivots, rootlevel);
 		else
-			/* If the revmap page points to void */
-			numEmptyPages++;
+			buffer = btree_range_leftmost(&prst, fastroot, pivots, rootlevel);
 
-		UnlockReleaseBuffer(buf);
+		if (BufferIsValid(buffer))
+			btree_range_leaves(&prst, &range, buffer, rootlevel + 1);
 	}
+	gevel_progress_end();
 
-	brinRevmapTerminate(revmap);
+	pfree(prst.dvalues);
+	pfree(prst.nulls);
+	btree_share_close(prst.index);
 
-	sprintf(ptr,
-		"Number of revmap pages: 	%d\n"
-		"Number of empty revmap pages:	%d\n"
-		"Number of regular pages:	%d\n"
-		"Number of tuples: 		%d\n"
-		"Used space 		"INT64_FORMAT" bytes\n"
-		"Free space 		"INT64_FORMAT" bytes\n",
-		numRevmapPages,
-		numEmptyPages,
-		numRegularPages,
-		numTuples,
-		usedSpace,
-		freeSpace
-		);
+	return (Datum) 0;
+}
 
-	ptr=strchr(ptr,'\0');
+/*
+ * Deduplication statistic of one btree level. A posting tuple (PG13+)
+ * stands for several heap TIDs; without deduplication each of them would
+ * take its own tuple of the key size plus a line pointer.
+ */
+typedef struct BtreeDedupLevel
+{
+	int64		pages;
+	int64		tuples;
+	int64		postingTuples;
+	int64		plainTuples;
+	int64		heapTids;
+	int64		postingTids;	/* heap TIDs in posting lists */
+	int64		tupleBytes;		/* tuples and their line pointers */
+	int64		savedBytes;
+} BtreeDedupLevel;
 
-	brin_index_close(index);
-	SET_VARSIZE(out, ptr-((char*)out));
-	PG_RETURN_POINTER(out);
+static void
+btree_dedup_page(Page page, BtreeDedupLevel *dl)
+{
+	BTPageOpaque	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	OffsetNumber	i,
+					maxoff = PageGetMaxOffsetNumber(page);
+
+	dl->pages++;
+
+	for (i = P_FIRSTDATAKEY(opaque); i <= maxoff; i = OffsetNumberNext(i))
+	{
+		ItemId		iid = PageGetItemId(page, i);
+		IndexTuple	itup;
+
+		if (!ItemIdIsUsed(iid))
+			continue;
+
+		itup = (IndexTuple) PageGetItem(page, iid);
+		dl->tuples++;
+		dl->tupleBytes += MAXALIGN(IndexTupleSize(itup)) + sizeof(ItemIdData);
+
+		if (!P_ISLEAF(opaque))
+			continue;
+
+#if PG_VERSION_NUM >= 130000
+		if (BTreeTupleIsPosting(itup))
+		{
+			int			nhtids = BTreeTupleGetNPosting(itup);
+			Size		keysize = BTreeTupleGetPostingOffset(itup);
+
+			dl->postingTuples++;
+			dl->heapTids += nhtids;
+			dl->postingTids += nhtids;
+			dl->savedBytes += (int64) nhtids * (keysize + sizeof(ItemIdData)) -
+				(MAXALIGN(IndexTupleSize(itup)) + sizeof(ItemIdData));
+			continue;
+		}
+#endif
+		dl->plainTuples++;
+		dl->heapTids++;
+	}
 }
 
 /*
- * Print numbers of heap blocks from revmap
- * and numbers of end blocks from ranges
+ * Posting list statistic of btree index, one row per level (0 is the
+ * leaf level) and a total row with NULL level.
+ * SELECT * FROM btree_dedup_stat(INDEXNAME);
+ * Pages are read in physical order, deleted and half-dead ones skipped.
  */
-PG_FUNCTION_INFO_V1(brin_print);
-Datum brin_print(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(btree_dedup_stat);
+Datum btree_dedup_stat(PG_FUNCTION_ARGS);
 Datum
-brin_print(PG_FUNCTION_ARGS)
+btree_dedup_stat(PG_FUNCTION_ARGS)
 {
-	text	*name=PG_GETARG_TEXT_PP(0);
-	RangeVar		*relvar;
-	Relation		index;
-	List			*relname_list;
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	BufferAccessStrategy bstrategy;
+	BlockNumber	nblocks,
+				blkno;
+	BtreeDedupLevel *levels,
+				total;
+	int			nlevels = 8,
+				level;
 
-	BlockNumber heapBlk;
-	BlockNumber numBlocks;
-	BlockNumber pagesPerRange;
-	BrinRevmap *revmap;
-	Relation heapRel;
-	int len = 1024;
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
 
-	text *out=(text*)palloc(len);
-	char *ptr=((char*)out)+VARHDRSZ;
+	tupstore = materializeSetup(fcinfo, tupdesc);
 
-	relname_list = textToQualifiedNameList(name);
-	relvar = makeRangeVarFromNameList(relname_list);
-	index = brin_index_open(relvar);
+	index = btree_index_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
 
-	heapRel = table_open(IndexGetRelation(RelationGetRelid(index), false),
-									 AccessShareLock);
+	levels = palloc0(sizeof(BtreeDedupLevel) * nlevels);
+	bstrategy = GetAccessStrategy(BAS_BULKREAD);
+	nblocks = RelationGetNumberOfBlocks(index);
 
-	/* Determine range of pages to process */
-	numBlocks = RelationGetNumberOfBlocks(heapRel);
-	table_close(heapRel, AccessShareLock);
-	revmap = brinRevmapInitialize(index, &pagesPerRange, NULL);
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_DEDUP_STAT, index);
+	for (blkno = BTREE_METAPAGE + 1; blkno < nblocks; blkno++)
+	{
+		Buffer		buf;
+		Page		page;
+		BTPageOpaque opaque;
 
-	for(heapBlk = 0; heapBlk < numBlocks; heapBlk += pagesPerRange)
+		CHECK_FOR_INTERRUPTS();
+
+		buf = ReadBufferExtended(index, MAIN_FORKNUM, blkno, RBM_NORMAL, bstrategy);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+
+		if (!PageIsNew(page) && !P_IGNORE(opaque))
+		{
+			level = BtPageGetLevel(opaque);
+			if (level >= nlevels)
+			{
+				levels = repalloc(levels, sizeof(BtreeDedupLevel) * (level + 1));
+				memset(levels + nlevels, 0, sizeof(BtreeDedupLevel) * (level + 1 - nlevels));
+				nlevels = level + 1;
+			}
+			btree_dedup_page(page, &levels[level]);
+		}
+
+		gevel_progress_update(1, -1, PageGetMaxOffsetNumber(page));
+		UnlockReleaseBuffer(buf);
+	}
+	gevel_progress_end();
+
+	FreeAccessStrategy(bstrategy);
+
+	memset(&total, 0, sizeof(total));
+	for (level = 0; level <= nlevels; level++)
 	{
-		BlockNumber rangeEndBlk;
-		BlockNumber rangeBlk;
+		BtreeDedupLevel *dl;
+		Datum		values[9];
+		bool		nulls[9];
 
-		while ( (ptr-((char*)out)) + heapBlk*4 + 128 >= len )
+		memset(nulls, 0, sizeof(nulls));
+		if (level < nlevels)
 		{
-			int dist=ptr-((char*)out);
-			len *= 2;
-			out=(text*)repalloc(out, len);
-			ptr = ((char*)out)+dist;
-			Assert(0);
+			dl = &levels[level];
+			if (dl->pages == 0)
+				continue;
+
+			values[0] = Int32GetDatum(level);
+			total.pages += dl->pages;
+			total.tuples += dl->tuples;
+			total.postingTuples += dl->postingTuples;
+			total.plainTuples += dl->plainTuples;
+			total.heapTids += dl->heapTids;
+			total.postingTids += dl->postingTids;
+			total.tupleBytes += dl->tupleBytes;
+			total.savedBytes += dl->savedBytes;
+		}
+		else
+		{
+			dl = &total;
+			nulls[0] = true;
 		}
 
-		/* Compute rage end */
-		if (heapBlk + pagesPerRange > numBlocks)
-			rangeEndBlk = Min(RelationGetNumberOfBlocks(heapRel) - heapBlk,
-								  pagesPerRange);
+		values[1] = Int64GetDatum(dl->pages);
+		values[2] = Int64GetDatum(dl->tuples);
+		values[3] = Int64GetDatum(dl->postingTuples);
+		values[4] = Int64GetDatum(dl->plainTuples);
+		values[5] = Int64GetDatum(dl->heapTids);
+		if (dl->postingTuples > 0)
+			values[6] = Float8GetDatum((double) dl->postingTids / dl->postingTuples);
 		else
-			/* Easy case: range is known to be complete */
-			rangeEndBlk = pagesPerRange;
-		sprintf(ptr, "Start block: %d; end block: %d \n", heapBlk, rangeEndBlk);
+			nulls[6] = true;
+		values[7] = Int64GetDatum(dl->tupleBytes);
+		values[8] = Int64GetDatum(dl->savedBytes);
 
-		for (rangeBlk = 0; rangeBlk < rangeEndBlk; rangeBlk++)
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	pfree(levels);
+	btree_index_close(index);
+
+	PG_FREE_IF_COPY(name, 0);
+	return (Datum) 0;
+}
+
+static int
+btree_pivot_size_cmp(const void *a, const void *b)
+{
+	int			sa = *(const int *) a;
+	int			sb = *(const int *) b;
+
+	return (sa > sb) - (sa < sb);
+}
+
+/*
+ * Pivot tuples and fanout of btree index, one row per internal level from
+ * the root down (the level of the leaves' parents is 1). Sizes are of the
+ * pivots separating the children, i.e. what suffix truncation produced.
+ * max_fanout is how many pivots of the average size fit on a page, and on
+ * the root row growth_to_next_level is how many times the index may grow
+ * before the root splits and the tree gains a level.
+ * SELECT * FROM btree_pivot_stat(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(btree_pivot_stat);
+Datum btree_pivot_stat(PG_FUNCTION_ARGS);
+Datum
+btree_pivot_stat(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	BtreeIdxInfo btreeIdxInfo;
+	Buffer		metabuf;
+	BTMetaPageData *metad;
+	BlockNumber	rootBlk;
+	int			rootLevel;
+	int			level;
+	double		usable = BLCKSZ - SizeOfPageHeaderData -
+						 MAXALIGN(sizeof(BTPageOpaqueData));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = materializeSetup(fcinfo, tupdesc);
+
+	index = btree_index_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	metabuf = _bt_getbuf(index, BTREE_METAPAGE, BT_READ);
+	metad = BTPageGetMeta(BufferGetPage(metabuf));
+	rootBlk = metad->btm_root;
+	rootLevel = metad->btm_level;
+	UnlockReleaseBuffer(metabuf);
+
+	memset(&btreeIdxInfo, 0, sizeof(btreeIdxInfo));
+	btreeIdxInfo.npivotlevels = rootLevel + 1;
+	btreeIdxInfo.pivots = palloc0(sizeof(BtreePivotLevel) * btreeIdxInfo.npivotlevels);
+	/* the walk stops at the parents of the leaves */
+	btreeIdxInfo.idxInfo.maxlevel = rootLevel - 1;
+
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_PIVOT_STAT, index);
+	if (rootBlk != P_NONE && rootLevel > 0)
+		btree_deep_search(index, 0, rootBlk, &btreeIdxInfo, pivot);
+	gevel_progress_end();
+
+	for (level = rootLevel; level >= 1; level--)
+	{
+		BtreePivotLevel *pl = &btreeIdxInfo.pivots[level];
+		Datum		values[13];
+		bool		nulls[13];
+		int64		totalsize = 0;
+		int			i;
+
+		if (pl->pages == 0)
+			continue;
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(level);
+		values[1] = Int64GetDatum(pl->pages);
+		values[2] = Int64GetDatum(pl->downlinks);
+		values[3] = Float8GetDatum((double) pl->downlinks / pl->pages);
+
+		if (pl->nsizes > 0)
 		{
-				Page page;
-				/* Read buffer for open table */
-				Buffer buf = ReadBuffer(heapRel, rangeBlk);
-				page = BufferGetPage(buf);
-				sprintf(ptr, "Start block: %d; end block: %d; offset: %d, free: %d\n",
-						heapBlk,
-						rangeEndBlk,
-						(int) PageGetMaxOffsetNumber(page),
-						(int) PageGetFreeSpace(page));
+			qsort(pl->sizes, pl->nsizes, sizeof(int), btree_pivot_size_cmp);
+			for (i = 0; i < pl->nsizes; i++)
+				totalsize += pl->sizes[i];
+
+			values[4] = Float8GetDatum(usable /
+						((double) totalsize / pl->nsizes + sizeof(ItemIdData)));
+			values[5] = Int32GetDatum(pl->sizes[0]);
+			values[6] = Int32GetDatum(pl->sizes[pl->nsizes / 2]);
+			values[7] = Int32GetDatum(pl->sizes[(int) (pl->nsizes * 0.9)]);
+			values[8] = Int32GetDatum(pl->sizes[pl->nsizes - 1]);
+			values[10] = Float8GetDatum((double) pl->keyatts / pl->nsizes);
+		}
+		else
+		{
+			nulls[4] = nulls[5] = nulls[6] = nulls[7] = nulls[8] = true;
+			nulls[10] = true;
+		}
+		values[9] = Int64GetDatum(pl->truncated);
+		values[11] = Int64GetDatum(pl->heaptid);
 
-				ReleaseBuffer(buf);
+		if (level == rootLevel && !nulls[4])
+			values[12] = Float8GetDatum(DatumGetFloat8(values[4]) / pl->downlinks);
+		else
+			nulls[12] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+		if (pl->sizes)
+			pfree(pl->sizes);
+	}
+
+	pfree(btreeIdxInfo.pivots);
+	btree_index_close(index);
+
+	PG_FREE_IF_COPY(name, 0);
+	return (Datum) 0;
+}
+
+/*
+ * Duplicate runs of one key prefix of btree_prefix_stat(). Leaf entries
+ * come in key order, so equal prefixes are adjacent and a run ends where
+ * the prefix changes.
+ */
+typedef struct BtreePrefixRun
+{
+	int64		ndistinct;
+	int64		run;			/* length of the current run */
+	int64		maxrun;
+} BtreePrefixRun;
+
+/* number of leading key attributes of a and b that are equal */
+static int
+btree_prefix_equal(Relation rel, FmgrInfo *cmp, IndexTuple a, IndexTuple b)
+{
+	int			nkeyatts = IndexRelationGetNumberOfKeyAttributes(rel);
+	int			i;
+
+	for (i = 0; i < nkeyatts; i++)
+	{
+		Datum		da,
+					db;
+		bool		nulla,
+					nullb;
+
+		da = index_getattr(a, i + 1, rel->rd_att, &nulla);
+		db = index_getattr(b, i + 1, rel->rd_att, &nullb);
+
+		if (nulla || nullb)
+		{
+			if (nulla != nullb)
+				break;
+			continue;
 		}
 
-		ptr=strchr(ptr,'\0');
+		if (DatumGetInt32(FunctionCall2Coll(&cmp[i], rel->rd_indcollation[i], da, db)) != 0)
+			break;
 	}
 
-	brinRevmapTerminate(revmap);
+	return i;
+}
 
-	brin_index_close(index);
-	ptr=strchr(ptr,'\0');
-	SET_VARSIZE(out, ptr-((char*)out));
-	PG_RETURN_POINTER(out);
+/*
+ * Exact distinct count and duplicate runs for every key prefix of btree
+ * index, from one pass over the leaf level in key order with one page
+ * locked at a time and memory independent of the index size. Entries are
+ * heap TIDs, a posting list counts as many entries as it holds, and NULLs
+ * are equal to each other as they are in the index. skew is the longest
+ * run over the average one. The index is only share-locked; entries
+ * inserted meanwhile are counted if their page is not read yet.
+ * SELECT * FROM btree_prefix_stat(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(btree_prefix_stat);
+Datum btree_prefix_stat(PG_FUNCTION_ARGS);
+Datum
+btree_prefix_stat(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	int			nkeyatts;
+	FmgrInfo	*cmp;
+	BtreePrefixRun *runs;
+	IndexTuple	prev = NULL;
+	int64		nentries = 0;
+	Buffer		buffer;
+	StringInfoData columns;
+	int			k;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = materializeSetup(fcinfo, tupdesc);
+
+	index = btree_share_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	nkeyatts = IndexRelationGetNumberOfKeyAttributes(index);
+	cmp = palloc(sizeof(FmgrInfo) * nkeyatts);
+	for (k = 0; k < nkeyatts; k++)
+		fmgr_info_copy(&cmp[k], index_getprocinfo(index, k + 1, BTORDER_PROC),
+					   CurrentMemoryContext);
+	runs = palloc0(sizeof(BtreePrefixRun) * nkeyatts);
+
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_PREFIX_STAT, index);
+	buffer = _bt_get_endpoint(index, 0, false, NULL);
+	while (BufferIsValid(buffer))
+	{
+		Page			page = BufferGetPage(buffer);
+		BTPageOpaque	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+		OffsetNumber	i,
+						maxoff = PageGetMaxOffsetNumber(page);
+		BlockNumber		next = opaque->btpo_next;
+
+		CHECK_FOR_INTERRUPTS();
+		gevel_progress_update(1, 0, maxoff);
+
+		for (i = P_FIRSTDATAKEY(opaque); i <= maxoff && !P_IGNORE(opaque); i = OffsetNumberNext(i))
+		{
+			IndexTuple	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+			int			nequal = prev ? btree_prefix_equal(index, cmp, prev, itup) : 0;
+			int64		weight = 1;
+
+#if PG_VERSION_NUM >= 130000
+			if (BTreeTupleIsPosting(itup))
+				weight = BTreeTupleGetNPosting(itup);
+#endif
+			for (k = 0; k < nkeyatts; k++)
+			{
+				BtreePrefixRun *r = &runs[k];
+
+				if (k < nequal)
+					r->run += weight;
+				else
+				{
+					/* the prefix of k + 1 attributes starts a new run */
+					r->maxrun = Max(r->maxrun, r->run);
+					r->ndistinct++;
+					r->run = weight;
+				}
+			}
+			nentries += weight;
+
+			if (prev)
+				pfree(prev);
+			prev = CopyIndexTuple(itup);
+		}
+
+		UnlockReleaseBuffer(buffer);
+		buffer = (next != P_NONE) ? _bt_getbuf(index, next, BT_READ) : InvalidBuffer;
+	}
+	gevel_progress_end();
+
+	initStringInfo(&columns);
+	for (k = 0; k < nkeyatts; k++)
+	{
+		BtreePrefixRun *r = &runs[k];
+		Datum		values[7];
+		bool		nulls[7];
+
+		r->maxrun = Max(r->maxrun, r->run);
+
+		if (k > 0)
+			appendStringInfoString(&columns, ", ");
+		appendStringInfoString(&columns,
+							   quote_identifier(NameStr(TupleDescAttr(index->rd_att, k)->attname)));
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(k + 1);
+		values[1] = CStringGetTextDatum(columns.data);
+		values[2] = Int64GetDatum(nentries);
+		values[3] = Int64GetDatum(r->ndistinct);
+		values[4] = Int64GetDatum(r->maxrun);
+		if (r->ndistinct > 0)
+		{
+			double		avgrun = (double) nentries / r->ndistinct;
+
+			values[5] = Float8GetDatum(avgrun);
+			values[6] = Float8GetDatum(r->maxrun / avgrun);
+		}
+		else
+			nulls[5] = nulls[6] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	if (prev)
+		pfree(prev);
+	pfree(runs);
+	pfree(cmp);
+	btree_share_close(index);
+
+	PG_FREE_IF_COPY(name, 0);
+	return (Datum) 0;
+}
+
+#if PG_VERSION_NUM >= 140000
+#define BtPageRecyclable(page)	BTPageIsRecyclable(page)
+#else
+#define BtPageRecyclable(page)	_bt_page_recyclable(page)
+#endif
+
+#define BTREE_BLOAT_LEVELS	16
+
+/*
+ * What btree_stat leaves out: every page of btree index is classified in
+ * block order, deleted pages by whether their deletion XID is old enough
+ * for reuse, and compared with the free space map, where VACUUM records
+ * the pages it found recyclable. LP_DEAD items are counted per level on
+ * live pages, they are killed entries not yet removed. Pages are only
+ * share-locked one at a time, and so is the index.
+ * SELECT btree_bloat_stat(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(btree_bloat_stat);
+Datum btree_bloat_stat(PG_FUNCTION_ARGS);
+Datum
+btree_bloat_stat(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	BufferAccessStrategy bstrategy;
+	BlockNumber	nblocks,
+				blkno;
+	int64		nLeaf = 0,
+				nInner = 0,
+				nEmpty = 0,
+				nHalfDead = 0,
+				nDeleted = 0,
+				nRecyclable = 0,
+				nNew = 0,
+				nInFsm = 0,
+				nRecyclableNotInFsm = 0,
+				nLiveInFsm = 0;
+	int64		items[BTREE_BLOAT_LEVELS],
+				dead[BTREE_BLOAT_LEVELS];
+	int			maxlevel = -1,
+				level;
+	bool		haveXid = false;
+#if PG_VERSION_NUM >= 140000
+	FullTransactionId oldestXid = InvalidFullTransactionId;
+#else
+	TransactionId oldestXid = InvalidTransactionId;
+#endif
+	StringInfoData out;
+
+	index = btree_share_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	memset(items, 0, sizeof(items));
+	memset(dead, 0, sizeof(dead));
+	bstrategy = GetAccessStrategy(BAS_BULKREAD);
+	nblocks = RelationGetNumberOfBlocks(index);
+
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_BLOAT_STAT, index);
+	for (blkno = BTREE_METAPAGE + 1; blkno < nblocks; blkno++)
+	{
+		Buffer		buf;
+		Page		page;
+		BTPageOpaque opaque;
+		bool		inFsm;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buf = ReadBufferExtended(index, MAIN_FORKNUM, blkno, RBM_NORMAL, bstrategy);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+		inFsm = GetRecordedFreeSpace(index, blkno) > 0;
+
+		if (inFsm)
+			nInFsm++;
+
+		if (PageIsNew(page))
+		{
+			nNew++;
+			if (!inFsm)
+				nRecyclableNotInFsm++;
+		}
+		else if (P_ISDELETED(opaque))
+		{
+			nDeleted++;
+			if (BtPageRecyclable(page))
+			{
+				nRecyclable++;
+				if (!inFsm)
+					nRecyclableNotInFsm++;
+			}
+			else
+			{
+#if PG_VERSION_NUM >= 140000
+				FullTransactionId xid = BTPageGetDeleteXid(page);
+
+				if (!haveXid || FullTransactionIdPrecedes(xid, oldestXid))
+					oldestXid = xid;
+#else
+				if (!haveXid || TransactionIdPrecedes(opaque->btpo.xact, oldestXid))
+					oldestXid = opaque->btpo.xact;
+#endif
+				haveXid = true;
+			}
+		}
+		else if (P_ISHALFDEAD(opaque))
+			nHalfDead++;
+		else
+		{
+			OffsetNumber i,
+						maxoff = PageGetMaxOffsetNumber(page);
+
+			if (inFsm)
+				nLiveInFsm++;
+
+			if (P_ISLEAF(opaque))
+			{
+				nLeaf++;
+				if (P_FIRSTDATAKEY(opaque) > maxoff && !P_ISROOT(opaque))
+					nEmpty++;
+			}
+			else
+				nInner++;
+
+			level = Min(BtPageGetLevel(opaque), BTREE_BLOAT_LEVELS - 1);
+			maxlevel = Max(maxlevel, level);
+			for (i = P_FIRSTDATAKEY(opaque); i <= maxoff; i = OffsetNumberNext(i))
+			{
+				items[level]++;
+				if (ItemIdIsDead(PageGetItemId(page, i)))
+					dead[level]++;
+			}
+		}
+
+		gevel_progress_update(1, -1, PageGetMaxOffsetNumber(page));
+		UnlockReleaseBuffer(buf);
+	}
+	gevel_progress_end();
+
+	FreeAccessStrategy(bstrategy);
+	btree_share_close(index);
+
+	initStringInfo(&out);
+	appendStringInfo(&out,
+		"Number of pages:              %u\n"
+		"Live leaf pages:              " INT64_FORMAT "\n"
+		"Live internal pages:          " INT64_FORMAT "\n"
+		"Empty leaf pages:             " INT64_FORMAT "\n"
+		"Half-dead pages:              " INT64_FORMAT "\n"
+		"Deleted pages:                " INT64_FORMAT "\n"
+		"Recyclable deleted pages:     " INT64_FORMAT "\n"
+		"New pages:                    " INT64_FORMAT "\n"
+		"Pages in free space map:      " INT64_FORMAT "\n"
+		"Reusable pages not in FSM:    " INT64_FORMAT "\n"
+		"Live pages in FSM:            " INT64_FORMAT "\n",
+		nblocks,
+		nLeaf, nInner, nEmpty, nHalfDead,
+		nDeleted, nRecyclable, nNew,
+		nInFsm, nRecyclableNotInFsm, nLiveInFsm);
+
+	if (haveXid)
+#if PG_VERSION_NUM >= 140000
+		appendStringInfo(&out, "Oldest pending deletion XID:  " UINT64_FORMAT "\n",
+						 U64FromFullTransactionId(oldestXid));
+#else
+		appendStringInfo(&out, "Oldest pending deletion XID:  %u\n", oldestXid);
+#endif
+
+	for (level = 0; level <= maxlevel; level++)
+		appendStringInfo(&out,
+			"LP_DEAD items at level %-2d:    " INT64_FORMAT " of " INT64_FORMAT " (%.2f%%)\n",
+			level, dead[level], items[level],
+			(items[level] > 0) ? 100.0 * dead[level] / items[level] : 0.0);
+
+	PG_FREE_IF_COPY(name, 0);
+	PG_RETURN_TEXT_P(cstring_to_text(out.data));
+}
+
+/*
+ * Print some statistic about brin index
+ * SELECT brin_stat(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(brin_stat);
+Datum brin_stat(PG_FUNCTION_ARGS);
+Datum
+brin_stat(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	RangeVar	*relvar;
+	Relation	index;
+	List		*relname_list;
+
+	BlockNumber startBlk;
+	BlockNumber heapNumBlocks;
+	BlockNumber pagesPerRange;
+	BrinRevmap *revmap;
+	Relation heapRel;
+
+	Buffer buf;
+
+	uint32 numRevmapPages=0;
+	uint32 numTuples = 0;
+	uint32 numEmptyPages = 0;
+	uint32 numRegularPages = 0;
+	uint64 freeSpace = 0;
+	uint64 usedSpace = 0;
+
+	text *out=(text*)palloc(1024);
+	char *ptr=((char*)out)+VARHDRSZ;
+
+	relname_list = textToQualifiedNameList(name);
+	relvar = makeRangeVarFromNameList(relname_list);
+	index = brin_index_open(relvar);
+
+	revmap = brinRevmapInitialize(index, &pagesPerRange, NULL);
+	heapRel = table_open(IndexGetRelation(RelationGetRelid(index), false),
+								 AccessShareLock);
+	/* Determine range of pages to process */
+	heapNumBlocks = RelationGetNumberOfBlocks(heapRel); // total pages
+
+	table_close(heapRel, AccessShareLock);
+
+	/* The index is up to date, no update required */
+	startBlk = 0;
+
+	gevel_progress_start(GEVEL_PROGRESS_BRIN_STAT, index);
+	gevel_progress_phase(GEVEL_PROGRESS_PHASE_INDEX, heapNumBlocks);
+
+	buf = InvalidBuffer;
+	/* Scan the revmap */
+	for (; startBlk < heapNumBlocks; startBlk += pagesPerRange)
+	{
+		BrinTuple  *tup;
+		OffsetNumber off;
+		Page	page;
+
+		numRevmapPages++;
+		/* Get on-disk tuple */
+		tup = brinGetTupleForHeapBlock(revmap, startBlk, &buf, &off, NULL,
+				   BUFFER_LOCK_SHARE, NULL);
+
+		if (tup)
+		{
+			BrinDesc* bdesc;
+
+			numTuples++;
+			page = BufferGetPage(buf);
+
+			if (BRIN_IS_REGULAR_PAGE(page))
+				numRegularPages++;
+			freeSpace += PageGetFreeSpace(page);
+			bdesc = brin_build_desc(index);
+			usedSpace += MAXALIGN(sizeof(BrinMemTuple) +
+					sizeof(BrinValues) * bdesc->bd_tupdesc->natts);
+		}
+		else
+			/* If the revmap page points to void */
+			numEmptyPages++;
+
+		UnlockReleaseBuffer(buf);
+		gevel_progress_update(Min(pagesPerRange, heapNumBlocks - startBlk), -1,
+							  tup ? 1 : 0);
+	}
+
+	gevel_progress_end();
+	brinRevmapTerminate(revmap);
+
+	sprintf(ptr,
+		"Number of revmap pages: 	%d\n"
+		"Number of empty revmap pages:	%d\n"
+		"Number of regular pages:	%d\n"
+		"Number of tuples: 		%d\n"
+		"Used space 		"INT64_FORMAT" bytes\n"
+		"Free space 		"INT64_FORMAT" bytes\n",
+		numRevmapPages,
+		numEmptyPages,
+		numRegularPages,
+		numTuples,
+		usedSpace,
+		freeSpace
+		);
+
+	ptr=strchr(ptr,'\0');
+
+	brin_index_close(index);
+	SET_VARSIZE(out, ptr-((char*)out));
+	PG_RETURN_POINTER(out);
+}
+
+/*
+ * Print numbers of heap blocks from revmap
+ * and numbers of end blocks from ranges
+ */
+PG_FUNCTION_INFO_V1(brin_print);
+Datum brin_print(PG_FUNCTION_ARGS);
+Datum
+brin_print(PG_FUNCTION_ARGS)
+{
+	text	*name=PG_GETARG_TEXT_PP(0);
+	RangeVar		*relvar;
+	Relation		index;
+	List			*relname_list;
+
+	BlockNumber heapBlk;
+	BlockNumber numBlocks;
+	BlockNumber pagesPerRange;
+	BrinRevmap *revmap;
+	Relation heapRel;
+	int len = 1024;
+
+	text *out=(text*)palloc(len);
+	char *ptr=((char*)out)+VARHDRSZ;
+
+	relname_list = textToQualifiedNameList(name);
+	relvar = makeRangeVarFromNameList(relname_list);
+	index = brin_index_open(relvar);
+
+	heapRel = table_open(IndexGetRelation(RelationGetRelid(index), false),
+									 AccessShareLock);
+
+	/* Determine range of pages to process */
+	numBlocks = RelationGetNumberOfBlocks(heapRel);
+	table_close(heapRel, AccessShareLock);
+	revmap = brinRevmapInitialize(index, &pagesPerRange, NULL);
+
+	gevel_progress_start(GEVEL_PROGRESS_BRIN_PRINT, index);
+	gevel_progress_phase(GEVEL_PROGRESS_PHASE_HEAP, numBlocks);
+
+	for(heapBlk = 0; heapBlk < numBlocks; heapBlk += pagesPerRange)
+	{
+		BlockNumber rangeEndBlk;
+		BlockNumber rangeBlk;
+
+		while ( (ptr-((char*)out)) + heapBlk*4 + 128 >= len )
+		{
+			int dist=ptr-((char*)out);
+			len *= 2;
+			out=(text*)repalloc(out, len);
+			ptr = ((char*)out)+dist;
+			Assert(0);
+		}
+
+		/* Compute rage end */
+		if (heapBlk + pagesPerRange > numBlocks)
+			rangeEndBlk = Min(RelationGetNumberOfBlocks(heapRel) - heapBlk,
+								  pagesPerRange);
+		else
+			/* Easy case: range is known to be complete */
+			rangeEndBlk = pagesPerRange;
+		sprintf(ptr, "Start block: %d; end block: %d \n", heapBlk, rangeEndBlk);
+
+		for (rangeBlk = 0; rangeBlk < rangeEndBlk; rangeBlk++)
+		{
+				Page page;
+				/* Read buffer for open table */
+				Buffer buf = ReadBuffer(heapRel, rangeBlk);
+				page = BufferGetPage(buf);
+				sprintf(ptr, "Start block: %d; end block: %d; offset: %d, free: %d\n",
+						heapBlk,
+						rangeEndBlk,
+						(int) PageGetMaxOffsetNumber(page),
+						(int) PageGetFreeSpace(page));
+
+				ReleaseBuffer(buf);
+		}
+
+		ptr=strchr(ptr,'\0');
+		gevel_progress_update(rangeEndBlk, -1, 0);
+	}
+
+	gevel_progress_end();
+	brinRevmapTerminate(revmap);
+
+	brin_index_close(index);
+	ptr=strchr(ptr,'\0');
+	SET_VARSIZE(out, ptr-((char*)out));
+	PG_RETURN_POINTER(out);
+}
+
+typedef void (*BrinSummaryCallback) (BrinDesc *bdesc, BlockNumber heapBlk,
+									 BrinMemTuple *dtup, void *arg);
+
+/*
+ * Walk the revmap once and pass every range to the callback.
+ * Ranges without a summary (or with a placeholder tuple) are passed
+ * with dtup == NULL. The deformed tuple is reused between calls, so
+ * the callback has to copy whatever it wants to keep. Progress is
+ * reported in heap blocks covered by the ranges read.
+ * Returns the number of heap blocks of the indexed table.
+ */
+static BlockNumber
+brin_scan_summaries(Relation index, BrinDesc *bdesc, BlockNumber *pagesPerRange,
+					BrinSummaryCallback callback, void *arg)
+{
+	BrinRevmap	   *revmap;
+	Relation		heapRel;
+	BlockNumber		heapNumBlocks;
+	BlockNumber		heapBlk;
+	BrinMemTuple   *dtup = NULL;
+	Buffer			buf = InvalidBuffer;
+
+	heapRel = table_open(IndexGetRelation(RelationGetRelid(index), false),
+						 AccessShareLock);
+	heapNumBlocks = RelationGetNumberOfBlocks(heapRel);
+	table_close(heapRel, AccessShareLock);
+
+	revmap = brinRevmapInitialize(index, pagesPerRange, NULL);
+	gevel_progress_phase(GEVEL_PROGRESS_PHASE_INDEX, heapNumBlocks);
+
+	for (heapBlk = 0; heapBlk < heapNumBlocks; heapBlk += *pagesPerRange)
+	{
+		BrinTuple	*tup;
+		OffsetNumber off;
+		bool		summarized = false;
+
+		CHECK_FOR_INTERRUPTS();
+
+		tup = brinGetTupleForHeapBlock(revmap, heapBlk, &buf, &off, NULL,
+									   BUFFER_LOCK_SHARE, NULL);
+		if (tup)
+		{
+			if (!BrinTupleIsPlaceholder(tup))
+			{
+				dtup = brin_deform_tuple(bdesc, tup, dtup);
+				summarized = true;
+			}
+			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+		}
+
+		callback(bdesc, heapBlk, summarized ? dtup : NULL, arg);
+		gevel_progress_update(Min(*pagesPerRange, heapNumBlocks - heapBlk), -1,
+							  summarized ? 1 : 0);
+	}
+
+	if (BufferIsValid(buf))
+		ReleaseBuffer(buf);
+	brinRevmapTerminate(revmap);
+
+	return heapNumBlocks;
+}
+
+/*
+ * Is the column summarized by a minmax opclass?
+ */
+static bool
+brin_is_minmax(Relation index, int attno)
+{
+	return index_getprocid(index, attno, BRIN_PROCNUM_OPCINFO) ==
+				F_BRIN_MINMAX_OPCINFO;
+}
+
+#define BRIN_OVERLAP_TOP	10
+
+typedef struct BrinRangeBounds
+{
+	BlockNumber	heapBlk;
+	Datum		min;
+	Datum		max;
+	int64		noverlap;
+} BrinRangeBounds;
+
+typedef struct BrinOverlapColumn
+{
+	bool			 minmax;
+	FmgrInfo		*cmp;
+	Oid				 collation;
+	TypeCacheEntry	*type;
+	BrinRangeBounds	*ranges;
+	int				 nranges;
+	int				 maxranges;
+	int				 nallnulls;
+} BrinOverlapColumn;
+
+typedef struct BrinOverlapState
+{
+	MemoryContext		 context;
+	int					 nranges;
+	int					 nunsummarized;
+	BrinOverlapColumn	*columns;
+} BrinOverlapState;
+
+static int
+brin_datum_cmp(const void *a, const void *b, void *arg)
+{
+	BrinOverlapColumn *col = (BrinOverlapColumn *) arg;
+
+	return DatumGetInt32(FunctionCall2Coll(col->cmp, col->collation,
+										   *(const Datum *) a,
+										   *(const Datum *) b));
+}
+
+static int
+brin_overlap_cmp(const void *a, const void *b)
+{
+	const BrinRangeBounds *ra = (const BrinRangeBounds *) a;
+	const BrinRangeBounds *rb = (const BrinRangeBounds *) b;
+
+	/* most overlaps first, in heap order among equals */
+	if (ra->noverlap != rb->noverlap)
+		return (ra->noverlap > rb->noverlap) ? -1 : 1;
+	if (ra->heapBlk != rb->heapBlk)
+		return (ra->heapBlk < rb->heapBlk) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Number of elements of the sorted array strictly less than (or, with
+ * orEqual, less or equal to) the value
+ */
+static int
+brin_sorted_count(Datum *sorted, int n, Datum value, bool orEqual,
+				  BrinOverlapColumn *col)
+{
+	int		lo = 0,
+			hi = n;
+
+	while (lo < hi)
+	{
+		int		mid = lo + (hi - lo) / 2;
+		int		cmp = brin_datum_cmp(&sorted[mid], &value, col);
+
+		if (cmp < 0 || (orEqual && cmp == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void
+brin_overlap_collect(BrinDesc *bdesc, BlockNumber heapBlk,
+					 BrinMemTuple *dtup, void *arg)
+{
+	BrinOverlapState   *state = (BrinOverlapState *) arg;
+	MemoryContext		oldcontext;
+	int					i;
+
+	state->nranges++;
+	if (dtup == NULL)
+	{
+		state->nunsummarized++;
+		return;
+	}
+
+	oldcontext = MemoryContextSwitchTo(state->context);
+
+	for (i = 0; i < bdesc->bd_tupdesc->natts; i++)
+	{
+		BrinOverlapColumn  *col = &state->columns[i];
+		BrinValues		   *bval = &dtup->bt_columns[i];
+		BrinRangeBounds	   *r;
+
+		if (!col->minmax)
+			continue;
+
+		if (bval->bv_allnulls)
+		{
+			col->nallnulls++;
+			continue;
+		}
+
+		if (col->nranges >= col->maxranges)
+		{
+			col->maxranges *= 2;
+			col->ranges = (BrinRangeBounds *) repalloc(col->ranges,
+									sizeof(BrinRangeBounds) * col->maxranges);
+		}
+
+		r = &col->ranges[col->nranges++];
+		r->heapBlk = heapBlk;
+		r->min = datumCopy(bval->bv_values[0], col->type->typbyval,
+						   col->type->typlen);
+		r->max = datumCopy(bval->bv_values[1], col->type->typbyval,
+						   col->type->typlen);
+		r->noverlap = 0;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+static void
+brin_overlap_report(StringInfo out, BrinOverlapColumn *col,
+					BlockNumber pagesPerRange)
+{
+	int		n = col->nranges;
+	Datum  *mins,
+		   *maxs;
+	int64	hist[64];
+	int		nbuckets = 0;
+	int64	nall = 0;
+	double	sumOverlap = 0.0,
+			sumMatch = 0.0;
+	Oid		outfunc;
+	bool	isvarlena;
+	int		i;
+
+	appendStringInfo(out, "Number of minmax ranges:       %d\n", n);
+	appendStringInfo(out, "Number of all-null ranges:     %d\n", col->nallnulls);
+
+	if (n == 0)
+		return;
+
+	mins = (Datum *) palloc(sizeof(Datum) * n);
+	maxs = (Datum *) palloc(sizeof(Datum) * n);
+	for (i = 0; i < n; i++)
+	{
+		mins[i] = col->ranges[i].min;
+		maxs[i] = col->ranges[i].max;
+	}
+	qsort_arg(mins, n, sizeof(Datum), brin_datum_cmp, col);
+	qsort_arg(maxs, n, sizeof(Datum), brin_datum_cmp, col);
+
+	memset(hist, 0, sizeof(hist));
+	for (i = 0; i < n; i++)
+	{
+		BrinRangeBounds *r = &col->ranges[i];
+		int		bucket = 0;
+		int64	c;
+
+		/*
+		 * Every range not entirely below or entirely above this one
+		 * overlaps it, the range itself excluded
+		 */
+		c = n - brin_sorted_count(maxs, n, r->min, false, col)
+			  - (n - brin_sorted_count(mins, n, r->max, true, col)) - 1;
+		r->noverlap = c;
+		sumOverlap += c;
+		if (c == n - 1 && n > 1)
+			nall++;
+
+		while (c > 0)
+		{
+			bucket++;
+			c >>= 1;
+		}
+		hist[bucket]++;
+		if (bucket + 1 > nbuckets)
+			nbuckets = bucket + 1;
+
+		/*
+		 * Use the bounds of every range as sample points of a point
+		 * query: it matches every range with min <= point <= max
+		 */
+		sumMatch += brin_sorted_count(mins, n, r->min, true, col) -
+					brin_sorted_count(maxs, n, r->min, false, col);
+		sumMatch += brin_sorted_count(mins, n, r->max, true, col) -
+					brin_sorted_count(maxs, n, r->max, false, col);
+	}
+
+	sumMatch /= 2.0 * n;
+
+	appendStringInfo(out, "Average overlapping ranges:    %.2f\n", sumOverlap / n);
+	appendStringInfo(out, "Ranges overlapping all others: " INT64_FORMAT "\n", nall);
+	appendStringInfo(out, "Ranges per point query:        %.2f (%.2f%%)\n",
+					 sumMatch, 100.0 * sumMatch / n);
+	appendStringInfo(out, "Heap pages per point query:    %.2f\n",
+					 sumMatch * pagesPerRange);
+
+	appendStringInfoString(out, "Overlap histogram:\n");
+	for (i = 0; i < nbuckets; i++)
+	{
+		if (i < 2)
+			appendStringInfo(out, "    %d", i);
+		else
+			appendStringInfo(out, "    " INT64_FORMAT "-" INT64_FORMAT,
+							 ((int64) 1) << (i - 1), (((int64) 1) << i) - 1);
+		appendStringInfo(out, ": " INT64_FORMAT " (%.2f%%)\n",
+						 hist[i], 100.0 * hist[i] / n);
+	}
+
+	getTypeOutputInfo(col->type->type_id, &outfunc, &isvarlena);
+	qsort(col->ranges, n, sizeof(BrinRangeBounds), brin_overlap_cmp);
+
+	appendStringInfoString(out, "Most-overlapping ranges:\n");
+	for (i = 0; i < n && i < BRIN_OVERLAP_TOP; i++)
+	{
+		BrinRangeBounds *r = &col->ranges[i];
+
+		appendStringInfo(out, "    blk: %u overlaps: " INT64_FORMAT " min: %s max: %s\n",
+						 r->heapBlk, r->noverlap,
+						 OidOutputFunctionCall(outfunc, r->min),
+						 OidOutputFunctionCall(outfunc, r->max));
+	}
+
+	pfree(mins);
+	pfree(maxs);
+}
+
+/*
+ * Overlap analysis of minmax summaries
+ * The more ranges overlap, the more ranges a bitmap scan has to read
+ * for a single value.
+ * SELECT brin_overlap_stat(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(brin_overlap_stat);
+Datum brin_overlap_stat(PG_FUNCTION_ARGS);
+Datum
+brin_overlap_stat(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	RangeVar	*relvar;
+	Relation	index;
+	List		*relname_list;
+	BrinDesc	*bdesc;
+	BlockNumber pagesPerRange;
+	BlockNumber heapNumBlocks;
+	BrinOverlapState state;
+	StringInfoData out;
+	int			i;
+
+	relname_list = textToQualifiedNameList(name);
+	relvar = makeRangeVarFromNameList(relname_list);
+	index = brin_index_open(relvar);
+
+	bdesc = brin_build_desc(index);
+
+	memset(&state, 0, sizeof(state));
+	state.context = CurrentMemoryContext;
+	state.columns = (BrinOverlapColumn *)
+		palloc0(sizeof(BrinOverlapColumn) * bdesc->bd_tupdesc->natts);
+
+	for (i = 0; i < bdesc->bd_tupdesc->natts; i++)
+	{
+		BrinOverlapColumn *col = &state.columns[i];
+		TypeCacheEntry	  *type;
+
+		if (!brin_is_minmax(index, i + 1))
+			continue;
+
+		type = lookup_type_cache(bdesc->bd_info[i]->oi_typcache[0]->type_id,
+								 TYPECACHE_CMP_PROC_FINFO);
+		if (!OidIsValid(type->cmp_proc_finfo.fn_oid))
+			continue;
+
+		col->minmax = true;
+		col->type = type;
+		col->cmp = &type->cmp_proc_finfo;
+		col->collation = index->rd_indcollation[i];
+		col->maxranges = 64;
+		col->ranges = (BrinRangeBounds *) palloc(sizeof(BrinRangeBounds) * col->maxranges);
+	}
+
+	gevel_progress_start(GEVEL_PROGRESS_BRIN_OVERLAP_STAT, index);
+	heapNumBlocks = brin_scan_summaries(index, bdesc, &pagesPerRange,
+										brin_overlap_collect, &state);
+	gevel_progress_end();
+
+	initStringInfo(&out);
+	appendStringInfo(&out, "Number of heap pages:          %u\n", heapNumBlocks);
+	appendStringInfo(&out, "Pages per range:               %u\n", pagesPerRange);
+	appendStringInfo(&out, "Number of ranges:              %d\n", state.nranges);
+	appendStringInfo(&out, "Number of unsummarized ranges: %d\n", state.nunsummarized);
+
+	for (i = 0; i < bdesc->bd_tupdesc->natts; i++)
+	{
+		appendStringInfo(&out, "Column %d (%s):\n", i + 1,
+						 NameStr(TupleDescAttr(RelationGetDescr(index), i)->attname));
+		if (state.columns[i].minmax)
+			brin_overlap_report(&out, &state.columns[i], pagesPerRange);
+		else
+			appendStringInfoString(&out, "Not a minmax column\n");
+	}
+
+	brin_free_desc(bdesc);
+	brin_index_close(index);
+
+	PG_RETURN_TEXT_P(cstring_to_text(out.data));
+}
+
+typedef struct BrinEstimateState
+{
+	FmgrInfo	   *consistentFn;
+	ScanKeyData		key;
+	int64			nmatched;
+	int64			nunsummarized;
+	BlockNumber		lastBlk;
+	bool			lastMatched;
+} BrinEstimateState;
+
+static void
+brin_estimate_collect(BrinDesc *bdesc, BlockNumber heapBlk,
+					  BrinMemTuple *dtup, void *arg)
+{
+	BrinEstimateState  *state = (BrinEstimateState *) arg;
+	bool				matched;
+
+	if (dtup == NULL)
+	{
+		/* bitmap scan returns every page of an unsummarized range */
+		state->nunsummarized++;
+		matched = true;
+	}
+	else
+	{
+		BrinValues *bval = &dtup->bt_columns[state->key.sk_attno - 1];
+
+		if (bval->bv_allnulls)
+			matched = false;	/* function is strict, value is not null */
+#if PG_VERSION_NUM >= 140000
+		else if (state->consistentFn->fn_nargs >= 4)
+		{
+			ScanKey		keys[1];
+
+			keys[0] = &state->key;
+			matched = DatumGetBool(FunctionCall4Coll(state->consistentFn,
+											state->key.sk_collation,
+											PointerGetDatum(bdesc),
+											PointerGetDatum(bval),
+											PointerGetDatum(keys),
+											Int32GetDatum(1)));
+		}
+#endif
+		else
+			matched = DatumGetBool(FunctionCall3Coll(state->consistentFn,
+											state->key.sk_collation,
+											PointerGetDatum(bdesc),
+											PointerGetDatum(bval),
+											PointerGetDatum(&state->key)));
+	}
+
+	if (matched)
+		state->nmatched++;
+	state->lastBlk = heapBlk;
+	state->lastMatched = matched;
+}
+
+/*
+ * Estimate how many ranges and heap pages a bitmap scan with
+ * 'column OP value' reads. Only the summaries are looked at,
+ * heap is not touched. The column is the one whose opfamily has the
+ * operator, or the named one when several have it.
+ * SELECT * FROM brin_query_estimate(INDEXNAME, '<(int4,int4)', 100 [, COLUMN]);
+ */
+PG_FUNCTION_INFO_V1(brin_query_estimate);
+Datum brin_query_estimate(PG_FUNCTION_ARGS);
+Datum
+brin_query_estimate(PG_FUNCTION_ARGS)
+{
+	text		*name;
+	Oid			opno;
+	Datum		value;
+	Oid			valtype = get_fn_expr_argtype(fcinfo->flinfo, 2);
+	RangeVar	*relvar;
+	Relation	index;
+	List		*relname_list;
+	BrinDesc	*bdesc;
+	BlockNumber pagesPerRange;
+	BlockNumber heapNumBlocks;
+	BrinEstimateState state;
+	Oid			lefttype,
+				righttype;
+	int			strategy = 0;
+	int			i = 0;
+	int64		npages;
+	TupleDesc	tupdesc;
+	Datum		values[2];
+	bool		nulls[2] = {false, false};
+
+	/* not strict because of the column default */
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1) || PG_ARGISNULL(2))
+		PG_RETURN_NULL();
+	name = PG_GETARG_TEXT_PP(0);
+	opno = PG_GETARG_OID(1);
+	value = PG_GETARG_DATUM(2);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	relname_list = textToQualifiedNameList(name);
+	relvar = makeRangeVarFromNameList(relname_list);
+	index = brin_scan_open(relvar);
+
+	op_input_types(opno, &lefttype, &righttype);
+	if (!IsBinaryCoercible(valtype, righttype))
+		elog(ERROR, "value of type %s does not match operator %s",
+			 format_type_be(valtype), format_operator(opno));
+
+	if (PG_NARGS() > 3 && !PG_ARGISNULL(3))
+	{
+		char	   *attname = text_to_cstring(PG_GETARG_TEXT_PP(3));
+		AttrNumber	attno = get_attnum(RelationGetRelid(index), attname);
+
+		if (attno == InvalidAttrNumber)
+			elog(ERROR, "column \"%s\" is not in index %s.%s", attname,
+				 get_namespace_name(RelationGetNamespace(index)),
+				 RelationGetRelationName(index));
+		i = attno - 1;
+		strategy = get_op_opfamily_strategy(opno, index->rd_opfamily[i]);
+	}
+	else
+	{
+		int		attno;
+
+		for (attno = 0; attno < RelationGetNumberOfAttributes(index); attno++)
+		{
+			int		s = get_op_opfamily_strategy(opno, index->rd_opfamily[attno]);
+
+			if (s == 0)
+				continue;
+			if (strategy != 0)
+				elog(ERROR, "operator %s is supported by several columns of index %s.%s, name the column",
+					 format_operator(opno),
+					 get_namespace_name(RelationGetNamespace(index)),
+					 RelationGetRelationName(index));
+			strategy = s;
+			i = attno;
+		}
+	}
+
+	if (strategy == 0)
+		elog(ERROR, "operator %s is not supported by index %s.%s",
+			 format_operator(opno),
+			 get_namespace_name(RelationGetNamespace(index)),
+			 RelationGetRelationName(index));
+
+	memset(&state, 0, sizeof(state));
+	ScanKeyEntryInitialize(&state.key, 0, i + 1, strategy, righttype,
+						   index->rd_indcollation[i], get_opcode(opno), value);
+	state.consistentFn = index_getprocinfo(index, i + 1, BRIN_PROCNUM_CONSISTENT);
+
+	bdesc = brin_build_desc(index);
+	gevel_progress_start(GEVEL_PROGRESS_BRIN_QUERY_ESTIMATE, index);
+	heapNumBlocks = brin_scan_summaries(index, bdesc, &pagesPerRange,
+										brin_estimate_collect, &state);
+	gevel_progress_end();
+	brin_free_desc(bdesc);
+	brin_scan_close(index);
+
+	/* the last range may be shorter than pagesPerRange */
+	npages = state.nmatched * pagesPerRange;
+	if (state.lastMatched && heapNumBlocks - state.lastBlk < pagesPerRange)
+		npages -= pagesPerRange - (heapNumBlocks - state.lastBlk);
+
+	values[0] = Int64GetDatum(state.nmatched);
+	values[1] = Int64GetDatum(npages);
+
+	tupdesc = BlessTupleDesc(tupdesc);
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+#if PG_VERSION_NUM >= 140000
+/*
+ * On-disk summaries of bloom and minmax-multi opclasses. The structs are
+ * private to brin_bloom.c and brin_minmax_multi.c, keep them in sync.
+ */
+typedef struct GevelBloomFilter
+{
+	int32		vl_len_;
+	uint16		flags;
+	uint8		nhashes;
+	uint32		nbits;
+	uint32		nbits_set;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} GevelBloomFilter;
+
+typedef struct GevelSerializedRanges
+{
+	int32		vl_len_;
+	Oid			typid;
+	int			nranges;
+	int			nvalues;
+	int			maxvalues;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} GevelSerializedRanges;
+
+typedef enum
+{
+	BRIN_SUMMARY_OTHER,
+	BRIN_SUMMARY_BLOOM,
+	BRIN_SUMMARY_MULTI
+} BrinSummaryKind;
+
+typedef struct BrinSummaryInfo
+{
+	uint32		nhashes;
+	uint32		nbits;
+	uint32		nbits_set;
+	double		fpr;			/* estimated false positive rate */
+	double		ndistinct;		/* estimated distinct values in range */
+	int			nranges;		/* intervals */
+	int			nvalues;		/* points */
+	int			maxvalues;
+} BrinSummaryInfo;
+
+static BrinSummaryKind
+brin_summary_kind(Relation index, int attno)
+{
+	RegProcedure opcinfo = index_getprocid(index, attno, BRIN_PROCNUM_OPCINFO);
+
+	if (opcinfo == F_BRIN_BLOOM_OPCINFO)
+		return BRIN_SUMMARY_BLOOM;
+	if (opcinfo == F_BRIN_MINMAX_MULTI_OPCINFO)
+		return BRIN_SUMMARY_MULTI;
+	return BRIN_SUMMARY_OTHER;
+}
+
+static void
+brin_summary_decode(BrinSummaryKind kind, Datum value, BrinSummaryInfo *info)
+{
+	memset(info, 0, sizeof(*info));
+	if (kind == BRIN_SUMMARY_BLOOM)
+	{
+		GevelBloomFilter *filter = (GevelBloomFilter *) PG_DETOAST_DATUM(value);
+		double		fill;
+
+		info->nhashes = filter->nhashes;
+		info->nbits = filter->nbits;
+		info->nbits_set = filter->nbits_set;
+
+		fill = (filter->nbits > 0) ? ((double) filter->nbits_set) / filter->nbits : 0.0;
+		info->fpr = pow(fill, filter->nhashes);
+		/* invert the expected number of bits set for n distinct values */
+		if (fill < 1.0 && filter->nhashes > 0)
+			info->ndistinct = -((double) filter->nbits / filter->nhashes) * log(1.0 - fill);
+		else
+			info->ndistinct = get_float8_infinity();
+
+		if ((Pointer) filter != DatumGetPointer(value))
+			pfree(filter);
+	}
+	else if (kind == BRIN_SUMMARY_MULTI)
+	{
+		GevelSerializedRanges *ranges = (GevelSerializedRanges *) PG_DETOAST_DATUM(value);
+
+		info->nranges = ranges->nranges;
+		info->nvalues = ranges->nvalues;
+		info->maxvalues = ranges->maxvalues;
+
+		if ((Pointer) ranges != DatumGetPointer(value))
+			pfree(ranges);
+	}
+}
+
+typedef struct BrinSummaryColumn
+{
+	BrinSummaryKind	kind;
+	int64		nsummaries;
+	int64		nallnulls;
+	int64		nfull;
+	uint32		nhashes;
+	uint32		nbits;
+	double		sumFill;
+	double		maxFill;
+	double		sumFpr;
+	double		maxFpr;
+	double		sumDistinct;
+	double		maxDistinct;
+	int64		sumRanges;
+	int			maxRanges;
+	int64		sumValues;
+	int			maxValues;
+	int			maxvalues;
+} BrinSummaryColumn;
+
+typedef struct BrinSummaryState
+{
+	Relation			index;
+	BrinSummaryColumn  *columns;
+	int64				nranges;
+	int64				nunsummarized;
+	/* brin_summary_print */
+	Tuplestorestate	   *tupstore;
+	TupleDesc			tupdesc;
+} BrinSummaryState;
+
+static void
+brin_summary_collect(BrinDesc *bdesc, BlockNumber heapBlk,
+					 BrinMemTuple *dtup, void *arg)
+{
+	BrinSummaryState   *state = (BrinSummaryState *) arg;
+	int					i;
+
+	state->nranges++;
+	if (dtup == NULL)
+	{
+		state->nunsummarized++;
+		return;
+	}
+
+	for (i = 0; i < bdesc->bd_tupdesc->natts; i++)
+	{
+		BrinSummaryColumn  *col = &state->columns[i];
+		BrinValues		   *bval = &dtup->bt_columns[i];
+		BrinSummaryInfo		info;
+
+		if (col->kind == BRIN_SUMMARY_OTHER)
+			continue;
+
+		if (bval->bv_allnulls)
+		{
+			col->nallnulls++;
+			continue;
+		}
+
+		brin_summary_decode(col->kind, bval->bv_values[0], &info);
+		col->nsummaries++;
+
+		if (col->kind == BRIN_SUMMARY_BLOOM)
+		{
+			double	fill = (info.nbits > 0) ? ((double) info.nbits_set) / info.nbits : 0.0;
+
+			col->nhashes = info.nhashes;
+			col->nbits = info.nbits;
+			col->sumFill += fill;
+			col->maxFill = Max(col->maxFill, fill);
+			col->sumFpr += info.fpr;
+			col->maxFpr = Max(col->maxFpr, info.fpr);
+			col->sumDistinct += info.ndistinct;
+			col->maxDistinct = Max(col->maxDistinct, info.ndistinct);
+		}
+		else
+		{
+			double	fill = (info.maxvalues > 0) ?
+				((double) (2 * info.nranges + info.nvalues)) / info.maxvalues : 0.0;
+
+			col->maxvalues = info.maxvalues;
+			col->sumFill += fill;
+			col->maxFill = Max(col->maxFill, fill);
+			col->sumRanges += info.nranges;
+			col->maxRanges = Max(col->maxRanges, info.nranges);
+			col->sumValues += info.nvalues;
+			col->maxValues = Max(col->maxValues, info.nvalues);
+			if (2 * info.nranges + info.nvalues >= info.maxvalues)
+				col->nfull++;
+		}
+
+		if (state->tupstore)
+		{
+			Datum	values[11];
+			bool	nulls[11];
+
+			memset(nulls, 0, sizeof(nulls));
+			values[0] = Int64GetDatum((int64) heapBlk);
+			values[1] = Int32GetDatum(i + 1);
+			values[2] = CStringGetTextDatum(
+							(col->kind == BRIN_SUMMARY_BLOOM) ? "bloom" : "minmax_multi");
+			if (col->kind == BRIN_SUMMARY_BLOOM)
+			{
+				values[3] = Int32GetDatum((int32) info.nhashes);
+				values[4] = Int64GetDatum((int64) info.nbits);
+				values[5] = Int64GetDatum((int64) info.nbits_set);
+				values[6] = Float8GetDatum(info.fpr);
+				values[7] = Float8GetDatum(info.ndistinct);
+				nulls[8] = nulls[9] = nulls[10] = true;
+			}
+			else
+			{
+				nulls[3] = nulls[4] = nulls[5] = nulls[6] = nulls[7] = true;
+				values[8] = Int32GetDatum(info.nranges);
+				values[9] = Int32GetDatum(info.nvalues);
+				values[10] = Int32GetDatum(info.maxvalues);
+			}
+			tuplestore_putvalues(state->tupstore, state->tupdesc, values, nulls);
+		}
+	}
+}
+
+static BrinDesc *
+brin_summary_init(Relation index, BrinSummaryState *state)
+{
+	BrinDesc   *bdesc = brin_build_desc(index);
+	int			i;
+
+	memset(state, 0, sizeof(*state));
+	state->index = index;
+	state->columns = (BrinSummaryColumn *)
+		palloc0(sizeof(BrinSummaryColumn) * bdesc->bd_tupdesc->natts);
+	for (i = 0; i < bdesc->bd_tupdesc->natts; i++)
+		state->columns[i].kind = brin_summary_kind(index, i + 1);
+
+	return bdesc;
+}
+#endif
+
+/*
+ * Aggregated statistic about bloom and minmax-multi summaries:
+ * filter saturation and false positive rate for bloom,
+ * intervals and points per range for minmax-multi
+ * SELECT brin_summary_stat(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(brin_summary_stat);
+Datum brin_summary_stat(PG_FUNCTION_ARGS);
+Datum
+brin_summary_stat(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM < 140000
+	elog(NOTICE, "Function is not working under PgSQL < 14");
+
+	PG_RETURN_TEXT_P(CStringGetTextDatum("???"));
+#else
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	BrinDesc	*bdesc;
+	BlockNumber pagesPerRange;
+	BrinSummaryState state;
+	StringInfoData out;
+	int			i;
+
+	index = brin_index_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	bdesc = brin_summary_init(index, &state);
+	gevel_progress_start(GEVEL_PROGRESS_BRIN_SUMMARY_STAT, index);
+	brin_scan_summaries(index, bdesc, &pagesPerRange, brin_summary_collect, &state);
+	gevel_progress_end();
+
+	initStringInfo(&out);
+	appendStringInfo(&out, "Pages per range:               %u\n", pagesPerRange);
+	appendStringInfo(&out, "Number of ranges:              " INT64_FORMAT "\n", state.nranges);
+	appendStringInfo(&out, "Number of unsummarized ranges: " INT64_FORMAT "\n", state.nunsummarized);
+
+	for (i = 0; i < bdesc->bd_tupdesc->natts; i++)
+	{
+		BrinSummaryColumn *col = &state.columns[i];
+		double	n = (col->nsummaries > 0) ? (double) col->nsummaries : 1.0;
+
+		appendStringInfo(&out, "Column %d (%s):\n", i + 1,
+						 NameStr(TupleDescAttr(RelationGetDescr(index), i)->attname));
+
+		switch (col->kind)
+		{
+			case BRIN_SUMMARY_BLOOM:
+				appendStringInfo(&out,
+					"Opclass:                       bloom\n"
+					"Number of summaries:           " INT64_FORMAT "\n"
+					"Number of all-null ranges:     " INT64_FORMAT "\n"
+					"Number of hash functions:      %u\n"
+					"Filter size:                   %u bits\n"
+					"Average bits set:              %.2f%%\n"
+					"Maximum bits set:              %.2f%%\n"
+					"Average false positive rate:   %.6f\n"
+					"Maximum false positive rate:   %.6f\n"
+					"Average distinct per range:    %.1f\n"
+					"Maximum distinct per range:    %.1f\n",
+					col->nsummaries, col->nallnulls,
+					col->nhashes, col->nbits,
+					100.0 * col->sumFill / n, 100.0 * col->maxFill,
+					col->sumFpr / n, col->maxFpr,
+					col->sumDistinct / n, col->maxDistinct);
+				break;
+			case BRIN_SUMMARY_MULTI:
+				appendStringInfo(&out,
+					"Opclass:                       minmax_multi\n"
+					"Number of summaries:           " INT64_FORMAT "\n"
+					"Number of all-null ranges:     " INT64_FORMAT "\n"
+					"Values per range:              %d\n"
+					"Average intervals per range:   %.2f\n"
+					"Maximum intervals per range:   %d\n"
+					"Average points per range:      %.2f\n"
+					"Maximum points per range:      %d\n"
+					"Average fill:                  %.2f%%\n"
+					"Full summaries:                " INT64_FORMAT "\n",
+					col->nsummaries, col->nallnulls,
+					col->maxvalues,
+					col->sumRanges / n, col->maxRanges,
+					col->sumValues / n, col->maxValues,
+					100.0 * col->sumFill / n,
+					col->nfull);
+				break;
+			default:
+				appendStringInfoString(&out, "Not a bloom or minmax_multi column\n");
+				break;
+		}
+	}
+
+	brin_free_desc(bdesc);
+	brin_index_close(index);
+
+	PG_RETURN_TEXT_P(cstring_to_text(out.data));
+#endif
+}
+
+/*
+ * Per-range bloom and minmax-multi summaries
+ * SELECT * FROM brin_summary_print(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(brin_summary_print);
+Datum brin_summary_print(PG_FUNCTION_ARGS);
+Datum
+brin_summary_print(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM < 140000
+	TupleDesc	tupdesc;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	/* an empty result */
+	materializeSetup(fcinfo, tupdesc);
+	elog(NOTICE, "Function is not working under PgSQL < 14");
+#else
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	BrinDesc	*bdesc;
+	BlockNumber pagesPerRange;
+	BrinSummaryState state;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = materializeSetup(fcinfo, tupdesc);
+
+	index = brin_index_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	bdesc = brin_summary_init(index, &state);
+	state.tupdesc = tupdesc;
+	state.tupstore = tupstore;
+	gevel_progress_start(GEVEL_PROGRESS_BRIN_SUMMARY_PRINT, index);
+	brin_scan_summaries(index, bdesc, &pagesPerRange, brin_summary_collect, &state);
+	gevel_progress_end();
+
+	brin_free_desc(bdesc);
+	brin_index_close(index);
+#endif
+
+	return (Datum) 0;
+}
+
+#define PPR_MAX_PAGES_PER_RANGE	131072
+#define PPR_SAMPLE_SIZE		10000
+#define PPR_QUERY_POINTS	100
+
+typedef struct PprCandidate
+{
+	BlockNumber		ppr;
+	BlockNumber		curRange;
+	bool			curValid;
+	Datum			curMin;
+	Datum			curMax;
+	Datum		   *mins;
+	Datum		   *maxs;
+	int				nranges;		/* ranges with non-null values */
+	int				maxranges;
+	uint64			datasize;		/* bytes of stored bounds */
+} PprCandidate;
+
+typedef struct PprState
+{
+	MemoryContext	context;
+	BrinOverlapColumn col;			/* comparison support */
+	int16			typlen;
+	bool			typbyval;
+	char			typalign;
+	PprCandidate   *cand;
+	int				ncand;
+	/* systematic sample of values for query windows */
+	Datum		   *sample;
+	int				nsample;
+	int64			stride;
+	int64			nseen;
+	int64			nnulls;
+} PprState;
+
+static Datum
+ppr_copy(PprState *state, Datum value)
+{
+	return datumCopy(value, state->typbyval, state->typlen);
+}
+
+static void
+ppr_finish_range(PprState *state, PprCandidate *c)
+{
+	if (!c->curValid)
+		return;
+
+	if (c->nranges >= c->maxranges)
+	{
+		c->maxranges *= 2;
+		c->mins = (Datum *) repalloc(c->mins, sizeof(Datum) * c->maxranges);
+		c->maxs = (Datum *) repalloc(c->maxs, sizeof(Datum) * c->maxranges);
+	}
+	c->mins[c->nranges] = c->curMin;
+	c->maxs[c->nranges] = c->curMax;
+	c->nranges++;
+	c->datasize += att_align_nominal(datumGetSize(c->curMin, state->typbyval, state->typlen),
+									 state->typalign) +
+				   att_align_nominal(datumGetSize(c->curMax, state->typbyval, state->typlen),
+									 state->typalign);
+	c->curValid = false;
+}
+
+static void
+ppr_add_value(PprState *state, BlockNumber blk, Datum value)
+{
+	int		i;
+
+	for (i = 0; i < state->ncand; i++)
+	{
+		PprCandidate   *c = &state->cand[i];
+		BlockNumber		range = blk / c->ppr;
+
+		if (range != c->curRange)
+		{
+			ppr_finish_range(state, c);
+			c->curRange = range;
+		}
+
+		if (!c->curValid)
+		{
+			c->curMin = ppr_copy(state, value);
+			c->curMax = ppr_copy(state, value);
+			c->curValid = true;
+		}
+		else if (brin_datum_cmp(&value, &c->curMin, &state->col) < 0)
+		{
+			if (!state->typbyval)
+				pfree(DatumGetPointer(c->curMin));
+			c->curMin = ppr_copy(state, value);
+		}
+		else if (brin_datum_cmp(&value, &c->curMax, &state->col) > 0)
+		{
+			if (!state->typbyval)
+				pfree(DatumGetPointer(c->curMax));
+			c->curMax = ppr_copy(state, value);
+		}
+	}
+
+	/* keep every stride-th value, halve the sample when it is full */
+	if (state->nseen++ % state->stride == 0)
+	{
+		if (state->nsample >= PPR_SAMPLE_SIZE)
+		{
+			int		j;
+
+			for (j = 0; j < PPR_SAMPLE_SIZE / 2; j++)
+			{
+				if (!state->typbyval)
+					pfree(DatumGetPointer(state->sample[2 * j + 1]));
+				state->sample[j] = state->sample[2 * j];
+			}
+			state->nsample = PPR_SAMPLE_SIZE / 2;
+			state->stride *= 2;
+		}
+		state->sample[state->nsample++] = ppr_copy(state, value);
+	}
+}
+
+/*
+ * Average number of ranges overlapping [sample[p], sample[p + width - 1]]
+ * over evenly spread positions p
+ */
+static double
+ppr_ranges_scanned(PprState *state, PprCandidate *c, Datum *mins, Datum *maxs,
+				   int width)
+{
+	int		npos = state->nsample - width + 1;
+	int		step = Max(1, npos / PPR_QUERY_POINTS);
+	int		p,
+			nq = 0;
+	double	sum = 0.0;
+
+	for (p = 0; p < npos; p += step)
+	{
+		Datum	lo = state->sample[p],
+				hi = state->sample[p + width - 1];
+
+		sum += brin_sorted_count(mins, c->nranges, hi, true, &state->col) -
+			   brin_sorted_count(maxs, c->nranges, lo, false, &state->col);
+		nq++;
+	}
+
+	return (nq > 0) ? sum / nq : 0.0;
+}
+
+static void
+ppr_report(StringInfo out, PprState *state, PprCandidate *c, BlockNumber nblocks)
+{
+	static const double selectivity[] = {0.0, 0.001, 0.01, 0.1};
+	uint64		totalRanges = (nblocks + c->ppr - 1) / c->ppr;
+	Size		usable = BLCKSZ - SizeOfPageHeaderData - MAXALIGN(sizeof(BrinSpecialSpace));
+	Size		tupsize;
+	uint64		npages;
+	int			i;
+
+	/* all-null ranges keep a tuple without values */
+	tupsize = MAXALIGN(MAXALIGN(SizeOfBrinTuple) +
+					   ((c->nranges > 0) ? c->datasize / c->nranges : 0));
+	npages = 1 /* meta */ +
+			 (totalRanges + REVMAP_PAGE_MAXITEMS - 1) / REVMAP_PAGE_MAXITEMS +
+			 (totalRanges * (tupsize + sizeof(ItemIdData)) + usable - 1) / usable;
+
+	appendStringInfo(out, "pages_per_range: %u\n", c->ppr);
+	appendStringInfo(out, "    Ranges:                  " UINT64_FORMAT "\n", totalRanges);
+	appendStringInfo(out, "    Ranges with values:      %d\n", c->nranges);
+	appendStringInfo(out, "    Estimated index size:    " UINT64_FORMAT " pages (" UINT64_FORMAT " bytes)\n",
+					 npages, npages * BLCKSZ);
+
+	if (c->nranges == 0 || state->nsample == 0)
+		return;
+
+	qsort_arg(c->mins, c->nranges, sizeof(Datum), brin_datum_cmp, &state->col);
+	qsort_arg(c->maxs, c->nranges, sizeof(Datum), brin_datum_cmp, &state->col);
+
+	for (i = 0; i < lengthof(selectivity); i++)
+	{
+		int		width = Max(1, (int) (selectivity[i] * state->nsample));
+		double	nranges = ppr_ranges_scanned(state, c, c->mins, c->maxs, width);
+		double	npagesScanned = Min(nranges * c->ppr, (double) nblocks);
+
+		if (selectivity[i] == 0.0)
+			appendStringInfoString(out, "    Pages scanned, point:    ");
+		else
+			appendStringInfo(out, "    Pages scanned, %4.1f%%:    ", 100.0 * selectivity[i]);
+		appendStringInfo(out, "%.1f (%.2f%% of heap)\n", npagesScanned,
+						 (nblocks > 0) ? 100.0 * npagesScanned / nblocks : 0.0);
+	}
+}
+
+static int
+ppr_candidate_cmp(const void *a, const void *b)
+{
+	BlockNumber	pa = ((const PprCandidate *) a)->ppr;
+	BlockNumber	pb = ((const PprCandidate *) b)->ppr;
+
+	return (pa < pb) ? -1 : ((pa > pb) ? 1 : 0);
+}
+
+/*
+ * Simulate minmax BRIN indexes with several pages_per_range values in
+ * one pass over the heap and estimate index size and pages scanned
+ * for queries of a given selectivity.
+ * SELECT brin_ppr_advisor(TABLENAME, COLUMNNAME, '{16,32,128}');
+ */
+PG_FUNCTION_INFO_V1(brin_ppr_advisor);
+Datum brin_ppr_advisor(PG_FUNCTION_ARGS);
+Datum
+brin_ppr_advisor(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	char		*colname = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	ArrayType	*arr = PG_GETARG_ARRAYTYPE_P(2);
+	Relation	heapRel;
+	TupleDesc	tupdesc;
+	AttrNumber	attnum;
+	Form_pg_attribute attr;
+	BufferAccessStrategy strategy;
+	BlockNumber	nblocks,
+				blkno;
+	Datum		*elems;
+	bool		*elnulls;
+	int			nelems;
+	PprState	state;
+	StringInfoData out;
+	MemoryContext pagecontext;
+	int			i;
+
+	heapRel = table_openrv(makeRangeVarFromNameList(textToQualifiedNameList(name)),
+						   AccessShareLock);
+
+	if (heapRel->rd_rel->relkind != RELKIND_RELATION &&
+		heapRel->rd_rel->relkind != RELKIND_MATVIEW)
+		elog(ERROR, "relation \"%s\" is not a table",
+			 RelationGetRelationName(heapRel));
+	if (heapRel->rd_rel->relam != HEAP_TABLE_AM_OID)
+		elog(ERROR, "table \"%s\" does not use heap access method",
+			 RelationGetRelationName(heapRel));
+
+	tupdesc = RelationGetDescr(heapRel);
+	attnum = get_attnum(RelationGetRelid(heapRel), colname);
+	if (attnum <= 0)
+		elog(ERROR, "column \"%s\" of relation \"%s\" does not exist",
+			 colname, RelationGetRelationName(heapRel));
+	attr = TupleDescAttr(tupdesc, attnum - 1);
+
+	memset(&state, 0, sizeof(state));
+	state.context = CurrentMemoryContext;
+	state.col.type = lookup_type_cache(attr->atttypid, TYPECACHE_CMP_PROC_FINFO);
+	if (!OidIsValid(state.col.type->cmp_proc_finfo.fn_oid))
+		elog(ERROR, "could not identify a comparison function for type %s",
+			 format_type_be(attr->atttypid));
+	state.col.cmp = &state.col.type->cmp_proc_finfo;
+	state.col.collation = attr->attcollation;
+	state.typlen = attr->attlen;
+	state.typbyval = attr->attbyval;
+	state.typalign = attr->attalign;
+
+	deconstruct_array(arr, INT4OID, sizeof(int32), true, 'i',
+					  &elems, &elnulls, &nelems);
+	if (nelems == 0)
+		elog(ERROR, "no pages_per_range candidates");
+
+	state.cand = (PprCandidate *) palloc0(sizeof(PprCandidate) * nelems);
+	for (i = 0; i < nelems; i++)
+	{
+		int32	ppr;
+
+		if (elnulls[i])
+			elog(ERROR, "pages_per_range candidate can not be NULL");
+		ppr = DatumGetInt32(elems[i]);
+		if (ppr < 1 || ppr > PPR_MAX_PAGES_PER_RANGE)
+			elog(ERROR, "pages_per_range %d is out of range (1..%d)",
+				 ppr, PPR_MAX_PAGES_PER_RANGE);
+
+		state.cand[i].ppr = ppr;
+		state.cand[i].curRange = InvalidBlockNumber;
+		state.cand[i].maxranges = 64;
+		state.cand[i].mins = (Datum *) palloc(sizeof(Datum) * 64);
+		state.cand[i].maxs = (Datum *) palloc(sizeof(Datum) * 64);
+	}
+	state.ncand = nelems;
+	qsort(state.cand, state.ncand, sizeof(PprCandidate), ppr_candidate_cmp);
+
+	state.sample = (Datum *) palloc(sizeof(Datum) * PPR_SAMPLE_SIZE);
+	state.stride = 1;
+
+	pagecontext = AllocSetContextCreate(CurrentMemoryContext,
+										"brin_ppr_advisor page",
+										ALLOCSET_DEFAULT_SIZES);
+
+	/* one sequential pass through a ring buffer, as a seqscan does */
+	strategy = GetAccessStrategy(BAS_BULKREAD);
+	nblocks = RelationGetNumberOfBlocks(heapRel);
+
+	gevel_progress_start(GEVEL_PROGRESS_BRIN_PPR_ADVISOR, heapRel);
+	gevel_progress_phase(GEVEL_PROGRESS_PHASE_HEAP, nblocks);
+
+	for (blkno = 0; blkno < nblocks; blkno++)
+	{
+		Buffer			buffer;
+		Page			page;
+		OffsetNumber	off,
+						maxoff;
+		MemoryContext	oldcontext;
+		Datum		   *values;
+		int				nvalues;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buffer = ReadBufferExtended(heapRel, MAIN_FORKNUM, blkno, RBM_NORMAL, strategy);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buffer);
+		maxoff = PageGetMaxOffsetNumber(page);
+
+		/* copies and detoasted values live until the end of the page */
+		oldcontext = MemoryContextSwitchTo(pagecontext);
+		values = (Datum *) palloc(sizeof(Datum) * Max(maxoff, 1));
+		nvalues = 0;
+
+		for (off = FirstOffsetNumber; off <= maxoff; off = OffsetNumberNext(off))
+		{
+			ItemId			iid = PageGetItemId(page, off);
+			HeapTupleData	tuple;
+			Datum			value;
+			bool			isnull;
+
+			if (!ItemIdIsNormal(iid))
+				continue;
+
+			tuple.t_data = (HeapTupleHeader) PageGetItem(page, iid);
+			tuple.t_len = ItemIdGetLength(iid);
+			tuple.t_tableOid = RelationGetRelid(heapRel);
+			ItemPointerSet(&tuple.t_self, blkno, off);
+
+			value = heap_getattr(&tuple, attnum, tupdesc, &isnull);
+			if (isnull)
+			{
+				state.nnulls++;
+				continue;
+			}
+			values[nvalues++] = datumCopy(value, attr->attbyval, attr->attlen);
+		}
+
+		/* detoasting may read the TOAST table, not under a buffer lock */
+		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+		ReleaseBuffer(buffer);
+
+		for (i = 0; i < nvalues; i++)
+		{
+			Datum		value = values[i];
+
+			if (attr->attlen == -1)
+				value = PointerGetDatum(PG_DETOAST_DATUM_PACKED(value));
+
+			MemoryContextSwitchTo(state.context);
+			ppr_add_value(&state, blkno, value);
+			MemoryContextSwitchTo(pagecontext);
+		}
+
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextReset(pagecontext);
+		gevel_progress_update(1, -1, maxoff);
+	}
+
+	gevel_progress_end();
+	FreeAccessStrategy(strategy);
+	table_close(heapRel, AccessShareLock);
+
+	for (i = 0; i < state.ncand; i++)
+		ppr_finish_range(&state, &state.cand[i]);
+
+	qsort_arg(state.sample, state.nsample, sizeof(Datum), brin_datum_cmp, &state.col);
+
+	initStringInfo(&out);
+	appendStringInfo(&out, "Heap pages:      %u\n", nblocks);
+	appendStringInfo(&out, "Values:          " INT64_FORMAT "\n", state.nseen);
+	appendStringInfo(&out, "Null values:     " INT64_FORMAT "\n", state.nnulls);
+	for (i = 0; i < state.ncand; i++)
+		ppr_report(&out, &state, &state.cand[i], nblocks);
+
+	MemoryContextDelete(pagecontext);
+
+	PG_RETURN_TEXT_P(cstring_to_text(out.data));
+}
+
+/*
+ * Hash index: every bucket is a primary page followed by a chain of
+ * overflow pages linked through hasho_nextblkno.
+ */
+typedef struct HashBucketStat
+{
+	BlockNumber	blkno;			/* primary bucket page */
+	int			noverflow;		/* overflow pages in the chain */
+	int64		ntuples;
+	int64		ndead;
+	double		primaryUsed;	/* bytes used on the primary page */
+	double		overflowUsed;	/* bytes used on all overflow pages */
+} HashBucketStat;
+
+#define HASH_PAGE_SPACE	\
+	(BLCKSZ - SizeOfPageHeaderData - MAXALIGN(sizeof(HashPageOpaqueData)))
+
+static void
+hash_read_meta(Relation index, HashMetaPageData *meta)
+{
+	Buffer		metabuf;
+
+	metabuf = _hash_getbuf(index, HASH_METAPAGE, HASH_READ, LH_META_PAGE);
+	memcpy(meta, HashPageGetMeta(BufferGetPage(metabuf)), sizeof(*meta));
+	_hash_relbuf(index, metabuf);
+}
+
+static void
+hash_scan_bucket(Relation index, HashMetaPage meta, Bucket bucket,
+				 HashBucketStat *bs)
+{
+	BlockNumber	blkno = BUCKET_TO_BLKNO(meta, bucket);
+	bool		primary = true;
+
+	memset(bs, 0, sizeof(*bs));
+	bs->blkno = blkno;
+
+	while (BlockNumberIsValid(blkno))
+	{
+		Buffer			buf;
+		Page			page;
+		HashPageOpaque	opaque;
+		OffsetNumber	off,
+						maxoff;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buf = _hash_getbuf(index, blkno, HASH_READ,
+						   primary ? LH_BUCKET_PAGE : LH_OVERFLOW_PAGE);
+		page = BufferGetPage(buf);
+		opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+
+		maxoff = PageGetMaxOffsetNumber(page);
+		gevel_progress_update(1, -1, maxoff);
+		for (off = FirstOffsetNumber; off <= maxoff; off = OffsetNumberNext(off))
+		{
+			if (ItemIdIsDead(PageGetItemId(page, off)))
+				bs->ndead++;
+			else
+				bs->ntuples++;
+		}
+
+		if (primary)
+			bs->primaryUsed = HASH_PAGE_SPACE - PageGetExactFreeSpace(page);
+		else
+		{
+			bs->noverflow++;
+			bs->overflowUsed += HASH_PAGE_SPACE - PageGetExactFreeSpace(page);
+		}
+
+		blkno = opaque->hasho_nextblkno;
+		primary = false;
+		_hash_relbuf(index, buf);
+	}
+}
+
+/*
+ * Returns the number of bits set in the overflow bitmap pages, i.e. the
+ * number of overflow and bitmap pages in use, and the number of bits
+ * covered by the bitmaps in *nbits.
+ */
+static uint32
+hash_bitmap_usage(Relation index, HashMetaPage meta, uint32 *nbits)
+{
+	uint32		bmbits = BMPGSZ_BIT(meta);
+	uint32		total = meta->hashm_spares[meta->hashm_ovflpoint];
+	uint32		used = 0;
+	uint32		i;
+
+	*nbits = total;
+
+	for (i = 0; i < meta->hashm_nmaps; i++)
+	{
+		Buffer		buf;
+		uint32	   *freep;
+		uint32		bit,
+					nbit;
+
+		buf = _hash_getbuf(index, meta->hashm_mapp[i], HASH_READ, LH_BITMAP_PAGE);
+		freep = HashPageGetBitmap(BufferGetPage(buf));
+
+		nbit = (total > i * bmbits) ? Min(bmbits, total - i * bmbits) : 0;
+		for (bit = 0; bit < nbit; bit++)
+			if (freep[bit / BITS_PER_MAP] & ((uint32) 1 << (bit % BITS_PER_MAP)))
+				used++;
+
+		_hash_relbuf(index, buf);
+	}
+
+	return used;
+}
+
+/*
+ * Print some statistic about hash index
+ * SELECT hash_stat(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(hash_stat);
+Datum hash_stat(PG_FUNCTION_ARGS);
+Datum
+hash_stat(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	HashMetaPageData meta;
+	HashBucketStat bs;
+	Bucket		bucket;
+	uint32		nbuckets;
+	BlockNumber	totalPages;
+	uint32		bitmapBits,
+				bitmapUsed;
+	int64		nOverflow = 0,
+				nWithOverflow = 0,
+				ntuples = 0,
+				ndead = 0,
+				minTuples = -1,
+				maxTuples = 0;
+	int			maxChain = 0;
+	int64		chainHist[6] = {0, 0, 0, 0, 0, 0};
+	double		primaryUsed = 0.0,
+				overflowUsed = 0.0;
+	StringInfoData out;
+
+	index = hash_index_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	hash_read_meta(index, &meta);
+	nbuckets = meta.hashm_maxbucket + 1;
+
+	gevel_progress_start(GEVEL_PROGRESS_HASH_STAT, index);
+	for (bucket = 0; bucket < nbuckets; bucket++)
+	{
+		int64	n;
+
+		hash_scan_bucket(index, &meta, bucket, &bs);
+
+		n = bs.ntuples + bs.ndead;
+		ntuples += bs.ntuples;
+		ndead += bs.ndead;
+		if (minTuples < 0 || n < minTuples)
+			minTuples = n;
+		if (n > maxTuples)
+			maxTuples = n;
+
+		nOverflow += bs.noverflow;
+		if (bs.noverflow > 0)
+			nWithOverflow++;
+		if (bs.noverflow > maxChain)
+			maxChain = bs.noverflow;
+
+		/* chain length buckets: 0, 1, 2, 3-4, 5-8, 9+ */
+		if (bs.noverflow <= 2)
+			chainHist[bs.noverflow]++;
+		else if (bs.noverflow <= 4)
+			chainHist[3]++;
+		else if (bs.noverflow <= 8)
+			chainHist[4]++;
+		else
+			chainHist[5]++;
+
+		primaryUsed += bs.primaryUsed;
+		overflowUsed += bs.overflowUsed;
+	}
+
+	bitmapUsed = hash_bitmap_usage(index, &meta, &bitmapBits);
+	totalPages = RelationGetNumberOfBlocks(index);
+	gevel_progress_end();
+
+	hash_index_close(index);
+
+	initStringInfo(&out);
+	appendStringInfo(&out,
+		"Number of buckets:            %u\n"
+		"Number of overflow pages:     " INT64_FORMAT "\n"
+		"Number of bitmap pages:       %u\n"
+		"Number of unused pages:       " INT64_FORMAT "\n"
+		"Number of tuples:             " INT64_FORMAT "\n"
+		"Number of dead tuples:        " INT64_FORMAT "\n"
+		"Fill factor:                  %u tuples per bucket\n"
+		"Tuples per bucket:            min " INT64_FORMAT ", avg %.2f, max " INT64_FORMAT "\n"
+		"Primary page fill:            %.2f%%\n"
+		"Overflow page fill:           %.2f%%\n"
+		"Buckets with overflow:        " INT64_FORMAT " (%.2f%%)\n"
+		"Overflow chain length:        avg %.2f, max %d\n"
+		"Overflow chain histogram:     0: " INT64_FORMAT " 1: " INT64_FORMAT
+		" 2: " INT64_FORMAT " 3-4: " INT64_FORMAT " 5-8: " INT64_FORMAT
+		" 9+: " INT64_FORMAT "\n"
+		"Bitmap bits used:             %u of %u\n"
+		"Total size of index:          " INT64_FORMAT " bytes\n",
+		nbuckets,
+		nOverflow,
+		meta.hashm_nmaps,
+		(int64) totalPages - 1 - nbuckets - nOverflow - meta.hashm_nmaps,
+		ntuples,
+		ndead,
+		(uint32) meta.hashm_ffactor,
+		minTuples, (double) (ntuples + ndead) / nbuckets, maxTuples,
+		100.0 * primaryUsed / ((double) HASH_PAGE_SPACE * nbuckets),
+		(nOverflow > 0) ? 100.0 * overflowUsed / ((double) HASH_PAGE_SPACE * nOverflow) : 0.0,
+		nWithOverflow, 100.0 * nWithOverflow / nbuckets,
+		(double) nOverflow / nbuckets, maxChain,
+		chainHist[0], chainHist[1], chainHist[2],
+		chainHist[3], chainHist[4], chainHist[5],
+		bitmapUsed, bitmapBits,
+		(int64) totalPages * BLCKSZ);
+
+	PG_FREE_IF_COPY(name, 0);
+	PG_RETURN_TEXT_P(cstring_to_text(out.data));
+}
+
+/*
+ * Per-bucket statistic of hash index
+ * SELECT * FROM hash_print(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(hash_print);
+Datum hash_print(PG_FUNCTION_ARGS);
+Datum
+hash_print(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	HashMetaPageData meta;
+	Bucket		bucket;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	tupstore = materializeSetup(fcinfo, tupdesc);
+
+	index = hash_index_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	hash_read_meta(index, &meta);
+
+	gevel_progress_start(GEVEL_PROGRESS_HASH_PRINT, index);
+	for (bucket = 0; bucket <= meta.hashm_maxbucket; bucket++)
+	{
+		HashBucketStat bs;
+		Datum		values[7];
+		bool		nulls[7];
+
+		hash_scan_bucket(index, &meta, bucket, &bs);
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int64GetDatum((int64) bucket);
+		values[1] = Int64GetDatum((int64) bs.blkno);
+		values[2] = Int32GetDatum(bs.noverflow);
+		values[3] = Int64GetDatum(bs.ntuples);
+		values[4] = Int64GetDatum(bs.ndead);
+		values[5] = Float8GetDatum(100.0 * bs.primaryUsed / HASH_PAGE_SPACE);
+		if (bs.noverflow > 0)
+			values[6] = Float8GetDatum(100.0 * bs.overflowUsed /
+									   ((double) HASH_PAGE_SPACE * bs.noverflow));
+		else
+			nulls[6] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	gevel_progress_end();
+
+	hash_index_close(index);
+
+	PG_FREE_IF_COPY(name, 0);
+	return (Datum) 0;
+}
+
+/*
+ * Database-wide index survey.
+ *
+ * Every index is read block by block in physical order, through a
+ * bulk-read ring buffer and under AccessShareLock only, and every page is
+ * classified by the page layout of its access method. I/O is throttled the
+ * way VACUUM does it: buffer hits and misses are charged
+ * vacuum_cost_page_hit and vacuum_cost_page_miss, and once cost_limit is
+ * reached the backend sleeps for cost_delay milliseconds.
+ */
+typedef struct SurveyCost
+{
+	double		delay;			/* milliseconds, 0 disables throttling */
+	int			limit;
+	int			balance;
+	int64		hits;			/* pgBufferUsage at the last cost point */
+	int64		reads;
+} SurveyCost;
+
+typedef struct SurveyResult
+{
+	int64		pages;
+	int64		otherPages;		/* meta, bitmap, revmap, pending list */
+	int64		innerPages;
+	int64		leafPages;
+	int64		deletedPages;	/* deleted, half-dead, unused or new */
+	int			levels;			/* btree only, -1 otherwise */
+	int64		tuples;			/* live items on leaf pages */
+	int64		deadTuples;		/* LP_DEAD items on leaf pages */
+	double		leafSpace;
+	double		leafUsed;
+} SurveyResult;
+
+typedef enum SurveyPageKind
+{
+	SURVEY_OTHER,
+	SURVEY_INNER,
+	SURVEY_LEAF,
+	SURVEY_DELETED
+} SurveyPageKind;
+
+static void
+survey_cost_init(SurveyCost *cost, double delay, int limit)
+{
+	if (delay < 0 || limit <= 0)
+		elog(ERROR, "cost_delay must not be negative and cost_limit must be positive");
+
+	cost->delay = delay;
+	cost->limit = limit;
+	cost->balance = 0;
+	cost->hits = pgBufferUsage.shared_blks_hit;
+	cost->reads = pgBufferUsage.shared_blks_read;
+}
+
+/*
+ * Charge the buffer accesses done since the previous call and sleep when
+ * the budget is exhausted. Must not be called while holding a buffer lock.
+ */
+static void
+survey_cost_point(SurveyCost *cost)
+{
+	int64		hits = pgBufferUsage.shared_blks_hit;
+	int64		reads = pgBufferUsage.shared_blks_read;
+
+	cost->balance += (hits - cost->hits) * VacuumCostPageHit +
+		(reads - cost->reads) * VacuumCostPageMiss;
+	cost->hits = hits;
+	cost->reads = reads;
+
+	if (cost->delay > 0 && cost->balance >= cost->limit)
+	{
+		double		msec;
+
+		/* same formula as vacuum_delay_point() */
+		msec = cost->delay * cost->balance / cost->limit;
+		if (msec > cost->delay * 4)
+			msec = cost->delay * 4;
+
+		pg_usleep((long) (msec * 1000));
+		cost->balance = 0;
+	}
+
+	CHECK_FOR_INTERRUPTS();
+}
+
+/*
+ * Classify one page of an index. *countItems is set when the line
+ * pointers of the page, starting at *firstItem, are index tuples.
+ */
+static SurveyPageKind
+survey_classify_page(Relation index, BlockNumber blkno, Page page,
+					 OffsetNumber *firstItem, bool *countItems, int *levels)
+{
+	*firstItem = FirstOffsetNumber;
+	*countItems = false;
+
+	if (PageIsNew(page))
+		return SURVEY_DELETED;
+
+	switch (index->rd_rel->relam)
+	{
+		case BTREE_AM_OID:
+			{
+				BTPageOpaque opaque;
+
+				if (blkno == BTREE_METAPAGE)
+				{
+					BTMetaPageData *metad = BTPageGetMeta(page);
+
+					*levels = (metad->btm_root == P_NONE) ? 0 : metad->btm_level + 1;
+					return SURVEY_OTHER;
+				}
+
+				opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+				if (P_ISDELETED(opaque) || P_ISHALFDEAD(opaque))
+					return SURVEY_DELETED;
+				if (!P_ISLEAF(opaque))
+					return SURVEY_INNER;
+
+				*firstItem = P_FIRSTDATAKEY(opaque);
+				*countItems = true;
+				return SURVEY_LEAF;
+			}
+		case HASH_AM_OID:
+			{
+				HashPageOpaque opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+
+				switch (opaque->hasho_flag & LH_PAGE_TYPE)
+				{
+					case LH_BUCKET_PAGE:
+					case LH_OVERFLOW_PAGE:
+						*countItems = true;
+						return SURVEY_LEAF;
+					case LH_UNUSED_PAGE:
+						return SURVEY_DELETED;
+					default:
+						return SURVEY_OTHER;
+				}
+			}
+		case GIST_AM_OID:
+			if (GistPageIsDeleted(page))
+				return SURVEY_DELETED;
+			if (!GistPageIsLeaf(page))
+				return SURVEY_INNER;
+			*countItems = true;
+			return SURVEY_LEAF;
+		case GIN_AM_OID:
+			if (blkno == GIN_METAPAGE_BLKNO || GinPageIsList(page))
+				return SURVEY_OTHER;
+			if (GinPageIsDeleted(page))
+				return SURVEY_DELETED;
+			if (!GinPageIsLeaf(page))
+				return SURVEY_INNER;
+			/* posting tree leaves hold compressed item lists, not tuples */
+			*countItems = !GinPageIsData(page);
+			return SURVEY_LEAF;
+		case SPGIST_AM_OID:
+			if (blkno == SPGIST_METAPAGE_BLKNO)
+				return SURVEY_OTHER;
+			if (SpGistPageIsDeleted(page))
+				return SURVEY_DELETED;
+			if (!SpGistPageIsLeaf(page))
+				return SURVEY_INNER;
+			*countItems = true;
+			return SURVEY_LEAF;
+		case BRIN_AM_OID:
+			if (BRIN_IS_REGULAR_PAGE(page))
+			{
+				*countItems = true;
+				return SURVEY_LEAF;
+			}
+			return SURVEY_OTHER;
+	}
+
+	return SURVEY_OTHER;
+}
+
+static void
+survey_index(Relation index, SurveyCost *cost, SurveyResult *res)
+{
+	BufferAccessStrategy bstrategy = GetAccessStrategy(BAS_BULKREAD);
+	BlockNumber	nblocks,
+				blkno;
+
+	memset(res, 0, sizeof(*res));
+	res->levels = -1;
+
+	nblocks = RelationGetNumberOfBlocks(index);
+	res->pages = nblocks;
+
+	for (blkno = 0; blkno < nblocks; blkno++)
+	{
+		Buffer		buf;
+		Page		page;
+		OffsetNumber firstItem,
+					off,
+					maxoff;
+		bool		countItems;
+		int64		tuplesBefore;
+
+		buf = ReadBufferExtended(index, MAIN_FORKNUM, blkno, RBM_NORMAL, bstrategy);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		tuplesBefore = res->tuples;
+
+		switch (survey_classify_page(index, blkno, page,
+									 &firstItem, &countItems, &res->levels))
+		{
+			case SURVEY_OTHER:
+				res->otherPages++;
+				break;
+			case SURVEY_INNER:
+				res->innerPages++;
+				break;
+			case SURVEY_DELETED:
+				res->deletedPages++;
+				break;
+			case SURVEY_LEAF:
+				{
+					double	space = BLCKSZ - SizeOfPageHeaderData - PageGetSpecialSize(page);
+
+					res->leafPages++;
+					res->leafSpace += space;
+					res->leafUsed += space - PageGetExactFreeSpace(page);
+
+					if (!countItems)
+						break;
+
+					maxoff = PageGetMaxOffsetNumber(page);
+					for (off = firstItem; off <= maxoff; off = OffsetNumberNext(off))
+					{
+						ItemId	iid = PageGetItemId(page, off);
+
+						if (ItemIdIsDead(iid))
+							res->deadTuples++;
+						else if (ItemIdIsNormal(iid))
+							res->tuples++;
+					}
+
+					if (index->rd_rel->relam == SPGIST_AM_OID)
+						res->tuples -= SpGistPageGetOpaque(page)->nPlaceholder +
+							SpGistPageGetOpaque(page)->nRedirection;
+				}
+				break;
+		}
+
+		UnlockReleaseBuffer(buf);
+		gevel_progress_update(1, -1, res->tuples - tuplesBefore);
+		survey_cost_point(cost);
+	}
+
+	FreeAccessStrategy(bstrategy);
+}
+
+static Oid
+survey_am_oid(const char *amname)
+{
+	Oid			amoid = get_am_oid(amname, false);
+
+	switch (amoid)
+	{
+		case BTREE_AM_OID:
+		case HASH_AM_OID:
+		case GIST_AM_OID:
+		case GIN_AM_OID:
+		case SPGIST_AM_OID:
+		case BRIN_AM_OID:
+			return amoid;
+	}
+
+	elog(ERROR, "access method \"%s\" is not supported by gevel_survey", amname);
+	return InvalidOid;			/* keep compiler quiet */
+}
+
+/*
+ * Survey all indexes of the given access methods in schemas matching
+ * a LIKE pattern, one row per index
+ * SELECT * FROM gevel_survey(SCHEMA_PATTERN, AM_LIST[, COST_DELAY, COST_LIMIT]);
+ */
+PG_FUNCTION_INFO_V1(gevel_survey);
+Datum gevel_survey(PG_FUNCTION_ARGS);
+Datum
+gevel_survey(PG_FUNCTION_ARGS)
+{
+	text		*pattern = PG_GETARG_TEXT_PP(0);
+	ArrayType	*amlist = PG_GETARG_ARRAYTYPE_P(1);
+	SurveyCost	cost;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	Datum		*amnames;
+	bool		*amnulls;
+	int			nams,
+				i;
+	Oid			*amoids;
+	List		*indexes = NIL;
+	ListCell	*lc;
+	Relation	classRel;
+	TableScanDesc scan;
+	HeapTuple	tuple;
+
+	survey_cost_init(&cost, PG_GETARG_FLOAT8(2), PG_GETARG_INT32(3));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	deconstruct_array(amlist, TEXTOID, -1, false, 'i',
+					  &amnames, &amnulls, &nams);
+	amoids = palloc(sizeof(Oid) * Max(nams, 1));
+	for (i = 0; i < nams; i++)
+	{
+		if (amnulls[i])
+			elog(ERROR, "access method list must not contain nulls");
+		amoids[i] = survey_am_oid(TextDatumGetCString(amnames[i]));
+	}
+
+	tupstore = materializeSetup(fcinfo, tupdesc);
+
+	/* collect the OIDs first, no catalog scan stays open while indexes are read */
+	classRel = table_open(RelationRelationId, AccessShareLock);
+	scan = table_beginscan_catalog(classRel, 0, NULL);
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Form_pg_class classForm = (Form_pg_class) GETSTRUCT(tuple);
+		char	   *nspname;
+
+		if (classForm->relkind != RELKIND_INDEX)
+			continue;
+
+		for (i = 0; i < nams; i++)
+			if (amoids[i] == classForm->relam)
+				break;
+		if (i >= nams)
+			continue;
+
+		nspname = get_namespace_name(classForm->relnamespace);
+		if (nspname == NULL ||
+			!DatumGetBool(DirectFunctionCall2Coll(textlike, C_COLLATION_OID,
+												  CStringGetTextDatum(nspname),
+												  PointerGetDatum(pattern))))
+			continue;
+
+		indexes = lappend_oid(indexes, classForm->oid);
+	}
+	table_endscan(scan);
+	table_close(classRel, AccessShareLock);
+
+	foreach(lc, indexes)
+	{
+		Oid			indexOid = lfirst_oid(lc);
+		Relation	index;
+		SurveyResult res;
+		Datum		values[14];
+		bool		nulls[14];
+
+		/* the index may have been dropped since the catalog scan */
+		index = try_relation_open(indexOid, AccessShareLock);
+		if (index == NULL)
+			continue;
+
+		if (RELATION_IS_OTHER_TEMP(index))
+		{
+			relation_close(index, AccessShareLock);
+			continue;
+		}
+
+		gevel_progress_start(GEVEL_PROGRESS_SURVEY, index);
+		survey_index(index, &cost, &res);
+		gevel_progress_end();
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = CStringGetTextDatum(get_namespace_name(RelationGetNamespace(index)));
+		values[1] = CStringGetTextDatum(RelationGetRelationName(index));
+		values[2] = CStringGetTextDatum(get_rel_name(index->rd_index->indrelid));
+		values[3] = CStringGetTextDatum(get_am_name(index->rd_rel->relam));
+		values[4] = Int64GetDatum(res.pages);
+		values[5] = Int64GetDatum(res.otherPages);
+		values[6] = Int64GetDatum(res.innerPages);
+		values[7] = Int64GetDatum(res.leafPages);
+		values[8] = Int64GetDatum(res.deletedPages);
+		if (res.levels >= 0)
+			values[9] = Int32GetDatum(res.levels);
+		else
+			nulls[9] = true;
+		values[10] = Int64GetDatum(res.tuples);
+		values[11] = Int64GetDatum(res.deadTuples);
+		if (res.leafPages > 0)
+			values[12] = Float8GetDatum(100.0 * res.leafUsed / res.leafSpace);
+		else
+			nulls[12] = true;
+		values[13] = Int64GetDatum((int64) (res.leafSpace - res.leafUsed));
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+		relation_close(index, AccessShareLock);
+	}
+
+	PG_FREE_IF_COPY(pattern, 0);
+	return (Datum) 0;
+}
+
+/*
+ * Physical locality of the leaf level: the leaves are visited in the order
+ * an ordered scan reads them and every step from one leaf to the next is
+ * a jump of some distance in blocks. A jump to blk+1 is a sequential read
+ * that readahead serves, any other one is a random read.
+ */
+#define LEAF_CHAIN_BUCKETS	6
+
+static const int64 leafChainBucketMax[LEAF_CHAIN_BUCKETS - 1] = {1, 8, 64, 512, 4096};
+
+typedef struct LeafChainStat {
+	const char	*name;
+	int64		chains;
+	int64		pages;
+	int64		links;
+	int64		nextLinks;		/* to blk+1 */
+	int64		forwardLinks;
+	int64		backwardLinks;
+	double		sumJump;		/* of absolute distances */
+	int64		hist[LEAF_CHAIN_BUCKETS];
+	BlockNumber	prev;			/* previous leaf of the current chain */
+} LeafChainStat;
+
+static void
+leaf_chain_start(LeafChainStat *lc)
+{
+	lc->chains++;
+	lc->prev = InvalidBlockNumber;
+}
+
+static void
+leaf_chain_add(LeafChainStat *lc, BlockNumber blkno)
+{
+	lc->pages++;
+
+	if (lc->prev != InvalidBlockNumber)
+	{
+		int64		jump = (int64) blkno - (int64) lc->prev;
+		int64		dist = (jump < 0) ? -jump : jump;
+		int			b;
+
+		lc->links++;
+		if (jump == 1)
+			lc->nextLinks++;
+		if (jump > 0)
+			lc->forwardLinks++;
+		else
+			lc->backwardLinks++;
+		lc->sumJump += dist;
+
+		for (b = 0; b < LEAF_CHAIN_BUCKETS - 1 && dist > leafChainBucketMax[b]; b++)
+			;
+		lc->hist[b]++;
+	}
+
+	lc->prev = blkno;
+}
+
+/* the leaf level of btree, from the leftmost leaf along btpo_next */
+static void
+leaf_chain_btree(Relation index, LeafChainStat *lc)
+{
+	Buffer		buffer;
+
+	leaf_chain_start(lc);
+
+	buffer = _bt_get_endpoint(index, 0, false, NULL);
+	while (BufferIsValid(buffer))
+	{
+		Page			page = BufferGetPage(buffer);
+		BTPageOpaque	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+		BlockNumber		next = opaque->btpo_next;
+
+		CHECK_FOR_INTERRUPTS();
+		gevel_progress_update(1, 0, PageGetMaxOffsetNumber(page));
+
+		leaf_chain_add(lc, BufferGetBlockNumber(buffer));
+
+		UnlockReleaseBuffer(buffer);
+		buffer = (next != P_NONE) ? _bt_getbuf(index, next, BT_READ) : InvalidBuffer;
+	}
+}
+
+/*
+ * GiST leaves have no usable chain, rightlinks only cover concurrent
+ * splits, so they are taken in the depth-first order of a GiST scan. The
+ * tree is balanced and the children of a page at depth 1 are leaves,
+ * which are therefore counted without being read.
+ */
+static void
+leaf_chain_gist(Relation index, BlockNumber blkno, int depth, LeafChainStat *lc)
+{
+	Buffer		buffer;
+	Page		page;
+	BlockNumber	*children;
+	OffsetNumber i,
+				maxoff;
+
+	if (depth == 0)
+	{
+		leaf_chain_add(lc, blkno);
+		return;
+	}
+
+	CHECK_FOR_INTERRUPTS();
+
+	buffer = ReadBuffer(index, blkno);
+	LockBuffer(buffer, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buffer);
+	maxoff = PageGetMaxOffsetNumber(page);
+	gevel_progress_update(1, depth, maxoff);
+
+	if (GistPageIsLeaf(page))
+	{
+		/* the root, or a page that has not been split yet */
+		UnlockReleaseBuffer(buffer);
+		leaf_chain_add(lc, blkno);
+		return;
+	}
+
+	children = palloc(sizeof(BlockNumber) * Max(maxoff, 1));
+	for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+	{
+		IndexTuple	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+
+		children[i - FirstOffsetNumber] = ItemPointerGetBlockNumber(&itup->t_tid);
+	}
+	UnlockReleaseBuffer(buffer);
+
+	for (i = 0; i < maxoff; i++)
+		leaf_chain_gist(index, children[i], depth - 1, lc);
+
+	pfree(children);
+}
+
+/* follow the leftmost downlinks of a GIN entry tree or posting tree */
+static BlockNumber
+gin_leftmost_leaf(Relation index, BlockNumber blkno, bool isData)
+{
+	for (;;)
+	{
+		Buffer		buffer;
+		Page		page;
+		BlockNumber	child;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buffer = ReadBuffer(index, blkno);
+		LockBuffer(buffer, GIN_SHARE);
+		page = BufferGetPage(buffer);
+		gevel_progress_update(1, -1, 0);
+
+		if (GinPageIsLeaf(page))
+		{
+			UnlockReleaseBuffer(buffer);
+			return blkno;
+		}
+
+		if (isData)
+			child = PostingItemGetBlockNumber(GinDataPageGetPostingItem(page, FirstOffsetNumber));
+		else
+			child = GinGetDownlink((IndexTuple) PageGetItem(page,
+										PageGetItemId(page, FirstOffsetNumber)));
+		UnlockReleaseBuffer(buffer);
+		blkno = child;
+	}
+}
+
+/*
+ * One leaf chain of GIN along the rightlinks. On the entry tree the roots
+ * of the posting trees met on the way are collected, they are walked
+ * afterwards as chains of their own.
+ */
+static void
+leaf_chain_gin(Relation index, BlockNumber blkno, LeafChainStat *lc,
+			   BlockNumber **roots, int *nroots, int *maxroots)
+{
+	leaf_chain_start(lc);
+
+	for (;;)
+	{
+		Buffer		buffer;
+		Page		page;
+		BlockNumber	next;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buffer = ReadBuffer(index, blkno);
+		LockBuffer(buffer, GIN_SHARE);
+		page = BufferGetPage(buffer);
+		gevel_progress_update(1, 0, GinPageIsData(page) ? 0 : PageGetMaxOffsetNumber(page));
+
+		leaf_chain_add(lc, blkno);
+
+		if (roots)
+		{
+			OffsetNumber i,
+						maxoff = PageGetMaxOffsetNumber(page);
+
+			for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+			{
+				IndexTuple	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+
+				if (!GinIsPostingTree(itup))
+					continue;
+
+				if (*nroots >= *maxroots)
+				{
+					*maxroots *= 2;
+					*roots = repalloc(*roots, sizeof(BlockNumber) * *maxroots);
+				}
+				(*roots)[(*nroots)++] = GinGetPostingTree(itup);
+			}
+		}
+
+		next = GinPageRightMost(page) ? InvalidBlockNumber : GinPageGetOpaque(page)->rightlink;
+		UnlockReleaseBuffer(buffer);
+
+		if (next == InvalidBlockNumber)
+			break;
+		blkno = next;
+	}
+}
+
+static void
+leaf_chain_format(StringInfo out, LeafChainStat *lc,
+				  double seqPageCost, double randomPageCost)
+{
+	int64		randomReads = lc->chains + lc->links - lc->nextLinks;
+
+	appendStringInfo(out,
+		"Leaf chain:                   %s\n"
+		"Number of chains:             " INT64_FORMAT "\n"
+		"Number of leaf pages:         " INT64_FORMAT "\n"
+		"Links to next block:          " INT64_FORMAT " of " INT64_FORMAT " (%.2f%%)\n"
+		"Forward/backward links:       " INT64_FORMAT "/" INT64_FORMAT "\n"
+		"Average jump:                 %.2f blocks\n"
+		"Jump histogram:               1: " INT64_FORMAT " 2-8: " INT64_FORMAT
+		" 9-64: " INT64_FORMAT " 65-512: " INT64_FORMAT " 513-4096: " INT64_FORMAT
+		" 4097+: " INT64_FORMAT "\n"
+		"Sequential/random reads:      " INT64_FORMAT "/" INT64_FORMAT "\n"
+		"Scan I/O cost:                %.2f (%.2f in block order)\n",
+		lc->name,
+		lc->chains,
+		lc->pages,
+		lc->nextLinks, lc->links,
+		(lc->links > 0) ? 100.0 * lc->nextLinks / lc->links : 100.0,
+		lc->forwardLinks, lc->backwardLinks,
+		(lc->links > 0) ? lc->sumJump / lc->links : 0.0,
+		lc->hist[0], lc->hist[1], lc->hist[2], lc->hist[3], lc->hist[4], lc->hist[5],
+		lc->nextLinks, randomReads,
+		seqPageCost * lc->nextLinks + randomPageCost * randomReads,
+		seqPageCost * (lc->pages - lc->chains) + randomPageCost * lc->chains);
+}
+
+/*
+ * Fragmentation of the leaf level of btree, GiST and GIN index: how often
+ * the next leaf of an ordered scan is the next block, the distribution of
+ * the jumps, and the I/O cost of a full scan under the seq_page_cost and
+ * random_page_cost of the index tablespace, as read versus as it would be
+ * after REINDEX. Runs under AccessShareLock with one page locked at a time.
+ * SELECT leaf_chain_stat(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(leaf_chain_stat);
+Datum leaf_chain_stat(PG_FUNCTION_ARGS);
+Datum
+leaf_chain_stat(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	RangeVar	*relvar;
+	Relation	index;
+	LeafChainStat entry,
+				posting;
+	double		seqPageCost,
+				randomPageCost;
+	StringInfoData out;
+
+	relvar = makeRangeVarFromNameList(textToQualifiedNameList(name));
+	index = gevel_relation_openrv(relvar, AccessShareLock);
+
+	if (!IS_INDEX(index) ||
+		(index->rd_rel->relam != BTREE_AM_OID &&
+		 index->rd_rel->relam != GIST_AM_OID &&
+		 index->rd_rel->relam != GIN_AM_OID))
+		elog(ERROR, "relation \"%s\" is not a btree, GiST or GIN index",
+			 RelationGetRelationName(index));
+
+	memset(&entry, 0, sizeof(LeafChainStat));
+	memset(&posting, 0, sizeof(LeafChainStat));
+
+	gevel_progress_start(GEVEL_PROGRESS_LEAF_CHAIN_STAT, index);
+	switch (index->rd_rel->relam)
+	{
+		case BTREE_AM_OID:
+			entry.name = "btree leaf level";
+			leaf_chain_btree(index, &entry);
+			break;
+		case GIST_AM_OID:
+			entry.name = "gist leaves, depth-first";
+			leaf_chain_start(&entry);
+			leaf_chain_gist(index, GIST_ROOT_BLKNO,
+							gist_tree_depth(index, GIST_ROOT_BLKNO), &entry);
+			break;
+		case GIN_AM_OID:
+			{
+				BlockNumber *roots;
+				int			nroots = 0,
+							maxroots = 64,
+							i;
+
+				roots = palloc(sizeof(BlockNumber) * maxroots);
+
+				entry.name = "gin entry tree leaves";
+				leaf_chain_gin(index, gin_leftmost_leaf(index, GIN_ROOT_BLKNO, false),
+							   &entry, &roots, &nroots, &maxroots);
+
+				posting.name = "gin posting tree leaves";
+				for (i = 0; i < nroots; i++)
+					leaf_chain_gin(index, gin_leftmost_leaf(index, roots[i], true),
+								   &posting, NULL, NULL, NULL);
+
+				pfree(roots);
+			}
+			break;
+	}
+	gevel_progress_end();
+
+	get_tablespace_page_costs(index->rd_rel->reltablespace,
+							  &randomPageCost, &seqPageCost);
+
+	initStringInfo(&out);
+	leaf_chain_format(&out, &entry, seqPageCost, randomPageCost);
+	if (posting.chains > 0)
+		leaf_chain_format(&out, &posting, seqPageCost, randomPageCost);
+
+	relation_close(index, AccessShareLock);
+
+	PG_FREE_IF_COPY(name, 0);
+	PG_RETURN_TEXT_P(cstring_to_text(out.data));
+}
+
+/*
+ * Heap order of the TIDs of an index. The TIDs are read in key order and
+ * every change of the heap block from the previous TID is a heap page an
+ * index scan reads again: their number is the clustering factor, from
+ * the number of heap pages when the heap is in index order up to the
+ * number of TIDs when it is random.
+ */
+typedef struct HeapCorrelation {
+	int64		tids;
+	int64		reads;			/* clustering factor */
+	BlockNumber	lastBlock;		/* InvalidBlockNumber at a sequence start */
+	int64		leafPages;		/* with at least one TID */
+	int64		sumBlocks;		/* distinct heap blocks summed over leaf pages */
+	int			maxBlocks;
+	BlockNumber	*blocks;		/* heap blocks of the current leaf page */
+	int			nblocks;
+	int			maxblocks;
+} HeapCorrelation;
+
+static int
+blocknumber_cmp(const void *a, const void *b)
+{
+	BlockNumber	ba = *(const BlockNumber *) a;
+	BlockNumber	bb = *(const BlockNumber *) b;
+
+	return (ba > bb) - (ba < bb);
+}
+
+static void
+heap_corr_add(HeapCorrelation *hc, ItemPointer tid)
+{
+	BlockNumber	blkno = ItemPointerGetBlockNumber(tid);
+
+	hc->tids++;
+	if (blkno != hc->lastBlock)
+		hc->reads++;
+	hc->lastBlock = blkno;
+
+	if (hc->nblocks >= hc->maxblocks)
+	{
+		hc->maxblocks *= 2;
+		hc->blocks = repalloc(hc->blocks, sizeof(BlockNumber) * hc->maxblocks);
+	}
+	hc->blocks[hc->nblocks++] = blkno;
+}
+
+static void
+heap_corr_page_end(HeapCorrelation *hc)
+{
+	int			i,
+				ndistinct = 1;
+
+	if (hc->nblocks == 0)
+		return;
+
+	qsort(hc->blocks, hc->nblocks, sizeof(BlockNumber), blocknumber_cmp);
+	for (i = 1; i < hc->nblocks; i++)
+		if (hc->blocks[i] != hc->blocks[i - 1])
+			ndistinct++;
+
+	hc->leafPages++;
+	hc->sumBlocks += ndistinct;
+	hc->maxBlocks = Max(hc->maxBlocks, ndistinct);
+	hc->nblocks = 0;
+}
+
+/* the btree leaf level in key order, posting lists expanded */
+static void
+heap_corr_btree(Relation index, HeapCorrelation *hc)
+{
+	Buffer		buffer = _bt_get_endpoint(index, 0, false, NULL);
+
+	while (BufferIsValid(buffer))
+	{
+		Page			page = BufferGetPage(buffer);
+		BTPageOpaque	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+		OffsetNumber	i,
+						maxoff = PageGetMaxOffsetNumber(page);
+		BlockNumber		next = opaque->btpo_next;
+
+		CHECK_FOR_INTERRUPTS();
+		gevel_progress_update(1, 0, maxoff);
+
+		for (i = P_FIRSTDATAKEY(opaque); i <= maxoff && !P_IGNORE(opaque); i = OffsetNumberNext(i))
+		{
+			ItemId		iid = PageGetItemId(page, i);
+			IndexTuple	itup = (IndexTuple) PageGetItem(page, iid);
+
+			/* killed items are skipped by index scans */
+			if (ItemIdIsDead(iid))
+				continue;
+
+#if PG_VERSION_NUM >= 130000
+			if (BTreeTupleIsPosting(itup))
+			{
+				int			n;
+
+				for (n = 0; n < BTreeTupleGetNPosting(itup); n++)
+					heap_corr_add(hc, BTreeTupleGetPostingN(itup, n));
+				continue;
+			}
+#endif
+			heap_corr_add(hc, &itup->t_tid);
+		}
+		heap_corr_page_end(hc);
+
+		UnlockReleaseBuffer(buffer);
+		buffer = (next != P_NONE) ? _bt_getbuf(index, next, BT_READ) : InvalidBuffer;
+	}
+}
+
+/* GiST leaves in the depth-first order of leaf_chain_gist */
+static void
+heap_corr_gist(Relation index, BlockNumber blkno, HeapCorrelation *hc)
+{
+	Buffer		buffer;
+	Page		page;
+	BlockNumber	*children;
+	OffsetNumber i,
+				maxoff;
+	int			nchildren = 0;
+
+	CHECK_FOR_INTERRUPTS();
+
+	buffer = ReadBuffer(index, blkno);
+	LockBuffer(buffer, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buffer);
+	maxoff = PageGetMaxOffsetNumber(page);
+	gevel_progress_update(1, -1, maxoff);
+
+	if (GistPageIsLeaf(page))
+	{
+		for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+		{
+			ItemId		iid = PageGetItemId(page, i);
+
+			if (!ItemIdIsDead(iid))
+				heap_corr_add(hc, &((IndexTuple) PageGetItem(page, iid))->t_tid);
+		}
+		heap_corr_page_end(hc);
+		UnlockReleaseBuffer(buffer);
+		return;
+	}
+
+	children = palloc(sizeof(BlockNumber) * Max(maxoff, 1));
+	for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+	{
+		IndexTuple	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+
+		children[nchildren++] = ItemPointerGetBlockNumber(&itup->t_tid);
+	}
+	UnlockReleaseBuffer(buffer);
+
+	for (i = 0; i < nchildren; i++)
+		heap_corr_gist(index, children[i], hc);
+
+	pfree(children);
+}
+
+/* SP-GiST has no key order, leaf pages are read in block order */
+static void
+heap_corr_spgist(Relation index, HeapCorrelation *hc)
+{
+	BufferAccessStrategy bstrategy = GetAccessStrategy(BAS_BULKREAD);
+	BlockNumber	nblocks = RelationGetNumberOfBlocks(index),
+				blkno;
+
+	for (blkno = SPGIST_METAPAGE_BLKNO + 1; blkno < nblocks; blkno++)
+	{
+		Buffer		buffer;
+		Page		page;
+		OffsetNumber i,
+					maxoff;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buffer = ReadBufferExtended(index, MAIN_FORKNUM, blkno, RBM_NORMAL, bstrategy);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buffer);
+		maxoff = PageGetMaxOffsetNumber(page);
+		gevel_progress_update(1, -1, maxoff);
+
+		if (!PageIsNew(page) && !SpGistPageIsDeleted(page) && SpGistPageIsLeaf(page))
+		{
+			for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+			{
+				SpGistLeafTuple lt = (SpGistLeafTuple) PageGetItem(page, PageGetItemId(page, i));
+
+				if (lt->tupstate == SPGIST_LIVE)
+					heap_corr_add(hc, &lt->heapPtr);
+			}
+			heap_corr_page_end(hc);
+		}
+
+		UnlockReleaseBuffer(buffer);
+	}
+
+	FreeAccessStrategy(bstrategy);
+}
+
+/*
+ * GIN posting data: the posting lists kept in the entry tree leaves, then
+ * the posting trees along their leaf chains. Every key is a sequence of
+ * its own, a GIN scan reads the TIDs of one key in TID order.
+ */
+static void
+heap_corr_gin(Relation index, HeapCorrelation *hc)
+{
+	BlockNumber	*roots;
+	int			nroots = 0,
+				maxroots = 64,
+				r;
+	BlockNumber	blkno = gin_leftmost_leaf(index, GIN_ROOT_BLKNO, false);
+
+	roots = palloc(sizeof(BlockNumber) * maxroots);
+
+	while (blkno != InvalidBlockNumber)
+	{
+		Buffer		buffer;
+		Page		page;
+		OffsetNumber i,
+					maxoff;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buffer = ReadBuffer(index, blkno);
+		LockBuffer(buffer, GIN_SHARE);
+		page = BufferGetPage(buffer);
+		maxoff = PageGetMaxOffsetNumber(page);
+		gevel_progress_update(1, 0, maxoff);
+
+		for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+		{
+			IndexTuple	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+			ItemPointer	items;
+			int			nitems,
+						n;
+
+			if (GinIsPostingTree(itup))
+			{
+				if (nroots >= maxroots)
+				{
+					maxroots *= 2;
+					roots = repalloc(roots, sizeof(BlockNumber) * maxroots);
+				}
+				roots[nroots++] = GinGetPostingTree(itup);
+				continue;
+			}
+
+			nitems = GinGetNPosting(itup);
+			if (nitems == 0)
+				continue;
+			if (GinItupIsCompressed(itup))
+				items = ginPostingListDecode((GinPostingList *) GinGetPosting(itup), &nitems);
+			else
+				items = (ItemPointer) GinGetPosting(itup);
+
+			hc->lastBlock = InvalidBlockNumber;
+			for (n = 0; n < nitems; n++)
+				heap_corr_add(hc, &items[n]);
+
+			if (GinItupIsCompressed(itup))
+				pfree(items);
+		}
+		heap_corr_page_end(hc);
+
+		blkno = GinPageRightMost(page) ? InvalidBlockNumber : GinPageGetOpaque(page)->rightlink;
+		UnlockReleaseBuffer(buffer);
+	}
+
+	for (r = 0; r < nroots; r++)
+	{
+		hc->lastBlock = InvalidBlockNumber;
+		blkno = gin_leftmost_leaf(index, roots[r], true);
+
+		while (blkno != InvalidBlockNumber)
+		{
+			Buffer		buffer;
+			Page		page;
+			ItemPointerData minItem;
+			ItemPointer	items;
+			int			nitems,
+						n;
+
+			CHECK_FOR_INTERRUPTS();
+
+			buffer = ReadBuffer(index, blkno);
+			LockBuffer(buffer, GIN_SHARE);
+			page = BufferGetPage(buffer);
+
+			ItemPointerSetMin(&minItem);
+			items = GinDataLeafPageGetItems(page, &nitems, minItem);
+			gevel_progress_update(1, 0, nitems);
+			for (n = 0; n < nitems; n++)
+				heap_corr_add(hc, &items[n]);
+			heap_corr_page_end(hc);
+			pfree(items);
+
+			blkno = GinPageRightMost(page) ? InvalidBlockNumber : GinPageGetOpaque(page)->rightlink;
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+
+	pfree(roots);
+}
+
+/*
+ * How scattered the heap TIDs of a btree, GiST, SP-GiST or GIN index are:
+ * the clustering factor along the key order, how many heap blocks the
+ * TIDs of one leaf page point to, and the heap pages a scan returning
+ * SELECTIVITY of the TIDs reads, as an index scan that rereads a page at
+ * every block change, and as a bitmap scan that reads every page once.
+ * SELECT index_heap_correlation(INDEXNAME[, SELECTIVITY]);
+ */
+PG_FUNCTION_INFO_V1(index_heap_correlation);
+Datum index_heap_correlation(PG_FUNCTION_ARGS);
+Datum
+index_heap_correlation(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	double		selectivity = PG_GETARG_FLOAT8(1);
+	RangeVar	*relvar;
+	Relation	index,
+				heapRel;
+	BlockNumber	heapPages;
+	HeapCorrelation hc;
+	double		clustering = 0.0,
+				indexReads,
+				bitmapReads;
+	StringInfoData out;
+
+	if (selectivity < 0.0 || selectivity > 1.0)
+		elog(ERROR, "selectivity must be between 0 and 1");
+
+	relvar = makeRangeVarFromNameList(textToQualifiedNameList(name));
+	index = gevel_relation_openrv(relvar, AccessShareLock);
+
+	if (!IS_INDEX(index) ||
+		(index->rd_rel->relam != BTREE_AM_OID &&
+		 index->rd_rel->relam != GIST_AM_OID &&
+		 index->rd_rel->relam != SPGIST_AM_OID &&
+		 index->rd_rel->relam != GIN_AM_OID))
+		elog(ERROR, "relation \"%s\" is not a btree, GiST, SP-GiST or GIN index",
+			 RelationGetRelationName(index));
+
+	heapRel = table_open(IndexGetRelation(RelationGetRelid(index), false),
+						 AccessShareLock);
+	heapPages = RelationGetNumberOfBlocks(heapRel);
+	table_close(heapRel, AccessShareLock);
+
+	memset(&hc, 0, sizeof(HeapCorrelation));
+	hc.lastBlock = InvalidBlockNumber;
+	hc.maxblocks = 1024;
+	hc.blocks = palloc(sizeof(BlockNumber) * hc.maxblocks);
+
+	gevel_progress_start(GEVEL_PROGRESS_INDEX_HEAP_CORRELATION, index);
+	switch (index->rd_rel->relam)
+	{
+		case BTREE_AM_OID:
+			heap_corr_btree(index, &hc);
+			break;
+		case GIST_AM_OID:
+			heap_corr_gist(index, GIST_ROOT_BLKNO, &hc);
+			break;
+		case SPGIST_AM_OID:
+			heap_corr_spgist(index, &hc);
+			break;
+		case GIN_AM_OID:
+			heap_corr_gin(index, &hc);
+			break;
+	}
+	gevel_progress_end();
+
+	relation_close(index, AccessShareLock);
+
+	/* 0 when every heap page is read once, 1 when every TID reads one */
+	if (hc.tids > heapPages)
+		clustering = Min(Max((double) (hc.reads - heapPages) / (hc.tids - heapPages), 0.0), 1.0);
+
+	indexReads = ceil(selectivity * hc.reads);
+	bitmapReads = 0.0;
+	if (heapPages > 0)
+		bitmapReads = ceil(heapPages * (1.0 - pow(1.0 - 1.0 / heapPages,
+												  selectivity * hc.tids)));
+	/* a correlated heap reads fewer pages than a random one */
+	bitmapReads = Min(bitmapReads, indexReads);
+
+	initStringInfo(&out);
+	appendStringInfo(&out,
+		"Heap pages:                   %u\n"
+		"Leaf pages:                   " INT64_FORMAT "\n"
+		"Number of TIDs:               " INT64_FORMAT "\n"
+		"Clustering factor:            " INT64_FORMAT " (%.2f block changes per 100 TIDs)\n"
+		"Clustering:                   %.4f (0 heap order, 1 random)\n"
+		"Heap blocks per leaf page:    avg %.2f, max %d\n"
+		"TIDs per leaf page:           avg %.2f\n"
+		"Selectivity:                  %.2f%%\n"
+		"Projected heap reads:         %.0f (index scan), %.0f (bitmap scan)\n",
+		heapPages,
+		hc.leafPages,
+		hc.tids,
+		hc.reads, (hc.tids > 0) ? 100.0 * hc.reads / hc.tids : 0.0,
+		clustering,
+		(hc.leafPages > 0) ? (double) hc.sumBlocks / hc.leafPages : 0.0, hc.maxBlocks,
+		(hc.leafPages > 0) ? (double) hc.tids / hc.leafPages : 0.0,
+		100.0 * selectivity,
+		indexReads, bitmapReads);
+
+	pfree(hc.blocks);
+
+	PG_FREE_IF_COPY(name, 0);
+	PG_RETURN_TEXT_P(cstring_to_text(out.data));
+}
+
+/*
+ * Incremental gist_stat and btree_stat.
+ *
+ * The index is read in physical order and every page is reduced to a
+ * GevelPageSummary, which is all gist_stat and btree_stat need. The
+ * summaries are kept with the page LSN in $PGDATA/pg_gevel, one file per
+ * database and index OID, and the next run reuses the summary of every
+ * page whose LSN has not moved. The file header holds the relfilenode the
+ * summaries were taken from, so a snapshot taken before a REINDEX, VACUUM
+ * FULL or TRUNCATE is not used. A missing or stale file only means a full
+ * run. Pages without WAL (unlogged indexes, or pages never WAL-logged) are
+ * always recomputed. Files are removed by gevel_snapshot_drop() and
+ * gevel_snapshot_cleanup().
+ */
+#define GEVEL_SNAPSHOT_DIR		"pg_gevel"
+#define GEVEL_SNAPSHOT_MAGIC	0x67657653	/* "gevS" */
+#define GEVEL_SNAPSHOT_VERSION	2
+
+typedef struct GevelSnapshotHeader
+{
+	uint32		magic;
+	uint32		version;
+	Oid			relam;
+	RelFileNode	node;
+	uint32		blcksz;
+	BlockNumber	nblocks;
+} GevelSnapshotHeader;
+
+typedef void (*GevelPageSummaryFn) (BlockNumber blkno, Page page,
+									GevelPageSummary *ps);
+
+static void
+gevel_snapshot_path(Oid relid, char *path)
+{
+	snprintf(path, MAXPGPATH, "%s/%u_%u.snap", GEVEL_SNAPSHOT_DIR,
+			 MyDatabaseId, relid);
+}
+
+/* reads the header, false unless it is a snapshot of this build */
+static bool
+gevel_snapshot_header(FILE *file, GevelSnapshotHeader *hdr)
+{
+	return fread(hdr, sizeof(*hdr), 1, file) == 1 &&
+		hdr->magic == GEVEL_SNAPSHOT_MAGIC &&
+		hdr->version == GEVEL_SNAPSHOT_VERSION &&
+		hdr->blcksz == BLCKSZ &&
+		hdr->nblocks <= MaxBlockNumber;
+}
+
+static GevelPageSummary *
+gevel_snapshot_load(Relation index, BlockNumber *nblocks)
+{
+	char		path[MAXPGPATH];
+	FILE	   *file;
+	GevelSnapshotHeader hdr;
+	GevelPageSummary *summaries = NULL;
+
+	gevel_snapshot_path(RelationGetRelid(index), path);
+
+	file = AllocateFile(path, PG_BINARY_R);
+	if (file == NULL)
+		return NULL;
+
+	if (gevel_snapshot_header(file, &hdr) &&
+		hdr.relam == index->rd_rel->relam &&
+		RelFileNodeEquals(hdr.node, index->rd_node))
+	{
+		summaries = palloc(sizeof(GevelPageSummary) * Max(hdr.nblocks, 1));
+		if (fread(summaries, sizeof(GevelPageSummary), hdr.nblocks, file) != hdr.nblocks)
+		{
+			pfree(summaries);
+			summaries = NULL;
+		}
+		*nblocks = hdr.nblocks;
+	}
+
+	FreeFile(file);
+
+	if (summaries == NULL)
+		elog(DEBUG1, "ignoring unreadable gevel snapshot \"%s\"", path);
+
+	return summaries;
+}
+
+static void
+gevel_snapshot_save(Relation index, GevelPageSummary *summaries, BlockNumber nblocks)
+{
+	char		path[MAXPGPATH];
+	char		tmppath[MAXPGPATH];
+	FILE	   *file;
+	GevelSnapshotHeader hdr;
+
+	if (MakePGDirectory(GEVEL_SNAPSHOT_DIR) < 0 && errno != EEXIST)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m",
+						GEVEL_SNAPSHOT_DIR)));
+
+	gevel_snapshot_path(RelationGetRelid(index), path);
+	snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+	file = AllocateFile(tmppath, PG_BINARY_W);
+	if (file == NULL)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", tmppath)));
+
+	hdr.magic = GEVEL_SNAPSHOT_MAGIC;
+	hdr.version = GEVEL_SNAPSHOT_VERSION;
+	hdr.relam = index->rd_rel->relam;
+	hdr.node = index->rd_node;
+	hdr.blcksz = BLCKSZ;
+	hdr.nblocks = nblocks;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, file) != 1 ||
+		fwrite(summaries, sizeof(GevelPageSummary), nblocks, file) != nblocks ||
+		FreeFile(file) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", tmppath)));
+
+	durable_rename(tmppath, path, ERROR);
+}
+
+static void
+idxstat_incremental(Relation index, GevelPageSummaryFn summarize, IdxStat *info)
+{
+	GevelPageSummary *old,
+			   *cur;
+	BlockNumber	oldblocks = 0,
+				nblocks,
+				blkno,
+				reused = 0;
+	BufferAccessStrategy bstrategy = GetAccessStrategy(BAS_BULKREAD);
+
+	old = gevel_snapshot_load(index, &oldblocks);
+	if (!RelationNeedsWAL(index))
+		oldblocks = 0;
+
+	nblocks = RelationGetNumberOfBlocks(index);
+	cur = palloc(sizeof(GevelPageSummary) * Max(nblocks, 1));
+
+	for (blkno = 0; blkno < nblocks; blkno++)
+	{
+		Buffer		buf;
+		Page		page;
+		XLogRecPtr	lsn;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buf = ReadBufferExtended(index, MAIN_FORKNUM, blkno, RBM_NORMAL, bstrategy);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		lsn = PageGetLSN(page);
+
+		if (blkno < oldblocks && (old[blkno].flags & GEVEL_PAGE_VALID) &&
+			!XLogRecPtrIsInvalid(lsn) && old[blkno].lsn == lsn)
+		{
+			cur[blkno] = old[blkno];
+			reused++;
+		}
+		else
+			summarize(blkno, page, &cur[blkno]);
+
+		UnlockReleaseBuffer(buf);
+
+		idxstat_add(info, &cur[blkno]);
+		gevel_progress_update(1, -1, cur[blkno].maxoff);
+	}
+
+	FreeAccessStrategy(bstrategy);
+
+	gevel_snapshot_save(index, cur, nblocks);
+
+	elog(DEBUG1, "\"%s\": summaries of %u of %u pages reused",
+		 RelationGetRelationName(index), reused, nblocks);
+
+	if (old)
+		pfree(old);
+	pfree(cur);
+}
+
+/*
+ * gist_stat() that recomputes only pages changed since the previous call
+ * SELECT gist_stat_incremental(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(gist_stat_incremental);
+Datum gist_stat_incremental(PG_FUNCTION_ARGS);
+Datum
+gist_stat_incremental(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	IdxStat		info;
+
+	index = gist_index_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	memset(&info, 0, sizeof(IdxStat));
+
+	gevel_progress_start(GEVEL_PROGRESS_GIST_STAT, index);
+	idxstat_incremental(index, gist_page_summary, &info);
+	info.level = gist_tree_depth(index, GIST_ROOT_BLKNO);
+	gevel_progress_end();
+
+	gist_index_close(index);
+
+	PG_RETURN_POINTER(formatIdxStat(&info));
+}
+
+/*
+ * btree_stat() that recomputes only pages changed since the previous call
+ * SELECT btree_stat_incremental(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(btree_stat_incremental);
+Datum btree_stat_incremental(PG_FUNCTION_ARGS);
+Datum
+btree_stat_incremental(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Relation	index;
+	IdxStat		info;
+	Buffer		metabuf;
+	BTMetaPageData *metad;
+
+	index = btree_index_open(makeRangeVarFromNameList(textToQualifiedNameList(name)));
+
+	memset(&info, 0, sizeof(IdxStat));
+
+	metabuf = _bt_getbuf(index, BTREE_METAPAGE, BT_READ);
+	metad = BTPageGetMeta(BufferGetPage(metabuf));
+	info.level = metad->btm_level;
+	UnlockReleaseBuffer(metabuf);
+
+	gevel_progress_start(GEVEL_PROGRESS_BTREE_STAT, index);
+	idxstat_incremental(index, btree_page_summary, &info);
+	gevel_progress_end();
+
+	btree_index_close(index);
+
+	PG_RETURN_POINTER(formatIdxStat(&info));
+}
+
+/*
+ * Removes the snapshot of an index, true if there was one
+ * SELECT gevel_snapshot_drop(INDEXNAME);
+ */
+PG_FUNCTION_INFO_V1(gevel_snapshot_drop);
+Datum gevel_snapshot_drop(PG_FUNCTION_ARGS);
+Datum
+gevel_snapshot_drop(PG_FUNCTION_ARGS)
+{
+	text		*name=PG_GETARG_TEXT_PP(0);
+	Oid			relid;
+	char		path[MAXPGPATH];
+
+	relid = RangeVarGetRelid(makeRangeVarFromNameList(textToQualifiedNameList(name)),
+							 AccessShareLock, false);
+	gevel_snapshot_path(relid, path);
+
+	if (unlink(path) < 0)
+	{
+		if (errno != ENOENT)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m", path)));
+		PG_RETURN_BOOL(false);
+	}
+
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * Removes the snapshots of the current database that cannot be used any
+ * more: of dropped indexes, of rewritten indexes (another relfilenode),
+ * unreadable ones and leftovers of interrupted saves. Returns the number
+ * of files removed.
+ * SELECT gevel_snapshot_cleanup();
+ */
+PG_FUNCTION_INFO_V1(gevel_snapshot_cleanup);
+Datum gevel_snapshot_cleanup(PG_FUNCTION_ARGS);
+Datum
+gevel_snapshot_cleanup(PG_FUNCTION_ARGS)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	int32		removed = 0;
+
+	dir = AllocateDir(GEVEL_SNAPSHOT_DIR);
+	if (dir == NULL && errno == ENOENT)
+		PG_RETURN_INT32(0);
+
+	while ((de = ReadDir(dir, GEVEL_SNAPSHOT_DIR)) != NULL)
+	{
+		char		path[MAXPGPATH];
+		Oid			dbid,
+					relid,
+					relnode;
+		int			len = 0;
+		bool		stale = true;
+		Relation	index;
+
+		snprintf(path, sizeof(path), "%s/%s", GEVEL_SNAPSHOT_DIR, de->d_name);
+
+		/* the first layout, spcnode_dbnode_relnode.snap */
+		if (sscanf(de->d_name, "%u_%u_%u.snap%n", &relid, &dbid, &relnode, &len) == 3 &&
+			de->d_name[len] == '\0')
+		{
+			if (dbid != MyDatabaseId)
+				continue;
+		}
+		else if (sscanf(de->d_name, "%u_%u.snap%n", &dbid, &relid, &len) == 2 &&
+				 dbid == MyDatabaseId &&
+				 (de->d_name[len] == '\0' || strcmp(de->d_name + len, ".tmp") == 0))
+		{
+			/* the lock waits for a call that is saving this snapshot */
+			index = try_relation_open(relid, AccessShareLock);
+
+			if (index && de->d_name[len] == '\0')
+			{
+				FILE	   *file = AllocateFile(path, PG_BINARY_R);
+				GevelSnapshotHeader hdr;
+
+				if (file)
+				{
+					stale = !(index->rd_rel->relkind == RELKIND_INDEX &&
+							  gevel_snapshot_header(file, &hdr) &&
+							  hdr.relam == index->rd_rel->relam &&
+							  RelFileNodeEquals(hdr.node, index->rd_node));
+					FreeFile(file);
+				}
+			}
+			if (index)
+				relation_close(index, AccessShareLock);
+		}
+		else
+			continue;
+
+		if (!stale)
+			continue;
+
+		if (unlink(path) < 0 && errno != ENOENT)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m", path)));
+		removed++;
+	}
+
+	FreeDir(dir);
+
+	PG_RETURN_INT32(removed);
+}
+
+/*
+ * Resumable scans.
+ *
+ * gist_stat, btree_stat, gin_statpage and spgist_stat read the index in
+ * physical order and stop when a page or time budget runs out. The result
+ * is the report of what has been read so far and a continuation token:
+ * the next block and the running totals, to be passed to the next call.
+ * The token is NULL once the scan reached the end of the index. Pages
+ * added between calls are picked up at the end; pages split or deleted
+ * between calls may be counted on both sides of the split.
+ */
+#define GEVEL_TOKEN_MAGIC	0x6765764B	/* "gevK" */
+#define GEVEL_TOKEN_VERSION	1
+
+typedef struct GevelScanToken
+{
+	int32		vl_len_;		/* varlena header */
+	uint32		magic;
+	uint16		version;
+	uint16		function;		/* GevelProgressFunction */
+	Oid			relid;
+	Oid			relfilenode;
+	BlockNumber	nextblkno;
+	uint32		statesize;
+	/* running totals of the function follow */
+} GevelScanToken;
+
+typedef struct GevelBudget
+{
+	int32		pages;			/* <= 0 is no limit */
+	TimestampTz	deadline;		/* 0 is no limit */
+} GevelBudget;
+
+typedef int64 (*GevelScanPageFn) (void *state, BlockNumber blkno, Page page);
+
+static void
+gevel_budget_init(GevelBudget *budget, int32 pages, float8 msec)
+{
+	budget->pages = pages;
+	budget->deadline = 0;
+	if (msec > 0)
+		budget->deadline = TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+													   (int64) msec);
+}
+
+static bool
+gevel_budget_exhausted(GevelBudget *budget, int32 done)
+{
+	if (budget->pages > 0 && done >= budget->pages)
+		return true;
+	if (budget->deadline != 0 && GetCurrentTimestamp() >= budget->deadline)
+		return true;
+	return false;
+}
+
+/* restore the totals from a token, returns the block to start from */
+static BlockNumber
+gevel_token_restore(bytea *token, GevelProgressFunction func, Relation index,
+					void *state, Size statesize)
+{
+	GevelScanToken *tok = (GevelScanToken *) token;
+
+	if (VARSIZE(token) != sizeof(GevelScanToken) + statesize ||
+		tok->magic != GEVEL_TOKEN_MAGIC ||
+		tok->version != GEVEL_TOKEN_VERSION ||
+		tok->function != func ||
+		tok->statesize != statesize)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid continuation token")));
+
+	if (tok->relid != RelationGetRelid(index))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("continuation token belongs to another index")));
+
+	if (tok->relfilenode != index->rd_node.relNode)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("index \"%s\" was rebuilt since the scan started",
+						RelationGetRelationName(index))));
+
+	memcpy(state, ((char *) tok) + sizeof(GevelScanToken), statesize);
+
+	return tok->nextblkno;
+}
+
+static bytea *
+gevel_token_make(GevelProgressFunction func, Relation index, BlockNumber nextblkno,
+				 void *state, Size statesize)
+{
+	GevelScanToken *tok = palloc0(sizeof(GevelScanToken) + statesize);
+
+	SET_VARSIZE(tok, sizeof(GevelScanToken) + statesize);
+	tok->magic = GEVEL_TOKEN_MAGIC;
+	tok->version = GEVEL_TOKEN_VERSION;
+	tok->function = func;
+	tok->relid = RelationGetRelid(index);
+	tok->relfilenode = index->rd_node.relNode;
+	tok->nextblkno = nextblkno;
+	tok->statesize = statesize;
+	memcpy(((char *) tok) + sizeof(GevelScanToken), state, statesize);
+
+	return (bytea *) tok;
+}
+
+/*
+ * Feed the pages from startblk on to fn until the budget runs out, returns
+ * the next block to read or InvalidBlockNumber at the end of the index.
+ * At least one page is read per call, so the scan always advances.
+ */
+static BlockNumber
+gevel_budget_scan(Relation index, BlockNumber startblk, GevelBudget *budget,
+				  GevelScanPageFn fn, void *state)
+{
+	BlockNumber	nblocks = RelationGetNumberOfBlocks(index),
+				blkno;
+	int32		done = 0;
+	BufferAccessStrategy bstrategy = GetAccessStrategy(BAS_BULKREAD);
+
+	/* blocks read by the previous calls */
+	gevel_progress_update(startblk, -1, 0);
+
+	for (blkno = startblk; blkno < nblocks; blkno++)
+	{
+		Buffer		buf;
+
+		if (done > 0 && gevel_budget_exhausted(budget, done))
+			break;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buf = ReadBufferExtended(index, MAIN_FORKNUM, blkno, RBM_NORMAL, bstrategy);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		gevel_progress_update(1, -1, fn(state, blkno, BufferGetPage(buf)));
+		UnlockReleaseBuffer(buf);
+
+		done++;
+	}
+
+	FreeAccessStrategy(bstrategy);
+
+	return (blkno < nblocks) ? blkno : InvalidBlockNumber;
+}
+
+static int64
+gist_stat_scan_page(void *state, BlockNumber blkno, Page page)
+{
+	GevelPageSummary ps;
+
+	gist_page_summary(blkno, page, &ps);
+	idxstat_add((IdxStat *) state, &ps);
+
+	return ps.maxoff;
+}
+
+static int64
+btree_stat_scan_page(void *state, BlockNumber blkno, Page page)
+{
+	GevelPageSummary ps;
+
+	btree_page_summary(blkno, page, &ps);
+	idxstat_add((IdxStat *) state, &ps);
+
+	return ps.maxoff;
+}
+
+static int64
+spgist_stat_scan_page(void *state, BlockNumber blkno, Page page)
+{
+	return spgist_stat_page((SpgistStat *) state, page);
+}
+
+static int64
+gin_statpage_scan_page(void *state, BlockNumber blkno, Page page)
+{
+	return gin_statpage_page((GinStatPage *) state, page);
+}
+
+static Datum
+gevel_resumable_result(FunctionCallInfo fcinfo, text *report, bytea *token)
+{
+	TupleDesc	tupdesc;
+	Datum		values[2];
+	bool		nulls[2] = {false, false};
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = PointerGetDatum(report);
+	if (token)
+		values[1] = PointerGetDatum(token);
+	else
+		nulls[1] = true;
+
+	return HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), values, nulls));
+}
+
+/*
+ * Run one budgeted step of a resumable scan: restore the totals from the
+ * token in argument 3, read pages from there on, and return the next
+ * token or NULL when the index has been read completely.
+ */
+static bytea *
+gevel_resumable_step(FunctionCallInfo fcinfo, GevelProgressFunction func,
+					 Relation index, BlockNumber firstblk,
+					 GevelScanPageFn fn, void *state, Size statesize)
+{
+	GevelBudget	budget;
+	BlockNumber	startblk = firstblk,
+				nextblk;
+
+	gevel_budget_init(&budget,
+					  PG_ARGISNULL(1) ? 0 : PG_GETARG_INT32(1),
+					  PG_ARGISNULL(2) ? 0 : PG_GETARG_FLOAT8(2));
+
+	if (!PG_ARGISNULL(3))
+		startblk = gevel_token_restore(PG_GETARG_BYTEA_P(3), func, index,
+									   state, statesize);
+
+	gevel_progress_start(func, index);
+	nextblk = gevel_budget_scan(index, startblk, &budget, fn, state);
+	gevel_progress_end();
+
+	if (nextblk == InvalidBlockNumber)
+		return NULL;
+
+	return gevel_token_make(func, index, nextblk, state, statesize);
+}
+
+/*
+ * SELECT * FROM gist_stat(INDEXNAME, PAGE_BUDGET, TIME_BUDGET, TOKEN);
+ */
+PG_FUNCTION_INFO_V1(gist_stat_resume);
+Datum gist_stat_resume(PG_FUNCTION_ARGS);
+Datum
+gist_stat_resume(PG_FUNCTION_ARGS)
+{
+	Relation	index;
+	IdxStat		info;
+	bytea	   *token;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	index = gist_index_open(makeRangeVarFromNameList(
+							textToQualifiedNameList(PG_GETARG_TEXT_PP(0))));
+
+	memset(&info, 0, sizeof(IdxStat));
+	token = gevel_resumable_step(fcinfo, GEVEL_PROGRESS_GIST_STAT, index,
+								 GIST_ROOT_BLKNO, gist_stat_scan_page,
+								 &info, sizeof(IdxStat));
+	info.level = gist_tree_depth(index, GIST_ROOT_BLKNO);
+
+	gist_index_close(index);
+
+	PG_RETURN_DATUM(gevel_resumable_result(fcinfo, formatIdxStat(&info), token));
+}
+
+/*
+ * SELECT * FROM btree_stat(INDEXNAME, PAGE_BUDGET, TIME_BUDGET, TOKEN);
+ */
+PG_FUNCTION_INFO_V1(btree_stat_resume);
+Datum btree_stat_resume(PG_FUNCTION_ARGS);
+Datum
+btree_stat_resume(PG_FUNCTION_ARGS)
+{
+	Relation	index;
+	IdxStat		info;
+	bytea	   *token;
+	Buffer		metabuf;
+	BTMetaPageData *metad;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	index = btree_index_open(makeRangeVarFromNameList(
+							 textToQualifiedNameList(PG_GETARG_TEXT_PP(0))));
+
+	memset(&info, 0, sizeof(IdxStat));
+	token = gevel_resumable_step(fcinfo, GEVEL_PROGRESS_BTREE_STAT, index,
+								 BTREE_METAPAGE, btree_stat_scan_page,
+								 &info, sizeof(IdxStat));
+
+	metabuf = _bt_getbuf(index, BTREE_METAPAGE, BT_READ);
+	metad = BTPageGetMeta(BufferGetPage(metabuf));
+	info.level = metad->btm_level;
+	UnlockReleaseBuffer(metabuf);
+
+	btree_index_close(index);
+
+	PG_RETURN_DATUM(gevel_resumable_result(fcinfo, formatIdxStat(&info), token));
+}
+
+/*
+ * SELECT * FROM spgist_stat(INDEXNAME, PAGE_BUDGET, TIME_BUDGET, TOKEN);
+ */
+PG_FUNCTION_INFO_V1(spgist_stat_resume);
+Datum spgist_stat_resume(PG_FUNCTION_ARGS);
+Datum
+spgist_stat_resume(PG_FUNCTION_ARGS)
+{
+	Relation	index;
+	SpgistStat	st;
+	bytea	   *token;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	index = spgist_stat_open(PG_GETARG_TEXT_PP(0));
+
+	spgist_stat_init(&st);
+	token = gevel_resumable_step(fcinfo, GEVEL_PROGRESS_SPGIST_STAT, index,
+								 SPGIST_ROOT_BLKNO, spgist_stat_scan_page,
+								 &st, sizeof(SpgistStat));
+
+	index_close(index, AccessExclusiveLock);
+
+	PG_RETURN_DATUM(gevel_resumable_result(fcinfo, spgist_stat_text(&st), token));
+}
+
+/*
+ * SELECT * FROM gin_statpage(INDEXNAME, PAGE_BUDGET, TIME_BUDGET, TOKEN);
+ */
+PG_FUNCTION_INFO_V1(gin_statpage_resume);
+Datum gin_statpage_resume(PG_FUNCTION_ARGS);
+Datum
+gin_statpage_resume(PG_FUNCTION_ARGS)
+{
+	Relation	index;
+	GinStatPage	gs;
+	bytea	   *token;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	index = gin_statpage_open(PG_GETARG_TEXT_PP(0));
+
+	memset(&gs, 0, sizeof(GinStatPage));
+	token = gevel_resumable_step(fcinfo, GEVEL_PROGRESS_GIN_STATPAGE, index,
+								 GIN_ROOT_BLKNO, gin_statpage_scan_page,
+								 &gs, sizeof(GinStatPage));
+
+	index_close(index, AccessExclusiveLock);
+
+	PG_RETURN_DATUM(gevel_resumable_result(fcinfo, gin_statpage_text(&gs), token));
 }
 #endif
@@ -0,0 +1,19 @@
+SET search_path = public;
+BEGIN;
+
+create or replace function hash_stat(text)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function hash_print(text,
+        out bucket bigint, out blkno bigint, out overflow_pages int,
+        out tuples bigint, out dead_tuples bigint,
+        out primary_fill float8, out overflow_fill float8)
+        returns setof record
+        as '$libdir/gevel'
+        language C
+        strict;
+
+END;
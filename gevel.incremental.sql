@@ -0,0 +1,27 @@
+SET search_path = public;
+BEGIN;
+
+create or replace function gist_stat_incremental(text)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function btree_stat_incremental(text)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function gevel_snapshot_drop(text)
+        returns bool
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function gevel_snapshot_cleanup()
+        returns int4
+        as '$libdir/gevel'
+        language C;
+
+END;
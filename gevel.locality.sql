@@ -0,0 +1,16 @@
+SET search_path = public;
+BEGIN;
+
+create or replace function leaf_chain_stat(text)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function index_heap_correlation(text, selectivity float8 default 0.01)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
+END;
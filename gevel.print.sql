@@ -0,0 +1,15 @@
+SET search_path = public;
+BEGIN;
+
+create or replace function gist_print(text, min_level int, max_level int, blkno int default 0)
+        returns setof record
+        as '$libdir/gevel'
+        language C
+        strict;
+
+create or replace function btree_print_range(text, lower anyelement, upper anyelement, pivots bool default false)
+        returns setof record
+        as '$libdir/gevel'
+        language C;
+
+END;
@@ -0,0 +1,52 @@
+SET search_path = public;
+BEGIN;
+
+create or replace view pg_stat_progress_gevel as
+        select s.pid, s.datid, d.datname, s.relid,
+               case s.param2
+                    when 1 then 'gist_tree'
+                    when 2 then 'gist_stat'
+                    when 3 then 'gist_print'
+                    when 4 then 'gin_stat'
+                    when 5 then 'gin_statpage'
+                    when 6 then 'spgist_stat'
+                    when 7 then 'spgist_print'
+                    when 8 then 'spgist_level_stat'
+                    when 9 then 'btree_stat'
+                    when 10 then 'btree_tree'
+                    when 11 then 'btree_print'
+                    when 12 then 'brin_stat'
+                    when 13 then 'brin_print'
+                    when 14 then 'brin_overlap_stat'
+                    when 15 then 'brin_query_estimate'
+                    when 16 then 'brin_summary_stat'
+                    when 17 then 'brin_summary_print'
+                    when 18 then 'brin_ppr_advisor'
+                    when 19 then 'hash_stat'
+                    when 20 then 'hash_print'
+                    when 21 then 'gevel_survey'
+                    when 22 then 'btree_dedup_stat'
+                    when 23 then 'btree_pivot_stat'
+                    when 24 then 'btree_prefix_stat'
+                    when 25 then 'btree_bloat_stat'
+                    when 26 then 'leaf_chain_stat'
+                    when 27 then 'index_heap_correlation'
+               end as function,
+               case s.param3
+                    when 1 then 'scanning index'
+                    when 2 then 'scanning heap'
+               end as phase,
+               s.param16 as blocks_total,
+               s.param17 as blocks_done,
+               s.param18 as current_level,
+               s.param13 as tuples_done
+        from pg_stat_get_progress_info('CREATE INDEX') as s
+             left join pg_database d on s.datid = d.oid
+        where s.param20 = 1734702700;
+
+create or replace function gevel_instrument_last()
+        returns text
+        as '$libdir/gevel'
+        language C;
+
+END;
@@ -0,0 +1,32 @@
+SET search_path = public;
+BEGIN;
+
+create or replace function gist_stat(text,
+        page_budget int, time_budget float8 default 0, resume_token bytea default null,
+        out stat text, out token bytea)
+        returns record
+        as '$libdir/gevel', 'gist_stat_resume'
+        language C;
+
+create or replace function btree_stat(text,
+        page_budget int, time_budget float8 default 0, resume_token bytea default null,
+        out stat text, out token bytea)
+        returns record
+        as '$libdir/gevel', 'btree_stat_resume'
+        language C;
+
+create or replace function gin_statpage(text,
+        page_budget int, time_budget float8 default 0, resume_token bytea default null,
+        out stat text, out token bytea)
+        returns record
+        as '$libdir/gevel', 'gin_statpage_resume'
+        language C;
+
+create or replace function spgist_stat(text,
+        page_budget int, time_budget float8 default 0, resume_token bytea default null,
+        out stat text, out token bytea)
+        returns record
+        as '$libdir/gevel', 'spgist_stat_resume'
+        language C;
+
+END;
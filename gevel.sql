@@ -61,4 +61,10 @@ create or replace function spgist_print(text)
         language C
         strict;
 
+create or replace function spgist_level_stat(text)
+        returns text
+        as '$libdir/gevel'
+        language C
+        strict;
+
 END;
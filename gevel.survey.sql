@@ -0,0 +1,17 @@
+SET search_path = public;
+BEGIN;
+
+create or replace function gevel_survey(schema_pattern text,
+        am_list text[] default '{btree,hash,gist,gin,spgist,brin}',
+        cost_delay float8 default 0, cost_limit int default 200,
+        out schemaname text, out indexname text, out tablename text,
+        out am text, out pages bigint, out other_pages bigint,
+        out inner_pages bigint, out leaf_pages bigint,
+        out deleted_pages bigint, out levels int, out tuples bigint,
+        out dead_tuples bigint, out leaf_fill float8, out free_bytes bigint)
+        returns setof record
+        as '$libdir/gevel'
+        language C
+        strict;
+
+END;
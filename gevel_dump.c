@@ -0,0 +1,704 @@
+/*
+ * gevel_dump - gevel statistics of an index read straight from its files
+ *
+ *	gevel_dump [-a AM] [-j JOBS] [-t [-l MAXLEVEL]] FILE
+ *
+ * FILE is the first segment of an index relation (base/<db>/<relfilenode>
+ * of a stopped cluster, a base backup or any cold copy); FILE.1, FILE.2,
+ * ... are picked up as well. The segments are mapped read-only and the
+ * pages are accounted with the same code as the SQL functions (see
+ * gevel_page.h), so no server, buffer manager or catalog is needed.
+ *
+ * The default output is the report of gist_stat, btree_stat, gin_statpage
+ * or spgist_stat; -t prints gist_tree or btree_tree instead. BRIN gets a
+ * report of its own, as brin_stat needs the heap. With -j the physical
+ * scan is split over threads, one segment at a time.
+ */
+#define FRONTEND 1
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "access/brin_page.h"
+#include "access/gin_private.h"
+#include "access/gist.h"
+#include "access/gist_private.h"
+#include "access/nbtree.h"
+#include "access/spgist_private.h"
+#include "storage/bufpage.h"
+
+#include "gevel_page.h"
+
+#if PG_VERSION_NUM < 120000
+#error "gevel_dump needs PostgreSQL 12 or later"
+#endif
+
+/* a tree deeper than that can only come from a corrupted file */
+#define MAX_TREE_DEPTH	64
+
+typedef enum
+{
+	AM_UNKNOWN,
+	AM_GIST,
+	AM_BTREE,
+	AM_GIN,
+	AM_SPGIST,
+	AM_BRIN
+} DumpAm;
+
+static const char *const am_names[] = {"", "gist", "btree", "gin", "spgist", "brin"};
+
+typedef struct Segment
+{
+	char	   *base;
+	size_t		size;
+	BlockNumber	nblocks;
+} Segment;
+
+typedef struct IndexFile
+{
+	const char *path;
+	int			nsegs;
+	Segment    *segs;
+	BlockNumber	nblocks;
+} IndexFile;
+
+/* totals of the offline BRIN report */
+typedef struct BrinStat
+{
+	BlockNumber	pagesPerRange;
+	uint32		revmapPages,
+				regularPages,
+				summarizedRanges,
+				numTuples;
+	uint64		usedSpace,
+				freeSpace;
+} BrinStat;
+
+/* running totals of one scan job */
+typedef struct DumpStat
+{
+	IdxStat		idx;
+	SpgistStat	spgist;
+	GinStatPage	gin;
+	BrinStat	brin;
+	uint32		badPages;
+} DumpStat;
+
+typedef struct DumpJob
+{
+	IndexFile  *file;
+	DumpAm		am;
+	int			firstseg;
+	int			step;
+	DumpStat	st;
+} DumpJob;
+
+static void
+pg_attribute_noreturn()
+fatal(const char *fmt,...)
+pg_attribute_printf(1, 2);
+
+static void
+fatal(const char *fmt,...)
+{
+	va_list		ap;
+
+	fprintf(stderr, "gevel_dump: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static void
+usage(void)
+{
+	printf("gevel_dump prints gevel statistics of an index read from its files.\n\n"
+		   "Usage:\n"
+		   "  gevel_dump [OPTION]... FILE\n\n"
+		   "Options:\n"
+		   "  -a AM        access method: gist, btree, gin, spgist or brin\n"
+		   "               (default: detected from the first page)\n"
+		   "  -j JOBS      number of threads, each one reads whole segments\n"
+		   "  -t           print the tree (gist and btree) instead of statistics\n"
+		   "  -l MAXLEVEL  with -t, do not print below MAXLEVEL\n"
+		   "  -h           show this help and exit\n");
+}
+
+/*
+ * Map every segment of the relation. All segments but the last one must
+ * be full, as in a cluster.
+ */
+static void
+map_index(const char *path, IndexFile *file)
+{
+	int			maxsegs = 8;
+
+	file->path = path;
+	file->nsegs = 0;
+	file->nblocks = 0;
+	file->segs = pg_malloc(sizeof(Segment) * maxsegs);
+
+	for (;;)
+	{
+		char		segpath[MAXPGPATH];
+		struct stat	sb;
+		Segment    *seg;
+		int			fd;
+
+		if (file->nsegs == 0)
+			strlcpy(segpath, path, sizeof(segpath));
+		else
+			snprintf(segpath, sizeof(segpath), "%s.%d", path, file->nsegs);
+
+		fd = open(segpath, O_RDONLY | PG_BINARY, 0);
+		if (fd < 0)
+		{
+			if (file->nsegs > 0 && errno == ENOENT)
+				break;
+			fatal("could not open file \"%s\": %m", segpath);
+		}
+
+		if (fstat(fd, &sb) < 0)
+			fatal("could not stat file \"%s\": %m", segpath);
+
+		if (sb.st_size % BLCKSZ != 0)
+			fprintf(stderr, "gevel_dump: file \"%s\" has a partial last block, ignored\n",
+					segpath);
+
+		if (file->nsegs > 0 && file->segs[file->nsegs - 1].nblocks != RELSEG_SIZE)
+			fatal("segment before \"%s\" is not full", segpath);
+
+		if (file->nsegs == maxsegs)
+		{
+			maxsegs *= 2;
+			file->segs = pg_realloc(file->segs, sizeof(Segment) * maxsegs);
+		}
+
+		seg = &file->segs[file->nsegs];
+		seg->nblocks = sb.st_size / BLCKSZ;
+		seg->size = (size_t) seg->nblocks * BLCKSZ;
+		seg->base = NULL;
+
+		if (seg->size > 0)
+		{
+			seg->base = mmap(NULL, seg->size, PROT_READ, MAP_SHARED, fd, 0);
+			if (seg->base == MAP_FAILED)
+				fatal("could not map file \"%s\": %m", segpath);
+			(void) madvise(seg->base, seg->size, MADV_SEQUENTIAL);
+		}
+
+		close(fd);
+
+		file->nblocks += seg->nblocks;
+		file->nsegs++;
+
+		if (seg->nblocks < RELSEG_SIZE)
+			break;
+	}
+}
+
+static void
+unmap_index(IndexFile *file)
+{
+	int			i;
+
+	for (i = 0; i < file->nsegs; i++)
+		if (file->segs[i].base)
+			munmap(file->segs[i].base, file->segs[i].size);
+	pg_free(file->segs);
+}
+
+/*
+ * A page whose header does not add up is not handed to the accounting
+ * code, which trusts pd_special and the line pointers.
+ */
+static bool
+page_is_sane(Page page)
+{
+	PageHeader	phdr = (PageHeader) page;
+
+	if (PageIsNew(page))
+		return true;
+
+	return PageGetPageSize(page) == BLCKSZ &&
+		phdr->pd_lower >= SizeOfPageHeaderData &&
+		phdr->pd_lower <= phdr->pd_upper &&
+		phdr->pd_upper <= phdr->pd_special &&
+		phdr->pd_special <= BLCKSZ &&
+		phdr->pd_special == MAXALIGN(phdr->pd_special);
+}
+
+static Page
+get_page(IndexFile *file, BlockNumber blkno)
+{
+	Segment    *seg;
+	Page		page;
+
+	if (blkno >= file->nblocks)
+		fatal("block %u is beyond the end of \"%s\" (%u blocks)",
+			  blkno, file->path, file->nblocks);
+
+	seg = &file->segs[blkno / RELSEG_SIZE];
+	page = (Page) (seg->base + (size_t) (blkno % RELSEG_SIZE) * BLCKSZ);
+
+	if (!page_is_sane(page))
+		fatal("block %u of \"%s\" has a corrupted page header", blkno, file->path);
+
+	return page;
+}
+
+/* guess the access method from the first page */
+static DumpAm
+detect_am(IndexFile *file)
+{
+	Page		page;
+	Size		special;
+
+	if (file->nblocks == 0)
+		fatal("file \"%s\" is empty", file->path);
+
+	page = get_page(file, 0);
+	if (PageIsNew(page))
+		return AM_UNKNOWN;
+
+	special = PageGetSpecialSize(page);
+
+	if (special == MAXALIGN(sizeof(GISTPageOpaqueData)) &&
+		GistPageGetOpaque(page)->gist_page_id == GIST_PAGE_ID)
+		return AM_GIST;
+
+	if (special == MAXALIGN(sizeof(SpGistPageOpaqueData)) &&
+		SpGistPageGetOpaque(page)->spgist_page_id == SPGIST_PAGE_ID)
+		return AM_SPGIST;
+
+	if (special == MAXALIGN(sizeof(BrinSpecialSpace)) &&
+		BrinPageType(page) == BRIN_PAGETYPE_META &&
+		((BrinMetaPageData *) PageGetContents(page))->brinMagic == BRIN_META_MAGIC)
+		return AM_BRIN;
+
+	if (special == MAXALIGN(sizeof(BTPageOpaqueData)) &&
+		(((BTPageOpaque) PageGetSpecialPointer(page))->btpo_flags & BTP_META) &&
+		BTPageGetMeta(page)->btm_magic == BTREE_MAGIC)
+		return AM_BTREE;
+
+	if (special == MAXALIGN(sizeof(GinPageOpaqueData)) &&
+		GinPageGetOpaque(page)->flags == GIN_META)
+		return AM_GIN;
+
+	return AM_UNKNOWN;
+}
+
+static void
+brin_page_account(BrinStat *st, Page page)
+{
+	if (PageIsNew(page))
+		return;
+
+	switch (BrinPageType(page))
+	{
+		case BRIN_PAGETYPE_REVMAP:
+			{
+				RevmapContents *contents = (RevmapContents *) PageGetContents(page);
+				int			i;
+
+				st->revmapPages++;
+				for (i = 0; i < REVMAP_PAGE_MAXITEMS; i++)
+					if (ItemPointerIsValid(&contents->rm_tids[i]))
+						st->summarizedRanges++;
+				break;
+			}
+		case BRIN_PAGETYPE_REGULAR:
+			{
+				OffsetNumber off,
+							maxoff = PageGetMaxOffsetNumber(page);
+
+				st->regularPages++;
+				st->freeSpace += PageGetFreeSpace(page);
+				for (off = FirstOffsetNumber; off <= maxoff; off = OffsetNumberNext(off))
+				{
+					ItemId		iid = PageGetItemId(page, off);
+
+					if (ItemIdIsUsed(iid))
+					{
+						st->numTuples++;
+						st->usedSpace += ItemIdGetLength(iid);
+					}
+				}
+				break;
+			}
+	}
+}
+
+static void
+account_page(DumpAm am, DumpStat *st, BlockNumber blkno, Page page)
+{
+	GevelPageSummary ps;
+
+	if (!page_is_sane(page))
+	{
+		st->badPages++;
+		return;
+	}
+
+	switch (am)
+	{
+		case AM_GIST:
+			gist_page_summary(blkno, page, &ps);
+			idxstat_add(&st->idx, &ps);
+			break;
+		case AM_BTREE:
+			btree_page_summary(blkno, page, &ps);
+			idxstat_add(&st->idx, &ps);
+			break;
+		case AM_SPGIST:
+			/* the metapage is not counted */
+			if (blkno >= SPGIST_ROOT_BLKNO)
+				(void) spgist_stat_page(&st->spgist, page);
+			break;
+		case AM_GIN:
+			if (blkno >= GIN_ROOT_BLKNO)
+				(void) gin_statpage_page(&st->gin, page);
+			break;
+		case AM_BRIN:
+			brin_page_account(&st->brin, page);
+			break;
+		default:
+			break;
+	}
+}
+
+static void *
+scan_job(void *arg)
+{
+	DumpJob    *job = (DumpJob *) arg;
+	int			segno;
+
+	for (segno = job->firstseg; segno < job->file->nsegs; segno += job->step)
+	{
+		Segment    *seg = &job->file->segs[segno];
+		BlockNumber	i;
+
+		for (i = 0; i < seg->nblocks; i++)
+			account_page(job->am, &job->st, (BlockNumber) segno * RELSEG_SIZE + i,
+						 (Page) (seg->base + (size_t) i * BLCKSZ));
+	}
+
+	return NULL;
+}
+
+/* add the totals of one job to the others */
+static void
+merge_stat(DumpStat *dst, DumpStat *src)
+{
+	dst->idx.numpages += src->idx.numpages;
+	dst->idx.numleafpages += src->idx.numleafpages;
+	dst->idx.numtuple += src->idx.numtuple;
+	dst->idx.numinvalidtuple += src->idx.numinvalidtuple;
+	dst->idx.numleaftuple += src->idx.numleaftuple;
+	dst->idx.tuplesize += src->idx.tuplesize;
+	dst->idx.leaftuplesize += src->idx.leaftuplesize;
+	dst->idx.totalsize += src->idx.totalsize;
+
+	dst->spgist.totalPages += src->spgist.totalPages;
+	dst->spgist.innerPages += src->spgist.innerPages;
+	dst->spgist.leafPages += src->spgist.leafPages;
+	dst->spgist.emptyPages += src->spgist.emptyPages;
+	dst->spgist.deletedPages += src->spgist.deletedPages;
+	dst->spgist.usedSpace += src->spgist.usedSpace;
+	dst->spgist.usedLeafSpace += src->spgist.usedLeafSpace;
+	dst->spgist.usedInnerSpace += src->spgist.usedInnerSpace;
+	dst->spgist.bufferSize = Max(dst->spgist.bufferSize, src->spgist.bufferSize);
+	dst->spgist.innerTuples += src->spgist.innerTuples;
+	dst->spgist.leafTuples += src->spgist.leafTuples;
+	dst->spgist.nAllTheSame += src->spgist.nAllTheSame;
+	dst->spgist.nLeafPlaceholder += src->spgist.nLeafPlaceholder;
+	dst->spgist.nInnerPlaceholder += src->spgist.nInnerPlaceholder;
+	dst->spgist.nLeafRedirect += src->spgist.nLeafRedirect;
+	dst->spgist.nInnerRedirect += src->spgist.nInnerRedirect;
+
+	dst->gin.totalPages += src->gin.totalPages;
+	dst->gin.deletedPages += src->gin.deletedPages;
+	dst->gin.emptyDataPages += src->gin.emptyDataPages;
+	dst->gin.entryPages += src->gin.entryPages;
+	dst->gin.dataPages += src->gin.dataPages;
+	dst->gin.dataInnerPages += src->gin.dataInnerPages;
+	dst->gin.dataLeafPages += src->gin.dataLeafPages;
+	dst->gin.entryInnerPages += src->gin.entryInnerPages;
+	dst->gin.entryLeafPages += src->gin.entryLeafPages;
+	dst->gin.dataInnerFreeSpace += src->gin.dataInnerFreeSpace;
+	dst->gin.dataLeafFreeSpace += src->gin.dataLeafFreeSpace;
+	dst->gin.dataInnerTuplesCount += src->gin.dataInnerTuplesCount;
+	dst->gin.dataLeafIptrsCount += src->gin.dataLeafIptrsCount;
+	dst->gin.entryInnerFreeSpace += src->gin.entryInnerFreeSpace;
+	dst->gin.entryLeafFreeSpace += src->gin.entryLeafFreeSpace;
+	dst->gin.entryInnerTuplesCount += src->gin.entryInnerTuplesCount;
+	dst->gin.entryLeafTuplesCount += src->gin.entryLeafTuplesCount;
+	dst->gin.entryPostingSize += src->gin.entryPostingSize;
+	dst->gin.entryPostingCount += src->gin.entryPostingCount;
+	dst->gin.entryAttrSize += src->gin.entryAttrSize;
+
+	dst->brin.revmapPages += src->brin.revmapPages;
+	dst->brin.regularPages += src->brin.regularPages;
+	dst->brin.summarizedRanges += src->brin.summarizedRanges;
+	dst->brin.numTuples += src->brin.numTuples;
+	dst->brin.usedSpace += src->brin.usedSpace;
+	dst->brin.freeSpace += src->brin.freeSpace;
+
+	dst->badPages += src->badPages;
+}
+
+/* number of levels below the root, following the leftmost downlinks */
+static int
+gist_depth(IndexFile *file)
+{
+	BlockNumber	blkno = GIST_ROOT_BLKNO;
+	int			depth = 0;
+
+	for (;;)
+	{
+		Page		page = get_page(file, blkno);
+		IndexTuple	itup;
+
+		if (PageIsNew(page) || GistPageIsLeaf(page) ||
+			PageGetMaxOffsetNumber(page) < FirstOffsetNumber)
+			break;
+
+		if (++depth > MAX_TREE_DEPTH)
+			fatal("GiST tree of \"%s\" is deeper than %d levels", file->path,
+				  MAX_TREE_DEPTH);
+
+		itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, FirstOffsetNumber));
+		blkno = ItemPointerGetBlockNumber(&itup->t_tid);
+	}
+
+	return depth;
+}
+
+static void
+print_stat(IndexFile *file, DumpAm am, int njobs)
+{
+	DumpJob    *jobs = pg_malloc0(sizeof(DumpJob) * njobs);
+	pthread_t  *threads = pg_malloc(sizeof(pthread_t) * njobs);
+	DumpStat	st;
+	char		buf[2048];
+	int			i;
+
+	for (i = 0; i < njobs; i++)
+	{
+		jobs[i].file = file;
+		jobs[i].am = am;
+		jobs[i].firstseg = i;
+		jobs[i].step = njobs;
+		spgist_stat_init(&jobs[i].st.spgist);
+
+		if (njobs > 1 && pthread_create(&threads[i], NULL, scan_job, &jobs[i]) != 0)
+			fatal("could not create thread: %m");
+	}
+
+	if (njobs == 1)
+		scan_job(&jobs[0]);
+	else
+		for (i = 0; i < njobs; i++)
+			pthread_join(threads[i], NULL);
+
+	st = jobs[0].st;
+	for (i = 1; i < njobs; i++)
+		merge_stat(&st, &jobs[i].st);
+
+	switch (am)
+	{
+		case AM_GIST:
+			st.idx.level = gist_depth(file);
+			idxstat_format(&st.idx, buf, sizeof(buf));
+			break;
+		case AM_BTREE:
+			st.idx.level = BTPageGetMeta(get_page(file, BTREE_METAPAGE))->btm_level;
+			idxstat_format(&st.idx, buf, sizeof(buf));
+			break;
+		case AM_SPGIST:
+			spgist_stat_format(&st.spgist, buf, sizeof(buf));
+			strlcat(buf, "\n", sizeof(buf));
+			break;
+		case AM_GIN:
+			gin_statpage_format(&st.gin, buf, sizeof(buf));
+			break;
+		case AM_BRIN:
+			st.brin.pagesPerRange =
+				((BrinMetaPageData *) PageGetContents(get_page(file, BRIN_METAPAGE_BLKNO)))->pagesPerRange;
+			snprintf(buf, sizeof(buf),
+					 "Pages per range:		%u\n"
+					 "Number of revmap pages:	%u\n"
+					 "Number of regular pages:	%u\n"
+					 "Number of summarized ranges:	%u\n"
+					 "Number of tuples: 		%u\n"
+					 "Used space 		" INT64_FORMAT " bytes\n"
+					 "Free space 		" INT64_FORMAT " bytes\n",
+					 st.brin.pagesPerRange,
+					 st.brin.revmapPages,
+					 st.brin.regularPages,
+					 st.brin.summarizedRanges,
+					 st.brin.numTuples,
+					 st.brin.usedSpace,
+					 st.brin.freeSpace);
+			break;
+		default:
+			break;
+	}
+
+	fputs(buf, stdout);
+
+	if (st.badPages > 0)
+		fprintf(stderr, "gevel_dump: %u pages with a corrupted header were skipped\n",
+				st.badPages);
+
+	pg_free(jobs);
+	pg_free(threads);
+}
+
+/* the output of gist_tree() */
+static void
+gist_print_tree(IndexFile *file, int level, BlockNumber blk, OffsetNumber coff,
+				int maxlevel)
+{
+	Page		page = get_page(file, blk);
+	OffsetNumber i,
+				maxoff;
+
+	if (level > MAX_TREE_DEPTH)
+		fatal("GiST tree of \"%s\" is deeper than %d levels", file->path,
+			  MAX_TREE_DEPTH);
+
+	maxoff = PageGetMaxOffsetNumber(page);
+
+	printf(GIST_TREE_LINE,
+		   psprintf("%*s", level * 4, ""),
+		   coff,
+		   level,
+		   blk,
+		   (int) maxoff,
+		   (int) PageGetFreeSpace(page),
+		   100.0 * (((float) PAGESIZE) - (float) PageGetFreeSpace(page)) / ((float) PAGESIZE),
+		   GistPageGetOpaque(page)->rightlink,
+		   (GistPageGetOpaque(page)->rightlink == InvalidBlockNumber) ? "InvalidBlockNumber" : "OK");
+
+	if (!GistPageIsLeaf(page) && (maxlevel < 0 || level < maxlevel))
+		for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+		{
+			IndexTuple	which = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+
+			gist_print_tree(file, level + 1, ItemPointerGetBlockNumber(&which->t_tid),
+							i, maxlevel);
+		}
+}
+
+/* the output of btree_tree() */
+static void
+btree_print_tree(IndexFile *file, int level, BlockNumber blk, int maxlevel)
+{
+	Page		page = get_page(file, blk);
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	OffsetNumber i,
+				maxoff;
+
+	if (level > MAX_TREE_DEPTH)
+		fatal("btree of \"%s\" is deeper than %d levels", file->path,
+			  MAX_TREE_DEPTH);
+
+	maxoff = PageGetMaxOffsetNumber(page);
+
+	printf(BTREE_TREE_LINE, level, blk, (int) maxoff);
+
+	if (!P_ISLEAF(opaque) && (maxlevel < 0 || level < maxlevel))
+		for (i = P_FIRSTDATAKEY(opaque); i <= maxoff; i = OffsetNumberNext(i))
+		{
+			IndexTuple	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+
+#if PG_VERSION_NUM >= 140000
+			btree_print_tree(file, level + 1, BTreeTupleGetDownLink(itup), maxlevel);
+#else
+			btree_print_tree(file, level + 1,
+							 ItemPointerGetBlockNumberNoCheck(&itup->t_tid), maxlevel);
+#endif
+		}
+}
+
+int
+main(int argc, char **argv)
+{
+	IndexFile	file;
+	DumpAm		am = AM_UNKNOWN;
+	int			njobs = 1;
+	bool		tree = false;
+	int			maxlevel = -1;
+	int			c;
+
+	while ((c = getopt(argc, argv, "a:j:tl:h")) != -1)
+	{
+		switch (c)
+		{
+			case 'a':
+				for (am = AM_GIST; am <= AM_BRIN; am++)
+					if (strcmp(optarg, am_names[am]) == 0)
+						break;
+				if (am > AM_BRIN)
+					fatal("unsupported access method \"%s\"", optarg);
+				break;
+			case 'j':
+				njobs = atoi(optarg);
+				if (njobs < 1)
+					fatal("number of jobs must be at least 1");
+				break;
+			case 't':
+				tree = true;
+				break;
+			case 'l':
+				maxlevel = atoi(optarg);
+				break;
+			case 'h':
+				usage();
+				exit(0);
+			default:
+				fprintf(stderr, "Try \"gevel_dump -h\" for more information.\n");
+				exit(1);
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "gevel_dump: exactly one index file is needed\n");
+		fprintf(stderr, "Try \"gevel_dump -h\" for more information.\n");
+		exit(1);
+	}
+
+	map_index(argv[optind], &file);
+
+	if (am == AM_UNKNOWN)
+		am = detect_am(&file);
+	if (am == AM_UNKNOWN)
+		fatal("could not recognize the index in \"%s\", use -a", file.path);
+
+	if (njobs > file.nsegs)
+		njobs = file.nsegs;
+
+	if (!tree)
+		print_stat(&file, am, njobs);
+	else if (am == AM_GIST)
+		gist_print_tree(&file, 0, GIST_ROOT_BLKNO, 0, maxlevel);
+	else if (am == AM_BTREE)
+		btree_print_tree(&file, 0,
+						 BTPageGetMeta(get_page(&file, BTREE_METAPAGE))->btm_root,
+						 maxlevel);
+	else
+		fatal("-t is supported for gist and btree only");
+
+	unmap_index(&file);
+
+	return 0;
+}
@@ -0,0 +1,486 @@
+/*
+ * gevel_page.h
+ *
+ * Page level accounting shared by the gevel extension and the gevel_dump
+ * tool. Everything here looks at one page image at a time and never
+ * touches the buffer manager or the catalogs, so the same code runs
+ * inside the backend and on relation files read from disk. The includer
+ * provides postgres.h (or postgres_fe.h) and the access method headers.
+ */
+#ifndef GEVEL_PAGE_H
+#define GEVEL_PAGE_H
+
+#define PAGESIZE	(BLCKSZ - MAXALIGN(sizeof(PageHeaderData) + sizeof(ItemIdData)))
+
+/* one line of gist_tree() and of btree_tree() */
+#define GIST_TREE_LINE	"%s%d(l:%d) blk: %u numTuple: %d free: %db(%.2f%%) rightlink:%u (%s)\n"
+#define BTREE_TREE_LINE	"lvl: %d, blk: %d, numTuples: %d\n"
+
+typedef struct {
+	int		level;
+	int		numpages;
+	int		numleafpages;
+	int		numtuple;
+	int		numinvalidtuple;
+	int		numleaftuple;
+	uint64	tuplesize;
+	uint64	leaftuplesize;
+	uint64	totalsize;
+} IdxStat;
+
+/* report of gist_stat() and btree_stat() */
+static inline void
+idxstat_format(IdxStat *info, char *buf, size_t len) {
+	snprintf(buf, len,
+		"Number of levels:          %d\n"
+		"Number of pages:           %d\n"
+		"Number of leaf pages:      %d\n"
+		"Number of tuples:          %d\n"
+		"Number of invalid tuples:  %d\n"
+		"Number of leaf tuples:     %d\n"
+		"Total size of tuples:      "INT64_FORMAT" bytes\n"
+		"Total size of leaf tuples: "INT64_FORMAT" bytes\n"
+		"Total size of index:       "INT64_FORMAT" bytes\n",
+		info->level+1,
+		info->numpages,
+		info->numleafpages,
+		info->numtuple,
+		info->numinvalidtuple,
+		info->numleaftuple,
+		info->tuplesize,
+		info->leaftuplesize,
+		info->totalsize);
+}
+
+#if PG_VERSION_NUM >= 90200
+/* running totals of spgist_stat, per page in physical order */
+typedef struct SpgistStat
+{
+	BlockNumber totalPages,
+				innerPages,
+				leafPages,
+				emptyPages,
+				deletedPages;
+	double	  usedSpace,
+			  usedLeafSpace,
+			  usedInnerSpace;
+	int		 bufferSize;
+	int64	   innerTuples,
+				leafTuples,
+				nAllTheSame,
+				nLeafPlaceholder,
+				nInnerPlaceholder,
+				nLeafRedirect,
+				nInnerRedirect;
+} SpgistStat;
+
+static inline void
+spgist_stat_init(SpgistStat *st)
+{
+	memset(st, 0, sizeof(SpgistStat));
+	st->bufferSize = -1;
+}
+
+/* account one page of the index, returns its number of tuples */
+static inline int64
+spgist_stat_page(SpgistStat *st, Page page)
+{
+	int		 pageFree;
+
+	st->totalPages++;
+
+	if (PageIsNew(page) || SpGistPageIsDeleted(page))
+	{
+		st->deletedPages++;
+		return 0;
+	}
+
+	if (SpGistPageIsLeaf(page))
+	{
+		st->leafPages++;
+		st->leafTuples += PageGetMaxOffsetNumber(page);
+		st->nLeafPlaceholder += SpGistPageGetOpaque(page)->nPlaceholder;
+		st->nLeafRedirect += SpGistPageGetOpaque(page)->nRedirection;
+	}
+	else
+	{
+		int	 i,
+				max;
+
+		st->innerPages++;
+		max = PageGetMaxOffsetNumber(page);
+		st->innerTuples += max;
+		st->nInnerPlaceholder += SpGistPageGetOpaque(page)->nPlaceholder;
+		st->nInnerRedirect += SpGistPageGetOpaque(page)->nRedirection;
+		for (i = FirstOffsetNumber; i <= max; i++)
+		{
+			SpGistInnerTuple it;
+
+			it = (SpGistInnerTuple) PageGetItem(page,
+												PageGetItemId(page, i));
+			if (it->allTheSame)
+				st->nAllTheSame++;
+		}
+	}
+
+	if (st->bufferSize < 0)
+		st->bufferSize = BLCKSZ
+			- MAXALIGN(sizeof(SpGistPageOpaqueData))
+			- SizeOfPageHeaderData;
+
+	pageFree = PageGetExactFreeSpace(page);
+
+	st->usedSpace += st->bufferSize - pageFree;
+	if (SpGistPageIsLeaf(page))
+		st->usedLeafSpace += st->bufferSize - pageFree;
+	else
+		st->usedInnerSpace += st->bufferSize - pageFree;
+
+	if (pageFree == st->bufferSize)
+		st->emptyPages++;
+
+	return PageGetMaxOffsetNumber(page);
+}
+
+/* report of spgist_stat() */
+static inline void
+spgist_stat_format(SpgistStat *st, char *buf, size_t len)
+{
+	snprintf(buf, len,
+			 "totalPages:        %u\n"
+			 "deletedPages:      %u\n"
+			 "innerPages:        %u\n"
+			 "leafPages:         %u\n"
+			 "emptyPages:        %u\n"
+			 "usedSpace:         %.2f kbytes\n"
+			 "usedInnerSpace:    %.2f kbytes\n"
+			 "usedLeafSpace:     %.2f kbytes\n"
+			 "freeSpace:         %.2f kbytes\n"
+			 "fillRatio:         %.2f%%\n"
+			 "leafTuples:        " INT64_FORMAT "\n"
+			 "innerTuples:       " INT64_FORMAT "\n"
+			 "innerAllTheSame:   " INT64_FORMAT "\n"
+			 "leafPlaceholders:  " INT64_FORMAT "\n"
+			 "innerPlaceholders: " INT64_FORMAT "\n"
+			 "leafRedirects:     " INT64_FORMAT "\n"
+			 "innerRedirects:    " INT64_FORMAT,
+			 st->totalPages, st->deletedPages, st->innerPages,
+			 st->leafPages, st->emptyPages,
+			 st->usedSpace / 1024.0,
+			 st->usedInnerSpace / 1024.0,
+			 st->usedLeafSpace / 1024.0,
+			 (((double) st->bufferSize) * ((double) st->totalPages) - st->usedSpace) / 1024,
+			 100.0 * (st->usedSpace / (((double) st->bufferSize) * ((double) st->totalPages))),
+			 st->leafTuples, st->innerTuples, st->nAllTheSame,
+			 st->nLeafPlaceholder, st->nInnerPlaceholder,
+			 st->nLeafRedirect, st->nInnerRedirect);
+}
+#endif
+
+#if PG_VERSION_NUM >= 90400
+/* running totals of gin_statpage, per page in physical order */
+typedef struct GinStatPage
+{
+	uint32		totalPages,
+#if PG_VERSION_NUM >= 100000
+				deletedPages,
+				emptyDataPages,
+#endif
+				entryPages,
+				dataPages,
+				dataInnerPages,
+				dataLeafPages,
+				entryInnerPages,
+				entryLeafPages
+				;
+	uint64		dataInnerFreeSpace,
+				dataLeafFreeSpace,
+				dataInnerTuplesCount,
+				dataLeafIptrsCount,
+				entryInnerFreeSpace,
+				entryLeafFreeSpace,
+				entryInnerTuplesCount,
+				entryLeafTuplesCount,
+				entryPostingSize,
+				entryPostingCount,
+				entryAttrSize
+				;
+} GinStatPage;
+
+/* number of heap pointers on a GIN data leaf page */
+static inline int
+gin_data_leaf_nitems(Page page)
+{
+#ifndef FRONTEND
+	ItemPointerData minItem, *ptr;
+	int nlist;
+
+	ItemPointerSetMin(&minItem);
+
+	ptr = GinDataLeafPageGetItems(page, &nlist, minItem);
+	if (ptr == NULL)
+		return 0;
+
+	pfree(ptr);
+	return nlist;
+#else
+	/*
+	 * The decoder lives in the backend: count the items of the varbyte
+	 * encoded segments instead, every delta ends with a byte whose high
+	 * bit is clear.
+	 */
+	int			nitems = 0;
+
+	if (GinPageIsCompressed(page))
+	{
+		GinPostingList *seg = GinDataLeafPageGetPostingList(page);
+		Size		len = GinDataLeafPageGetPostingListSize(page);
+		char	   *end = ((char *) seg) + len;
+
+		while ((char *) seg < end)
+		{
+			uint16		i;
+
+			nitems++;			/* the uncompressed first item */
+			for (i = 0; i < seg->nbytes; i++)
+				if ((seg->bytes[i] & 0x80) == 0)
+					nitems++;
+			seg = GinNextPostingListSegment(seg);
+		}
+	}
+	else
+		nitems = GinPageGetOpaque(page)->maxoff;
+
+	return nitems;
+#endif
+}
+
+/* account one page of the index, returns its number of entry tuples */
+static inline int64
+gin_statpage_page(GinStatPage *gs, Page page)
+{
+	PageHeader	header = (PageHeader) page;
+
+	gs->totalPages++;
+
+#if PG_VERSION_NUM >= 100000
+	if (GinPageIsDeleted(page))
+	{
+		gs->deletedPages++;
+	}
+	else
+#endif
+	if (GinPageIsData(page))
+	{
+		gs->dataPages++;
+		if (GinPageIsLeaf(page))
+		{
+			int nlist = gin_data_leaf_nitems(page);
+
+			gs->dataLeafPages++;
+			gs->dataLeafFreeSpace += header->pd_upper - header->pd_lower;
+
+			if (nlist > 0)
+				gs->dataLeafIptrsCount += nlist;
+#if PG_VERSION_NUM >= 100000
+			else
+				gs->emptyDataPages++;
+#endif
+		}
+		else
+		{
+			gs->dataInnerPages++;
+			gs->dataInnerFreeSpace += header->pd_upper - header->pd_lower;
+			gs->dataInnerTuplesCount += GinPageGetOpaque(page)->maxoff;
+		}
+	}
+	else
+	{
+		IndexTuple itup;
+		OffsetNumber i, maxoff;
+
+		maxoff = PageGetMaxOffsetNumber(page);
+
+		gs->entryPages++;
+		if (GinPageIsLeaf(page))
+		{
+			gs->entryLeafPages++;
+			gs->entryLeafFreeSpace += header->pd_upper - header->pd_lower;
+			gs->entryLeafTuplesCount += maxoff;
+		}
+		else
+		{
+			gs->entryInnerPages++;
+			gs->entryInnerFreeSpace += header->pd_upper - header->pd_lower;
+			gs->entryInnerTuplesCount += maxoff;
+		}
+
+		for (i = 1; i <= maxoff; i++)
+		{
+			itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, i));
+
+			if (GinPageIsLeaf(page))
+			{
+				GinPostingList *list = (GinPostingList *)GinGetPosting(itup);
+				gs->entryPostingCount += GinGetNPosting(itup);
+				gs->entryPostingSize += SizeOfGinPostingList(list);
+				gs->entryAttrSize += GinGetPostingOffset(itup) - IndexInfoFindDataOffset((itup)->t_info);
+			}
+			else
+			{
+				gs->entryAttrSize += IndexTupleSize(itup) - IndexInfoFindDataOffset((itup)->t_info);
+			}
+		}
+
+		return maxoff;
+	}
+
+	return 0;
+}
+
+/* report of gin_statpage() */
+static inline void
+gin_statpage_format(GinStatPage *gs, char *buf, size_t len)
+{
+	snprintf(buf, len,
+			 "totalPages:			%u\n"
+#if PG_VERSION_NUM >= 100000
+			 "deletedPages:		  %u\n"
+			 "emptyDataPages:		%u\n"
+#endif
+			 "dataPages:			 %u\n"
+			 "dataInnerPages:		%u\n"
+			 "dataLeafPages:		 %u\n"
+			 "dataInnerFreeSpace:	" INT64_FORMAT "\n"
+			 "dataLeafFreeSpace:	 " INT64_FORMAT "\n"
+			 "dataInnerTuplesCount:  " INT64_FORMAT "\n"
+			 "dataLeafIptrsCount:	" INT64_FORMAT "\n"
+			 "entryPages:			%u\n"
+			 "entryInnerPages:	   %u\n"
+			 "entryLeafPages:		%u\n"
+			 "entryInnerFreeSpace:   " INT64_FORMAT "\n"
+			 "entryLeafFreeSpace:	" INT64_FORMAT "\n"
+			 "entryInnerTuplesCount: " INT64_FORMAT "\n"
+			 "entryLeafTuplesCount:  " INT64_FORMAT "\n"
+			 "entryPostingSize:	  " INT64_FORMAT "\n"
+			 "entryPostingCount:	 " INT64_FORMAT "\n"
+			 "entryAttrSize:		 " INT64_FORMAT "\n"
+			 ,
+			 gs->totalPages,
+#if PG_VERSION_NUM >= 100000
+			 gs->deletedPages,
+			 gs->emptyDataPages,
+#endif
+			 gs->dataPages,
+			 gs->dataInnerPages,
+			 gs->dataLeafPages,
+			 gs->dataInnerFreeSpace,
+			 gs->dataLeafFreeSpace,
+			 gs->dataInnerTuplesCount,
+			 gs->dataLeafIptrsCount,
+			 gs->entryPages,
+			 gs->entryInnerPages,
+			 gs->entryLeafPages,
+			 gs->entryInnerFreeSpace,
+			 gs->entryLeafFreeSpace,
+			 gs->entryInnerTuplesCount,
+			 gs->entryLeafTuplesCount,
+			 gs->entryPostingSize,
+			 gs->entryPostingCount,
+			 gs->entryAttrSize
+			 );
+}
+#endif
+
+#if PG_VERSION_NUM >= 120000
+#define GEVEL_PAGE_VALID		0x01	/* summary is filled in */
+#define GEVEL_PAGE_COUNTED		0x02	/* page is part of the tree */
+#define GEVEL_PAGE_LEAF			0x04
+
+/* what gist_stat and btree_stat need to know about one page */
+typedef struct GevelPageSummary
+{
+	XLogRecPtr	lsn;
+	uint16		flags;
+	uint16		maxoff;
+	uint16		ninvalid;
+	int32		used;			/* bytes counted in "Total size of tuples" */
+} GevelPageSummary;
+
+static inline void
+gist_page_summary(BlockNumber blkno, Page page, GevelPageSummary *ps)
+{
+	OffsetNumber i;
+
+	memset(ps, 0, sizeof(*ps));
+	ps->lsn = PageGetLSN(page);
+	ps->flags = GEVEL_PAGE_VALID;
+
+	if (PageIsNew(page) || GistPageIsDeleted(page))
+		return;
+
+	ps->flags |= GEVEL_PAGE_COUNTED;
+	ps->maxoff = PageGetMaxOffsetNumber(page);
+	ps->used = (int32) (PAGESIZE - PageGetFreeSpace(page));
+
+	if (GistPageIsLeaf(page))
+		ps->flags |= GEVEL_PAGE_LEAF;
+	else
+		for (i = FirstOffsetNumber; i <= ps->maxoff; i = OffsetNumberNext(i))
+			if (GistTupleIsInvalid((IndexTuple) PageGetItem(page, PageGetItemId(page, i))))
+				ps->ninvalid++;
+}
+
+static inline void
+btree_page_summary(BlockNumber blkno, Page page, GevelPageSummary *ps)
+{
+	BTPageOpaque opaque;
+	OffsetNumber i;
+
+	memset(ps, 0, sizeof(*ps));
+	ps->lsn = PageGetLSN(page);
+	ps->flags = GEVEL_PAGE_VALID;
+
+	if (blkno == BTREE_METAPAGE || PageIsNew(page))
+		return;
+
+	/* deleted and half-dead pages are not reachable from the root */
+	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	if (P_IGNORE(opaque))
+		return;
+
+	ps->flags |= GEVEL_PAGE_COUNTED;
+	ps->maxoff = PageGetMaxOffsetNumber(page);
+	ps->used = (int32) (BTMaxItemSize(page) - PageGetFreeSpace(page));
+
+	if (P_ISLEAF(opaque))
+		ps->flags |= GEVEL_PAGE_LEAF;
+	else
+		for (i = P_FIRSTDATAKEY(opaque); i <= ps->maxoff; i = OffsetNumberNext(i))
+			if (!ItemIdIsValid(PageGetItemId(page, i)))
+				ps->ninvalid++;
+}
+
+/* the same arithmetic as gist_stattree() and btree_deep_search() */
+static inline void
+idxstat_add(IdxStat *info, GevelPageSummary *ps)
+{
+	if ((ps->flags & GEVEL_PAGE_COUNTED) == 0)
+		return;
+
+	info->numpages++;
+	info->tuplesize += (int64) ps->used;
+	info->totalsize += BLCKSZ;
+	info->numtuple += ps->maxoff;
+	info->numinvalidtuple += ps->ninvalid;
+
+	if (ps->flags & GEVEL_PAGE_LEAF)
+	{
+		info->numleafpages++;
+		info->leaftuplesize += (int64) ps->used;
+		info->numleaftuple += ps->maxoff;
+	}
+}
+#endif
+
+#endif							/* GEVEL_PAGE_H */
@@ -0,0 +1,30 @@
+# gist_print and btree_print open the index with AccessShareLock: they
+# run while a transaction that has inserted into the table, and so holds
+# RowExclusiveLock on its indexes, is still open.
+
+setup
+{
+  CREATE FUNCTION gist_print(text) RETURNS setof record AS '$libdir/gevel' LANGUAGE C STRICT;
+  CREATE FUNCTION btree_print(text) RETURNS setof record AS '$libdir/gevel' LANGUAGE C STRICT;
+  CREATE TABLE gevelc AS SELECT i AS v, box(point(i, i), point(i + 1, i + 1)) AS b FROM generate_series(1, 1000) i;
+  CREATE INDEX gevelc_gist ON gevelc USING gist ( b );
+  CREATE INDEX gevelc_btree ON gevelc USING btree ( v );
+}
+
+teardown
+{
+  DROP TABLE gevelc;
+  DROP FUNCTION gist_print(text);
+  DROP FUNCTION btree_print(text);
+}
+
+session "s1"
+step "s1_begin"		{ BEGIN; }
+step "s1_insert"	{ INSERT INTO gevelc VALUES (1001, box(point(1001, 1001), point(1002, 1002))); }
+step "s1_commit"	{ COMMIT; }
+
+session "s2"
+step "s2_gist_print"	{ SELECT count(*) > 1000 AS printed FROM gist_print('gevelc_gist') AS t(level int, valid bool, a box); }
+step "s2_btree_print"	{ SELECT count(*) > 1000 AS printed FROM btree_print('gevelc_btree') AS t(level int, valid bool, a int); }
+
+permutation "s1_begin" "s1_insert" "s2_gist_print" "s2_btree_print" "s1_commit"
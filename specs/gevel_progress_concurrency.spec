@@ -0,0 +1,31 @@
+# A walker reports its progress as CREATE INDEX: another session sees it
+# in the slots pg_stat_progress_gevel reads (function 4 is gin_stat,
+# phase 1 is scanning index) and in the usual columns of
+# pg_stat_progress_create_index, whose lockers columns stay zero. A
+# target list gin_stat in a cursor is held open between two FETCHes.
+
+setup
+{
+  CREATE FUNCTION gin_stat(text) RETURNS setof record AS '$libdir/gevel' LANGUAGE C STRICT;
+  CREATE TABLE gevelp AS SELECT ARRAY[i % 10] AS a FROM generate_series(1, 100) i;
+  CREATE INDEX gevelp_gin ON gevelp USING gin ( a );
+}
+
+teardown
+{
+  DROP TABLE gevelp;
+  DROP FUNCTION gin_stat(text);
+}
+
+session "s1"
+step "s1_begin"		{ BEGIN; }
+step "s1_declare"	{ DECLARE c CURSOR FOR SELECT gin_stat('gevelp_gin') IS NOT NULL AS fetched; }
+step "s1_fetch"		{ FETCH 2 FROM c; }
+step "s1_move"		{ MOVE ALL IN c; }
+step "s1_commit"	{ COMMIT; }
+
+session "s2"
+step "s2_gevel"		{ SELECT param2 AS function, param3 AS phase, param16 > 0 AS blocks, param13 AS tuples_done FROM pg_stat_get_progress_info('CREATE INDEX') WHERE param20 = 1734702700; }
+step "s2_create_index"	{ SELECT phase, lockers_total, lockers_done, current_locker_pid, index_relid = 'gevelp_gin'::regclass AS index, blocks_total > 0 AS blocks, tuples_done FROM pg_stat_progress_create_index; }
+
+permutation "s1_begin" "s1_declare" "s1_fetch" "s2_gevel" "s2_create_index" "s1_move" "s2_gevel" "s1_commit"
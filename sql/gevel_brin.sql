@@ -12,3 +12,24 @@ CREATE INDEX brin_idx ON gevelb USING brin ( t );
 
 SELECT brin_stat('brin_idx');
 SELECT brin_print('brin_idx');
+
+CREATE TABLE gevelbm AS SELECT i AS v FROM generate_series(1, 100000) i;
+CREATE INDEX brin_minmax_idx ON gevelbm USING brin ( v ) WITH ( pages_per_range = 16 );
+
+SELECT brin_overlap_stat('brin_idx') ~ 'Not a minmax column' AS skipped;
+SELECT brin_overlap_stat('brin_minmax_idx') ~ 'Average overlapping ranges: +0.00' AS no_overlap;
+SELECT brin_overlap_stat('brin_minmax_idx') ~ 'Heap pages per point query: +16.00' AS one_range;
+SELECT brin_overlap_stat('brin_minmax_idx') ~ 'Most-overlapping ranges:\n    blk: 0 overlaps: 0 min: 1 ' AS ties_in_heap_order;
+SELECT * FROM brin_query_estimate('brin_minmax_idx', '<(int4,int4)', 100);
+SELECT * FROM brin_query_estimate('brin_minmax_idx', '=(int4,int4)', 50000);
+
+--the column has to be named when several have the operator
+CREATE TABLE gevelbw AS SELECT i AS v, 100001 - i AS w FROM generate_series(1, 100000) i;
+CREATE INDEX brin_two_idx ON gevelbw USING brin ( v, w ) WITH ( pages_per_range = 16 );
+SELECT * FROM brin_query_estimate('brin_two_idx', '<(int4,int4)', 100);
+SELECT * FROM brin_query_estimate('brin_two_idx', '<(int4,int4)', 100, 'v');
+SELECT * FROM brin_query_estimate('brin_two_idx', '<(int4,int4)', 100, 'w');
+SELECT * FROM brin_query_estimate('brin_two_idx', '<(int4,int4)', 100, 'x');
+DROP TABLE gevelbw;
+SELECT brin_ppr_advisor('gevelbm', 'v', '{16,128}') ~ 'pages_per_range: 16' AS ppr16;
+SELECT brin_ppr_advisor('gevelbm', 'v', '{16,128}') ~ 'Pages scanned, point: +16.0' AS point16;
@@ -0,0 +1,30 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.brin.sql
+\set ECHO all
+RESET client_min_messages;
+
+CREATE TABLE gevels AS SELECT i AS v, i % 100 AS w FROM generate_series(1, 10000) i;
+CREATE INDEX gevels_bloom ON gevels USING brin ( w int4_bloom_ops(n_distinct_per_range = 100) ) WITH ( pages_per_range = 8 );
+CREATE INDEX gevels_multi ON gevels USING brin ( v int4_minmax_multi_ops(values_per_range = 16) ) WITH ( pages_per_range = 8 );
+CREATE INDEX gevels_minmax ON gevels USING brin ( v ) WITH ( pages_per_range = 8 );
+
+--one row per summarized range, the decoded summaries are consistent
+SELECT opclass, count(*) = ceil(pg_relation_size('gevels') / current_setting('block_size')::float8 / 8) AS all_ranges,
+       count(DISTINCT nbits) AS filter_sizes, bool_and(nbits_set > 0 AND nbits_set <= nbits) AS bits_set,
+       bool_and(false_positive_rate > 0 AND false_positive_rate < 1) AS fpr,
+       bool_and(ndistinct BETWEEN 50 AND 200) AS ndistinct
+  FROM brin_summary_print('gevels_bloom') GROUP BY opclass;
+SELECT opclass, count(*) = ceil(pg_relation_size('gevels') / current_setting('block_size')::float8 / 8) AS all_ranges,
+       max(maxvalues) AS maxvalues, bool_and(nranges > 0 AND 2 * nranges + nvalues <= maxvalues) AS fits
+  FROM brin_summary_print('gevels_multi') GROUP BY opclass;
+SELECT count(*) FROM brin_summary_print('gevels_minmax');
+
+SELECT substring(brin_summary_stat('gevels_bloom') from 'Opclass: +(\w+)') AS opclass,
+       substring(brin_summary_stat('gevels_bloom') from 'Number of summaries: +(\d+)')::int =
+       (SELECT count(*) FROM brin_summary_print('gevels_bloom')) AS summaries;
+SELECT substring(brin_summary_stat('gevels_multi') from 'Opclass: +(\w+)') AS opclass,
+       substring(brin_summary_stat('gevels_multi') from 'Values per range: +(\d+)')::int AS values_per_range;
+SELECT brin_summary_stat('gevels_minmax') ~ 'Not a bloom or minmax_multi column' AS skipped;
+
+DROP TABLE gevels;
@@ -16,3 +16,19 @@ CREATE INDEX btree_idx ON test__val USING btree ( a );
 SELECT btree_stat('btree_idx');
 SELECT btree_tree('btree_idx');
 SELECT * FROM btree_print('btree_idx') as t(level int, valid bool, a int[]) where level=1;
+SELECT btree_stat('btree_idx', true) = btree_stat('btree_idx') AS sequential;
+SELECT heap_tids = (SELECT count(*) FROM test__val) AS all_tids, posting_tuples + plain_tuples = tuples AS leaf_tuples FROM btree_dedup_stat('btree_idx') WHERE level = 0;
+SELECT count(*) FROM btree_dedup_stat('btree_idx') WHERE level IS NULL;
+SELECT level, pages, downlinks, truncated_pivots = 0 AS single_column, growth_to_next_level > 1 AS can_grow FROM btree_pivot_stat('btree_idx');
+CREATE TABLE gevelm AS SELECT i % 10 AS a, i % 100 AS b, i AS c FROM generate_series(1, 10000) i;
+INSERT INTO gevelm SELECT 1, 1, i FROM generate_series(1, 500) i;
+CREATE INDEX gevelm_idx ON gevelm USING btree ( a, b, c );
+SELECT * FROM btree_prefix_stat('gevelm_idx');
+DROP TABLE gevelm;
+CREATE TABLE gevelb AS SELECT i AS v FROM generate_series(1, 20000) i;
+CREATE INDEX gevelb_idx ON gevelb USING btree ( v );
+SELECT btree_bloat_stat('gevelb_idx') ~ 'Deleted pages: +0\n' AS no_deleted, btree_bloat_stat('gevelb_idx') ~ 'LP_DEAD items at level 0 : +0 of 20000 ' AS no_dead;
+DELETE FROM gevelb WHERE v <= 15000;
+VACUUM gevelb;
+SELECT btree_bloat_stat('gevelb_idx') ~ 'Deleted pages: +[1-9]' AS deleted;
+DROP TABLE gevelb;
@@ -0,0 +1,26 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.btree.sql
+\set ECHO all
+RESET client_min_messages;
+
+--a thousand duplicates of every key, deduplicated from PostgreSQL 13 on
+CREATE TABLE geveld AS SELECT i % 10 AS v, i AS u FROM generate_series(1, 10000) i;
+CREATE INDEX geveld_btree ON geveld USING btree ( v );
+
+SELECT heap_tids, posting_tuples > 0 AS posting_lists, posting_tuples + plain_tuples = tuples AS leaf_tuples,
+	coalesce(avg_posting_length, 0) > 1 AS long_lists, bytes_saved > 0 AS saved
+	FROM btree_dedup_stat('geveld_btree') WHERE level = 0;
+SELECT heap_tids, posting_tuples FROM btree_dedup_stat('geveld_btree') WHERE level > 0;
+SELECT t.heap_tids = l.heap_tids AND t.bytes_saved = l.bytes_saved AS total
+	FROM btree_dedup_stat('geveld_btree') t, btree_dedup_stat('geveld_btree') l
+	WHERE t.level IS NULL AND l.level = 0;
+
+--unique keys leave nothing to deduplicate
+CREATE UNIQUE INDEX geveld_unique ON geveld USING btree ( u );
+SELECT heap_tids, posting_tuples, bytes_saved FROM btree_dedup_stat('geveld_unique') WHERE level IS NULL;
+
+CREATE INDEX geveld_nodedup ON geveld USING btree ( v ) WITH (deduplicate_items = off);
+SELECT heap_tids, posting_tuples, bytes_saved FROM btree_dedup_stat('geveld_nodedup') WHERE level IS NULL;
+
+DROP TABLE geveld;
@@ -0,0 +1,16 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.hash.sql
+\set ECHO all
+RESET client_min_messages;
+
+CREATE TABLE gevelh AS SELECT i % 1000 AS v FROM generate_series(1, 20000) i;
+
+--Hash
+CREATE INDEX hash_idx ON gevelh USING hash ( v );
+
+SELECT hash_stat('hash_idx') ~ 'Number of tuples: +20000' AS tuples;
+SELECT hash_stat('hash_idx') ~ 'Number of dead tuples: +0' AS no_dead;
+SELECT sum(tuples), sum(dead_tuples), count(*) = count(DISTINCT blkno) AS distinct_pages FROM hash_print('hash_idx');
+
+DROP TABLE gevelh;
@@ -0,0 +1,39 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.btree.sql
+\i gevel.incremental.sql
+\set ECHO all
+RESET client_min_messages;
+
+CREATE TABLE geveli AS SELECT i AS v, point(i % 100, i / 100) AS p FROM generate_series(1, 10000) i;
+
+CREATE INDEX geveli_btree ON geveli USING btree ( v );
+CREATE INDEX geveli_gist ON geveli USING gist ( p );
+
+--no snapshot yet
+SELECT btree_stat_incremental('geveli_btree') = btree_stat('geveli_btree') AS btree_full;
+SELECT gist_stat_incremental('geveli_gist') = gist_stat('geveli_gist') AS gist_full;
+
+--nothing changed
+SELECT btree_stat_incremental('geveli_btree') = btree_stat('geveli_btree') AS btree_same;
+SELECT gist_stat_incremental('geveli_gist') = gist_stat('geveli_gist') AS gist_same;
+
+INSERT INTO geveli SELECT i, point(i % 37, i / 37) FROM generate_series(10001, 15000) i;
+
+--some pages changed, some were added
+SELECT btree_stat_incremental('geveli_btree') = btree_stat('geveli_btree') AS btree_changed;
+SELECT gist_stat_incremental('geveli_gist') = gist_stat('geveli_gist') AS gist_changed;
+SELECT btree_stat_incremental('geveli_btree') ~ 'Number of leaf tuples: +15000' AS btree_tuples;
+
+--a rewritten index does not use its old snapshot, cleanup removes it
+REINDEX INDEX geveli_gist;
+SELECT gevel_snapshot_cleanup() AS removed;
+SELECT gist_stat_incremental('geveli_gist') = gist_stat('geveli_gist') AS gist_reindexed;
+
+SELECT gevel_snapshot_drop('geveli_btree') AS dropped;
+SELECT gevel_snapshot_drop('geveli_btree') AS dropped_again;
+
+DROP TABLE geveli;
+
+--the snapshot of the dropped gist index
+SELECT gevel_snapshot_cleanup() AS removed;
@@ -0,0 +1,29 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.btree.sql
+\i gevel.progress.sql
+\set ECHO all
+RESET client_min_messages;
+
+CREATE TABLE geveln AS SELECT i AS v FROM generate_series(1, 10000) i;
+CREATE INDEX geveln_btree ON geveln USING btree ( v );
+
+SET gevel.instrument = on;
+SHOW gevel.instrument;
+SET track_io_timing = off;
+
+--the NOTICE carries timings, the report is checked through gevel_instrument_last()
+SET client_min_messages = warning;
+SELECT btree_stat('geveln_btree') ~ 'Number of leaf tuples: +10000' AS leaf_tuples;
+RESET client_min_messages;
+SELECT regexp_replace(regexp_replace(l, '\d+\.\d+ ms', 'N ms', 'g'), '(hit|read|dirtied)=\d+', '\1=N', 'g') AS report
+	FROM regexp_split_to_table(gevel_instrument_last(), E'\n') AS l WHERE l !~ '^Peak Memory';
+
+SET client_min_messages = warning;
+SELECT count(*) > 10000 AS all_tuples FROM btree_print('geveln_btree') AS t(level int, valid bool, a int);
+RESET client_min_messages;
+SELECT gevel_instrument_last() ~ '^btree_print\(geveln_btree\): ' AS btree_print_report;
+
+RESET track_io_timing;
+RESET gevel.instrument;
+DROP TABLE geveln;
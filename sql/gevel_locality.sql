@@ -0,0 +1,51 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.locality.sql
+\set ECHO all
+RESET client_min_messages;
+
+CREATE TABLE gevell AS SELECT i AS v, box(point(i % 100, i / 100), point(i % 100 + 1, i / 100 + 1)) AS b, ARRAY[i % 2] AS a FROM generate_series(1, 10000) i;
+
+CREATE INDEX gevell_btree ON gevell USING btree ( v );
+CREATE INDEX gevell_gist ON gevell USING gist ( b );
+CREATE INDEX gevell_gin ON gevell USING gin ( a );
+
+--every chain starts with a random read, every link is counted once
+SELECT idx, m[1] AS chain, m[2]::int >= 1 AS chains, m[3]::int >= m[2]::int AS pages,
+       m[5]::int = m[3]::int - m[2]::int AS links_add_up
+  FROM unnest('{gevell_btree,gevell_gist,gevell_gin}'::text[]) idx,
+       regexp_matches(leaf_chain_stat(idx),
+                      'Leaf chain: +([^\n]+)\nNumber of chains: +(\d+)\nNumber of leaf pages: +(\d+)\nLinks to next block: +(\d+) of (\d+)', 'g') m;
+
+--random inserts split pages to the end of the index
+CREATE TABLE gevell_split (v int);
+CREATE INDEX gevell_split_btree ON gevell_split USING btree ( v );
+INSERT INTO gevell_split SELECT (i * 7919) % 10000 FROM generate_series(1, 10000) i;
+
+SELECT substring(leaf_chain_stat('gevell_btree') from 'Links to next block: +\d+ of \d+ \(([0-9.]+)%\)')::float8 >
+       substring(leaf_chain_stat('gevell_split_btree') from 'Links to next block: +\d+ of \d+ \(([0-9.]+)%\)')::float8 AS built_in_order;
+
+SELECT leaf_chain_stat('gevell');
+
+CREATE TABLE gevelhc AS SELECT i AS v, (i * 7919) % 10000 AS w, point(i % 100, i / 100) AS p FROM generate_series(1, 10000) i;
+
+CREATE INDEX gevelhc_v ON gevelhc USING btree ( v );
+CREATE INDEX gevelhc_w ON gevelhc USING btree ( w );
+CREATE INDEX gevelhc_p ON gevelhc USING spgist ( p );
+
+--every TID is counted once
+SELECT idx, substring(index_heap_correlation(idx) from 'Number of TIDs: +(\d+)')::int AS tids
+  FROM unnest('{gevelhc_v,gevelhc_w,gevelhc_p,gevell_gist,gevell_gin}'::text[]) idx;
+
+--an index in heap order reads every heap page once
+SELECT substring(index_heap_correlation('gevelhc_v') from 'Clustering: +([0-9.]+)')::float8 < 0.1 AS v_clustered,
+       substring(index_heap_correlation('gevelhc_w') from 'Clustering: +([0-9.]+)')::float8 > 0.5 AS w_random;
+SELECT substring(index_heap_correlation('gevelhc_v', 1) from 'Clustering factor: +(\d+)') =
+       substring(index_heap_correlation('gevelhc_v', 1) from 'Projected heap reads: +(\d+)') AS full_scan;
+
+SELECT index_heap_correlation('gevelhc_v', 2);
+SELECT index_heap_correlation('gevelhc');
+
+DROP TABLE gevell;
+DROP TABLE gevell_split;
+DROP TABLE gevelhc;
@@ -0,0 +1,90 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.print.sql
+\i gevel.progress.sql
+\set ECHO all
+RESET client_min_messages;
+
+CREATE TABLE gevelq AS SELECT i AS v, box(point(i % 100, i / 100), point(i % 100 + 1, i / 100 + 1)) AS b FROM generate_series(1, 10000) i;
+
+CREATE INDEX gevelq_gist ON gevelq USING gist ( b );
+
+--same rows as filtering the full dump
+SELECT (SELECT count(*) FROM gist_print('gevelq_gist', 1, 1) AS t(level int, valid bool, a box)) =
+       (SELECT count(*) FROM gist_print('gevelq_gist') AS t(level int, valid bool, a box) WHERE level = 1) AS root_only;
+SELECT (SELECT count(*) FROM gist_print('gevelq_gist', 2, 100) AS t(level int, valid bool, a box)) =
+       (SELECT count(*) FROM gist_print('gevelq_gist') AS t(level int, valid bool, a box) WHERE level >= 2) AS below_root;
+SELECT (SELECT count(*) FROM gist_print('gevelq_gist', 1, 100, 0) AS t(level int, valid bool, a box)) =
+       (SELECT count(*) FROM gist_print('gevelq_gist') AS t(level int, valid bool, a box)) AS from_root;
+SELECT count(*) FROM gist_print('gevelq_gist', 2, 1) AS t(level int, valid bool, a box);
+
+SELECT * FROM gist_print('gevelq_gist', 1, 1, 100000) AS t(level int, valid bool, a box);
+SELECT * FROM gist_print('gevelq_gist', 1, 1, -1) AS t(level int, valid bool, a box);
+
+--a leaf block: its own tuples only, at the leaf level
+WITH p AS (SELECT m[1]::int AS l, m[2]::int AS blk, m[3]::int AS ntuples
+             FROM regexp_matches(gist_tree('gevelq_gist'), '\(l:(\d+)\) blk: (\d+) numTuple: (\d+)', 'g') AS m),
+     leaf AS (SELECT * FROM p WHERE l = (SELECT max(l) FROM p) ORDER BY blk LIMIT 1)
+SELECT count(*) = (SELECT ntuples FROM leaf) AS leaf_tuples, bool_and(level = (SELECT l + 1 FROM leaf)) AS leaf_level
+  FROM gist_print('gevelq_gist', 1, 100, (SELECT blk FROM leaf)) AS t(level int, valid bool, a box);
+
+--an internal block below the root: its subtree, levels still counted from the root
+CREATE TABLE gevelt AS SELECT box(point(i % 317, i / 317), point(i % 317 + 1, i / 317 + 1)) AS b FROM generate_series(1, 100000) i;
+CREATE INDEX gevelt_gist ON gevelt USING gist ( b );
+WITH p AS (SELECT m[1]::int AS l, m[2]::int AS blk, m[3]::int AS ntuples
+             FROM regexp_matches(gist_tree('gevelt_gist'), '\(l:(\d+)\) blk: (\d+) numTuple: (\d+)', 'g') AS m),
+     node AS (SELECT * FROM p WHERE l = 1 ORDER BY blk LIMIT 1)
+SELECT (SELECT max(l) FROM p) >= 2 AS three_levels,
+       (SELECT count(*) FROM gist_print('gevelt_gist', 2, 2, (SELECT blk FROM node)) AS t(level int, valid bool, a box)) =
+       (SELECT ntuples FROM node) AS node_tuples,
+       (SELECT min(level) FROM gist_print('gevelt_gist', 1, 100, (SELECT blk FROM node)) AS t(level int, valid bool, a box)) = 2 AS node_level,
+       (SELECT count(*) FROM gist_print('gevelt_gist', 1, 100, (SELECT blk FROM node)) AS t(level int, valid bool, a box)) <
+       (SELECT count(*) FROM gist_print('gevelt_gist') AS t(level int, valid bool, a box)) AS subtree;
+DROP TABLE gevelt;
+
+--in the target list the rows are records of a registered row type
+SELECT bool_and(r::text LIKE '(1,t,"(%') AS root_rows FROM (SELECT gist_print('gevelq_gist', 1, 1) AS r) s;
+SELECT (SELECT count(*) FROM (SELECT gist_print('gevelq_gist')) s) =
+       (SELECT count(*) FROM gist_print('gevelq_gist') AS t(level int, valid bool, a box)) AS target_list;
+
+DROP TABLE gevelq;
+
+CREATE TABLE gevelr AS SELECT i AS v FROM generate_series(1, 10000) i;
+INSERT INTO gevelr VALUES (NULL);
+
+CREATE INDEX gevelr_btree ON gevelr USING btree ( v );
+CREATE INDEX gevelr_desc ON gevelr USING btree ( v DESC );
+
+SELECT count(*), min(a), max(a) FROM btree_print_range('gevelr_btree', 100, 200) AS t(level int, valid bool, a int);
+SELECT count(*), min(a), max(a) FROM btree_print_range('gevelr_btree', NULL::int, 50) AS t(level int, valid bool, a int);
+SELECT count(*), min(a), max(a) FROM btree_print_range('gevelr_btree', 9990::bigint, NULL) AS t(level int, valid bool, a int);
+SELECT count(*), min(a), max(a) FROM btree_print_range('gevelr_desc', 100, 200) AS t(level int, valid bool, a int);
+SELECT count(*) FROM btree_print_range('gevelr_btree', 200, 100) AS t(level int, valid bool, a int);
+SELECT a FROM btree_print_range('gevelr_desc', 5, 7) AS t(level int, valid bool, a int);
+
+--the pivots of the descent come first, one per level above the leaves
+SELECT (SELECT count(*) FROM btree_print_range('gevelr_btree', 5000, 5000, true) AS t(level int, valid bool, a int) WHERE level <= (SELECT max(level) - 1 FROM btree_print('gevelr_btree') AS t(level int, valid bool, a int))) =
+       (SELECT count(DISTINCT level) - 1 FROM btree_print('gevelr_btree') AS t(level int, valid bool, a int)) AS pivots;
+
+SELECT * FROM btree_print_range('gevelr_btree', 'a'::text, 'b'::text) AS t(level int, valid bool, a int);
+
+SELECT count(*) = (SELECT count(*) FROM btree_print('gevelr_btree') AS t(level int, valid bool, a int)) AS target_list,
+       bool_and(r::text ~ '^\(\d+,t,\d*\)$') AS well_formed
+  FROM (SELECT btree_print('gevelr_btree') AS r) s;
+
+DROP TABLE gevelr;
+
+--the leaf scan ends at the first NULL of a NULLS LAST column and skips those of a NULLS FIRST one
+CREATE TABLE geveln AS SELECT CASE WHEN i <= 10000 THEN i END AS v FROM generate_series(1, 15000) i;
+CREATE INDEX geveln_last ON geveln USING btree ( v );
+CREATE INDEX geveln_first ON geveln USING btree ( v NULLS FIRST );
+SET gevel.instrument = on;
+SET client_min_messages = warning;
+SELECT count(*), min(a), max(a) FROM btree_print_range('geveln_last', 9990, NULL) AS t(level int, valid bool, a int);
+RESET client_min_messages;
+SELECT substring(gevel_instrument_last() FROM 'Level 2: pages=(\d+)')::int <= 2 AS stops_at_null;
+SET client_min_messages = warning;
+SELECT count(*), min(a), max(a) FROM btree_print_range('geveln_first', NULL::int, 5) AS t(level int, valid bool, a int);
+RESET client_min_messages;
+RESET gevel.instrument;
+DROP TABLE geveln;
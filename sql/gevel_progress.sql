@@ -0,0 +1,7 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.progress.sql
+\set ECHO all
+RESET client_min_messages;
+
+SELECT function, phase, blocks_total, blocks_done FROM pg_stat_progress_gevel;
@@ -0,0 +1,54 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.btree.sql
+\i gevel.resumable.sql
+\set ECHO all
+RESET client_min_messages;
+
+CREATE TABLE gevelr AS SELECT i AS v, point(i % 100, i / 100) AS p, ARRAY[i % 50, i % 7] AS a FROM generate_series(1, 10000) i;
+
+CREATE INDEX gevelr_btree ON gevelr USING btree ( v );
+CREATE INDEX gevelr_gist ON gevelr USING gist ( p );
+CREATE INDEX gevelr_gin ON gevelr USING gin ( a );
+CREATE INDEX gevelr_spgist ON gevelr USING spgist ( p );
+
+--gist, one page per call
+WITH RECURSIVE s AS (
+	SELECT r.stat, r.token, 1 AS calls FROM gist_stat('gevelr_gist', 1) r
+	UNION ALL
+	SELECT r.stat, r.token, s.calls + 1 FROM s, gist_stat('gevelr_gist', 1, 0, s.token) r WHERE s.token IS NOT NULL
+)
+SELECT stat = gist_stat('gevelr_gist') AS same, calls > 1 AS resumed FROM s WHERE token IS NULL;
+
+--btree, one page per call
+WITH RECURSIVE s AS (
+	SELECT r.stat, r.token, 1 AS calls FROM btree_stat('gevelr_btree', 1) r
+	UNION ALL
+	SELECT r.stat, r.token, s.calls + 1 FROM s, btree_stat('gevelr_btree', 1, 0, s.token) r WHERE s.token IS NOT NULL
+)
+SELECT stat = btree_stat('gevelr_btree') AS same, calls > 1 AS resumed FROM s WHERE token IS NULL;
+
+--gin, one page per call
+WITH RECURSIVE s AS (
+	SELECT r.stat, r.token, 1 AS calls FROM gin_statpage('gevelr_gin', 1) r
+	UNION ALL
+	SELECT r.stat, r.token, s.calls + 1 FROM s, gin_statpage('gevelr_gin', 1, 0, s.token) r WHERE s.token IS NOT NULL
+)
+SELECT stat = gin_statpage('gevelr_gin') AS same, calls > 1 AS resumed FROM s WHERE token IS NULL;
+
+--spgist, one page per call
+WITH RECURSIVE s AS (
+	SELECT r.stat, r.token, 1 AS calls FROM spgist_stat('gevelr_spgist', 1) r
+	UNION ALL
+	SELECT r.stat, r.token, s.calls + 1 FROM s, spgist_stat('gevelr_spgist', 1, 0, s.token) r WHERE s.token IS NOT NULL
+)
+SELECT stat = spgist_stat('gevelr_spgist') AS same, calls > 1 AS resumed FROM s WHERE token IS NULL;
+
+--no budget reads everything at once
+SELECT stat = btree_stat('gevelr_btree') AS same, token IS NULL AS done FROM btree_stat('gevelr_btree', 0);
+
+--tokens are checked
+SELECT stat FROM btree_stat('gevelr_btree', 1, 0, '\x00'::bytea);
+SELECT b.stat FROM gist_stat('gevelr_gist', 1) g, btree_stat('gevelr_btree', 1, 0, g.token) b;
+
+DROP TABLE gevelr;
@@ -0,0 +1,16 @@
+--every hundredth key is NULL and goes to the nulls tree
+CREATE TABLE gevelsp AS SELECT CASE WHEN i % 100 = 0 THEN NULL ELSE point(i % 100, i / 100) END AS p FROM generate_series(1, 10000) i;
+CREATE INDEX gevelsp_idx ON gevelsp USING spgist ( p );
+
+SELECT s ~ '^levels: +[2-9]\n' AS levels,
+	s ~ '\nleafTuples: +9900\n' AS leaf_tuples,
+	s ~ '\nnullLeafTuples: +100, levels 1, maxLeafDepth 1\n' AS null_leaf_tuples
+	FROM spgist_level_stat('gevelsp_idx') AS s;
+
+--no NULL keys, an empty nulls tree
+DELETE FROM gevelsp WHERE p IS NULL;
+VACUUM gevelsp;
+SELECT s ~ '\nnullLeafTuples: +0, levels 0, maxLeafDepth 0\n' AS no_null_leaf_tuples
+	FROM spgist_level_stat('gevelsp_idx') AS s;
+
+DROP TABLE gevelsp;
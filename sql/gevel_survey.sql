@@ -0,0 +1,22 @@
+SET client_min_messages = warning;
+\set ECHO none
+\i gevel.survey.sql
+\set ECHO all
+RESET client_min_messages;
+
+CREATE SCHEMA gevel_survey_test;
+CREATE TABLE gevel_survey_test.t AS SELECT i AS v, point(i, i) AS p FROM generate_series(1, 10000) i;
+CREATE INDEX survey_btree ON gevel_survey_test.t USING btree ( v );
+CREATE INDEX survey_hash ON gevel_survey_test.t USING hash ( v );
+CREATE INDEX survey_gist ON gevel_survey_test.t USING gist ( p );
+CREATE INDEX survey_brin ON gevel_survey_test.t USING brin ( v );
+
+SELECT indexname, tablename, am, levels, tuples, dead_tuples,
+       pages = other_pages + inner_pages + leaf_pages + deleted_pages AS pages_add_up
+  FROM gevel_survey('gevel_survey_test')
+ ORDER BY indexname;
+SELECT indexname, am FROM gevel_survey('gevel%test', '{btree,brin}', 1, 50) ORDER BY indexname;
+SELECT count(*) FROM gevel_survey('no_such_schema%');
+SELECT * FROM gevel_survey('%', '{heap}');
+
+DROP SCHEMA gevel_survey_test CASCADE;
@@ -0,0 +1,97 @@
+# gevel_dump on the files of a stopped cluster gives the report of the
+# SQL functions, and the scale benchmark runs through at a small scale.
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use IPC::Run;
+use Test::More tests => 13;
+
+my $node = get_new_node('main');
+$node->init;
+$node->start;
+
+$node->safe_psql('postgres', slurp_file('gevel.sql'));
+$node->safe_psql('postgres', slurp_file('gevel.incremental.sql'));
+$node->safe_psql('postgres', q{
+	CREATE TABLE geveld AS SELECT i AS v, box(point(i % 100, i / 100), point(i % 100 + 1, i / 100 + 1)) AS b FROM generate_series(1, 10000) i;
+	CREATE INDEX geveld_btree ON geveld USING btree ( v );
+	CREATE INDEX geveld_gist ON geveld USING gist ( b );
+});
+
+# psql keeps the last newline of a multi-line result
+sub sql_text
+{
+	my $text = $node->safe_psql('postgres', shift);
+
+	$text =~ s/\s+$//;
+	return $text;
+}
+
+my %index;
+foreach my $name ('geveld_btree', 'geveld_gist')
+{
+	my $am = ($name =~ /btree/) ? 'btree' : 'gist';
+
+	$index{$name} = {
+		file   => $node->data_dir . '/'
+		  . $node->safe_psql('postgres', "SELECT pg_relation_filepath('$name')"),
+		blocks => $node->safe_psql('postgres',
+			"SELECT pg_relation_size('$name') / current_setting('block_size')::int"),
+		stat   => sql_text("SELECT ${am}_stat_incremental('$name')"),
+		tree   => sql_text("SELECT ${am}_tree('$name')"),
+	};
+}
+
+# the files are read cold, after the shutdown checkpoint
+$node->stop;
+
+sub dump_index
+{
+	my ($stdout, $stderr) = ('', '');
+	my $ok = IPC::Run::run([ 'gevel_dump', @_ ], '>', \$stdout, '2>', \$stderr);
+
+	$stdout =~ s/\s+$//;
+	return ($ok, $stdout, $stderr);
+}
+
+my ($ok, $out, $err) = dump_index($index{geveld_btree}{file});
+ok($ok, 'gevel_dump of a btree exits with 0');
+like($out, qr/^Number of levels: +2\nNumber of pages: /, 'btree report header');
+is(($out =~ /^Number of pages: +(\d+)$/m)[0], $index{geveld_btree}{blocks} - 1,
+	'btree pages are the blocks but the metapage');
+is($out, $index{geveld_btree}{stat}, 'btree report is that of btree_stat_incremental');
+is($err, '', 'no btree page skipped');
+
+($ok, $out, $err) = dump_index('-j', '2', $index{geveld_gist}{file});
+ok($ok, 'gevel_dump of a gist index exits with 0');
+like($out, qr/^Number of levels: +\d+\nNumber of pages: /, 'gist report header');
+is(($out =~ /^Number of pages: +(\d+)$/m)[0], $index{geveld_gist}{blocks},
+	'gist pages are all the blocks');
+is($out, $index{geveld_gist}{stat}, 'gist report is that of gist_stat_incremental');
+
+($ok, $out, $err) = dump_index('-t', $index{geveld_btree}{file});
+is($out, $index{geveld_btree}{tree}, 'btree tree is that of btree_tree');
+
+($ok, $out, $err) = dump_index('-a', 'hash', $index{geveld_btree}{file});
+ok(!$ok && $err =~ /unsupported access method "hash"/,
+	'unknown access method is refused');
+
+# make bench, on the smallest scale and without a baseline
+$node->start;
+{
+	local $ENV{PGHOST}          = $node->host;
+	local $ENV{PGPORT}          = $node->port;
+	local $ENV{PGDATABASE}      = 'postgres';
+	local $ENV{BENCH_SCALES}    = '1000';
+	local $ENV{BENCH_BASELINE}  = "$TestLib::tmp_check/no_baseline.csv";
+	my ($stdout, $stderr) = ('', '');
+
+	ok(IPC::Run::run([ 'sh', 'bench/run.sh' ], '>', \$stdout, '2>', \$stderr),
+		'bench runs without a baseline');
+	like(slurp_file('bench/results.csv'),
+		qr/^scale,case,mode,ms,shared_hit,shared_read,peak_kb\n1000,\w+,cold,/,
+		'bench results of the scale');
+}
+$node->stop;